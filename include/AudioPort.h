@@ -25,11 +25,13 @@
 #ifndef AUDIO_PORT_H
 #define AUDIO_PORT_H
 
+#include <atomic>
 #include <memory>
 #include <QtCore/QString>
 #include <QtCore/QMutex>
 #include <QtCore/QMutexLocker>
 
+#include "CpuUsage.h"
 #include "MemoryManager.h"
 #include "PlayHandle.h"
 
@@ -105,23 +107,102 @@ public:
 	{
 		return true;
 	}
+	MixerProfiler::DetailType detailType() const override
+	{
+		return MixerProfiler::DetailType::Effects;
+	}
+
+	void addProcessingTime( int64_t nanoseconds ) override
+	{
+		m_cpuUsage.add( nanoseconds );
+	}
+
+	//! Processing time of the play handles, thread-safe
+	void addInstrumentTime( int64_t nanoseconds )
+	{
+		m_instrumentCpuUsage.add( nanoseconds );
+		m_cpuUsage.add( nanoseconds );
+	}
+
+	//! Processing time of the play handles and the port itself
+	const CpuUsage & cpuUsage() const
+	{
+		return m_cpuUsage;
+	}
+
+	//! Processing time of the play handles only
+	const CpuUsage & instrumentCpuUsage() const
+	{
+		return m_instrumentCpuUsage;
+	}
 
 	void addPlayHandle( PlayHandle * handle );
 	void removePlayHandle( PlayHandle * handle );
 
+	// the port is queued for processing once all play handles queued
+	// before it are processed, see Mixer::renderNextBuffer()
+	void resetDependencies()
+	{
+		// all jobs of the last period are done
+		finishPeriod();
+
+		// the mixer holds one dependency until all play handles are queued
+		m_dependencies = 1;
+		m_jobFxChannel = m_nextFxChannel;
+	}
+
+	void addDependency()
+	{
+		++m_dependencies;
+	}
+
+	void dependencyMet();
+
+	// FX channel the port sends to in the current period
+	fx_ch_t jobFxChannel() const
+	{
+		return m_jobFxChannel;
+	}
+
+	// whether the FX channel has to mix in our buffer this period
+	bool hasOutput() const
+	{
+		return m_hasOutput;
+	}
+
 private:
+	//! Rolls the processing time of the last period into the CPU usage of
+	//! the port and its effects
+	void finishPeriod();
+
+	//! Computes the gain of each channel from volume and panning. Returns
+	//! true if they have to be applied per frame from m_gains, otherwise
+	//! m_gainLeft and m_gainRight hold them.
+	bool updateGains();
+
 	volatile bool m_bufferUsage;
+	bool m_hasOutput;
 
 	sampleFrame * m_portBuffer;
 	QMutex m_portBufferLock;
 
+	sampleFrame * m_gains;
+	float m_gainLeft;
+	float m_gainRight;
+
 	bool m_extOutputEnabled;
 	fx_ch_t m_nextFxChannel;
+	fx_ch_t m_jobFxChannel;
+
+	std::atomic_int m_dependencies;
 
 	QString m_name;
 
 	std::unique_ptr<EffectChain> m_effects;
 
+	CpuUsage m_cpuUsage;
+	CpuUsage m_instrumentCpuUsage;
+
 	PlayHandleList m_playHandles;
 	QMutex m_playHandleLock;
 
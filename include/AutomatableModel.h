@@ -26,7 +26,8 @@
 #define AUTOMATABLE_MODEL_H
 
 #include <QtCore/QMap>
-#include <QtCore/QMutex>
+
+#include <atomic>
 
 #include "JournallingObject.h"
 #include "Model.h"
@@ -199,6 +200,12 @@ public:
 	void setInitValue( const float value );
 
 	void setAutomatedValue( const float value );
+	//! @brief Sample-exact automation for the frames [offset, offset + frames)
+	//! of the current period, ramping from startValue to endValue. Both are
+	//! unscaled like the argument of setAutomatedValue(), which is called
+	//! with startValue. Values inside the ramp aren't rounded to the step size.
+	void setAutomatedValues( const float startValue, const float endValue,
+					const f_cnt_t offset, const fpp_t frames );
 	void setValue( const float value );
 
 	void incValue( int steps )
@@ -386,14 +393,24 @@ private:
 	ControllerConnection* m_controllerConnection;
 
 
+	//! Computes m_valueBuffer for the current period, returns whether it
+	//! holds sample-exact data
+	bool updateValueBuffer();
+
 	ValueBuffer m_valueBuffer;
-	long m_lastUpdatedPeriod;
+	// the first thread calling valueBuffer() in a period claims it and
+	// computes the buffer, the others wait until it's published
+	std::atomic<long> m_claimedPeriod;
+	std::atomic<long> m_lastUpdatedPeriod;
 	static long s_periodCounter;
 
 	bool m_hasSampleExactData;
 
-	// prevent several threads from attempting to write the same vb at the same time
-	QMutex m_valueBufferMutex;
+	// period in which automation last wrote m_valueBuffer, the number of
+	// frames written and whether they differ at all
+	long m_automatedPeriod;
+	f_cnt_t m_automatedFrames;
+	bool m_automationVaries;
 
 signals:
 	void initValueChanged( float val );
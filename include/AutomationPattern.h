@@ -30,6 +30,10 @@
 #include <QtCore/QMap>
 #include <QtCore/QPointer>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include "Track.h"
 
 
@@ -135,7 +139,16 @@ public:
 	}
 
 	float valueAt( const MidiTime & _time ) const;
-	float *valuesAfter( const MidiTime & _time ) const;
+	//! Value @p offset ticks (0 <= offset < 1) after @p time, for
+	//! evaluating the curve between ticks
+	float valueAt( const MidiTime & time, float offset ) const;
+	//! Values @p startOffset and @p endOffset ticks after @p time, both
+	//! within the tick, looking up the segment only once
+	void valuesAt( const MidiTime & time, float startOffset, float endOffset,
+						float & start, float & end ) const;
+	//! Fills @p values with the value of every tick from the control point
+	//! at @p time up to the next one, returns false if there is none
+	bool valuesAfter( const MidiTime & time, std::vector<float> & values ) const;
 
 	const QString name() const;
 
@@ -167,11 +180,37 @@ public slots:
 	void flipY();
 	void flipX( int length = -1 );
 
+private slots:
+	void updateOutdatedSegments();
+
 private:
 	void cleanObjects();
 	void generateTangents();
 	void generateTangents( timeMap::const_iterator it, int numToGenerate );
-	float valueAt( timeMap::const_iterator v, int offset ) const;
+
+	// the curve from one control point to the next as a cubic polynomial
+	// in the position t = 0..1 within the segment
+	struct Segment
+	{
+		tick_t start;
+		// 0 for the last control point, whose value holds forever
+		tick_t length;
+		float a, b, c, d;
+
+		float valueAt( tick_t time, float offset = 0 ) const
+		{
+			const float t = length > 0 ? ( ( time - start ) + offset ) / length : 0.0f;
+			return ( ( a * t + b ) * t + c ) * t + d;
+		}
+	} ;
+	typedef std::vector<Segment> SegmentVector;
+
+	//! Precomputes the segments after the control points, the progression
+	//! type or the tension changed. Outside the thread of the pattern,
+	//! i.e. while recording, it only marks them outdated and the rebuild
+	//! follows once dataChanged() arrives in the pattern's thread.
+	void updateSegments();
+	const Segment * segmentAt( const SegmentVector & segments, tick_t time ) const;
 
 	AutomationTrack * m_autoTrack;
 	QVector<jo_id_t> m_idsToResolve;
@@ -179,6 +218,12 @@ private:
 	timeMap m_timeMap;	// actual values
 	timeMap m_oldTimeMap;	// old values for storing the values before setDragValue() is called.
 	timeMap m_tangents;	// slope at each point for calculating spline
+	// replaced as a whole, so the mixer can evaluate the segments while
+	// the editor changes the pattern
+	std::shared_ptr<const SegmentVector> m_segments;
+	// segment looked at last, where the next lookup most likely starts
+	mutable std::atomic<std::size_t> m_segmentCursor;
+	std::atomic<bool> m_segmentsOutdated;
 	float m_tension;
 	bool m_hasAutomation;
 	ProgressionTypes m_progressionType;
@@ -142,6 +142,8 @@ protected:
 
 private:
 	QList<Track *> m_disabledTracks;
+	// TCOs played in the current tick
+	tcoVector m_tcosToPlay;
 
 	typedef QMap<BBTrack *, int> infoMap;
 	static infoMap s_infoMap;
@@ -62,8 +62,6 @@ public:
 	void fixIncorrectPositions();
 	void createTCOsForBB( int _bb );
 
-	AutomatedValueMap automatedValuesAt(MidiTime time, int tcoNum) const override;
-
 public slots:
 	void play();
 	void stop();
@@ -71,6 +69,11 @@ public slots:
 	void currentBBChanged();
 
 
+protected:
+	void addAutomation(MidiTime time, int tcoNum, bool held,
+				AutomationCollection& collection) const override;
+
+
 private:
 	ComboBoxModel m_bbComboBoxModel;
 
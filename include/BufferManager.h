@@ -29,11 +29,42 @@
 #include "lmms_export.h"
 #include "lmms_basics.h"
 
+//! What is known about the contents of a buffer from BufferManager, so
+//! consumers can skip silent buffers without reading them
+struct BufferInfo
+{
+	bool silenceKnown;
+	bool silent;
+	//! peakLeft, peakRight and hasBadSamples are valid
+	bool peaksKnown;
+	//! the buffer contains infs or nans
+	bool hasBadSamples;
+	float peakLeft;
+	float peakRight;
+} ;
+
+
 class LMMS_EXPORT BufferManager
 {
 public:
 	static void init( fpp_t framesPerPeriod );
+	//! Returns a buffer of one period. Nothing is known about its contents.
 	static sampleFrame * acquire();
+
+	// metadata of buffers returned by acquire() - whoever writes to such a
+	// buffer has to invalidate it or mark it silent afterwards
+
+	static const BufferInfo & info( const sampleFrame * buf );
+	static void invalidate( sampleFrame * buf );
+	//! Record that the buffer holds nothing but zeros, e.g. after clearing it
+	static void markSilent( sampleFrame * buf );
+	//! Scans the buffer until the first audible sample unless its silence
+	//! is known already
+	static bool isSilent( const sampleFrame * buf );
+	//! Determines peaks and bad samples of the buffer unless they are known
+	//! already
+	static const BufferInfo & analyze( const sampleFrame * buf );
+
 	// audio-buffer-mgm
 	static void clear( sampleFrame * ab, const f_cnt_t frames,
 						const f_cnt_t offset = 0 );
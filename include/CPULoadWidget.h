@@ -43,6 +43,7 @@ public:
 
 
 protected:
+	bool event( QEvent * _ev ) override;
 	void paintEvent( QPaintEvent * _ev ) override;
 
 
@@ -51,6 +52,8 @@ protected slots:
 
 
 private:
+	void updateToolTip();
+
 	int m_currentLoad;
 
 	QPixmap m_temp;
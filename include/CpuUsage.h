@@ -0,0 +1,113 @@
+/*
+ * CpuUsage.h - processing time of a part of the project
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef CPU_USAGE_H
+#define CPU_USAGE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <QtCore/QString>
+
+
+//! Processing time of one part of the project, e.g. a track, an effect or
+//! an FX channel
+//!
+//! Any thread processing the part adds time to the current period. Once
+//! per period, when nobody adds time anymore, the owner rolls it into a
+//! moving average and a slowly decaying peak which the GUI can read at any
+//! time.
+class CpuUsage
+{
+public:
+	CpuUsage() :
+		m_current( 0 ),
+		m_total( 0 ),
+		m_average( 0.0f ),
+		m_peak( 0.0f )
+	{
+	}
+
+	//! Thread-safe
+	void add( int64_t nanoseconds )
+	{
+		m_current.fetch_add( nanoseconds, std::memory_order_relaxed );
+	}
+
+	void finishPeriod()
+	{
+		const int64_t current = m_current.exchange( 0, std::memory_order_relaxed );
+		m_total.fetch_add( current, std::memory_order_relaxed );
+
+		const float time = current / 1000.0f;
+		const float peak = m_peak.load( std::memory_order_relaxed ) * PeakDecay;
+		m_average.store( m_average.load( std::memory_order_relaxed ) * ( 1.0f - Smoothing ) +
+					time * Smoothing, std::memory_order_relaxed );
+		m_peak.store( time > peak ? time : peak, std::memory_order_relaxed );
+	}
+
+	//! Processing time per period in microseconds, averaged over roughly
+	//! the last second
+	float average() const
+	{
+		return m_average.load( std::memory_order_relaxed );
+	}
+
+	//! Highest processing time of a recent period in microseconds
+	float peak() const
+	{
+		return m_peak.load( std::memory_order_relaxed );
+	}
+
+	//! Processing time of all finished periods in microseconds
+	int64_t total() const
+	{
+		return m_total.load( std::memory_order_relaxed ) / 1000;
+	}
+
+	//! Average and peak as percentage of a period of @p periodTime
+	//! microseconds, for tooltips
+	QString toString( float periodTime ) const
+	{
+		return QString( "%1% (peak %2%)" )
+			.arg( average() * 100.0f / periodTime, 0, 'f', 1 )
+			.arg( peak() * 100.0f / periodTime, 0, 'f', 1 );
+	}
+
+
+private:
+	// weight of the latest period in the average
+	static constexpr float Smoothing = 0.01f;
+	// the peak falls by half within about a second
+	static constexpr float PeakDecay = 0.996f;
+
+	std::atomic<int64_t> m_current;
+	std::atomic<int64_t> m_total;
+	std::atomic<float> m_average;
+	std::atomic<float> m_peak;
+
+} ;
+
+
+#endif
@@ -26,6 +26,7 @@
 #ifndef EFFECT_H
 #define EFFECT_H
 
+#include "CpuUsage.h"
 #include "Plugin.h"
 #include "Engine.h"
 #include "Mixer.h"
@@ -153,6 +154,11 @@ public:
 		return m_parent;
 	}
 
+	const CpuUsage & cpuUsage() const
+	{
+		return m_cpuUsage;
+	}
+
 	virtual EffectControls * controls() = 0;
 
 	static Effect * instantiate( const QString & _plugin_name,
@@ -220,6 +226,8 @@ private:
 	SRC_DATA m_srcData[2];
 	SRC_STATE * m_srcState[2];
 
+	CpuUsage m_cpuUsage;
+
 
 	friend class EffectView;
 	friend class EffectChain;
@@ -54,9 +54,16 @@ public:
 	void moveUp( Effect * _effect );
 	bool processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, bool hasInputNoise );
 	void startRunning();
+	//! Rolls the processing time of all effects into their CPU usage
+	void finishPeriod();
 
 	void clear();
 
+	QVector<Effect *> effects() const
+	{
+		return m_effects;
+	}
+
 
 private:
 	typedef QVector<Effect *> EffectList;
@@ -25,6 +25,7 @@
 #ifndef ENVELOPE_AND_LFO_PARAMETERS_H
 #define ENVELOPE_AND_LFO_PARAMETERS_H
 
+#include <QtCore/QMutex>
 #include <QtCore/QVector>
 
 #include "JournallingObject.h"
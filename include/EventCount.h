@@ -0,0 +1,102 @@
+/*
+ * EventCount.h - lets threads block on a condition without locking the
+ *                notifying side
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef EVENT_COUNT_H
+#define EVENT_COUNT_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+#include <atomic>
+
+
+//! Futex-style wait/notify primitive
+//!
+//! notify() only enters the kernel if some thread is actually blocked, so
+//! signalling an event nobody waits for costs two atomic operations.
+//!
+//! A waiter must follow this protocol to not miss a notification:
+//! \code
+//! auto key = ec.prepareWait();
+//! if( conditionMet() ) { ec.cancelWait(); }
+//! else { ec.commitWait( key ); }
+//! \endcode
+class EventCount
+{
+public:
+	EventCount() :
+		m_epoch( 0 ),
+		m_waiters( 0 )
+	{
+	}
+
+	unsigned int prepareWait()
+	{
+		m_waiters.fetch_add( 1 );
+		return m_epoch.load();
+	}
+
+	void cancelWait()
+	{
+		m_waiters.fetch_sub( 1 );
+	}
+
+	void commitWait( unsigned int key )
+	{
+		m_mutex.lock();
+		while( m_epoch.load() == key )
+		{
+			m_cond.wait( &m_mutex );
+		}
+		m_mutex.unlock();
+		m_waiters.fetch_sub( 1 );
+	}
+
+	void notify()
+	{
+		m_epoch.fetch_add( 1 );
+		if( m_waiters.load() > 0 )
+		{
+			m_mutex.lock();
+			m_cond.wakeAll();
+			m_mutex.unlock();
+		}
+	}
+
+	bool hasWaiters() const
+	{
+		return m_waiters.load() > 0;
+	}
+
+private:
+	std::atomic<unsigned int> m_epoch;
+	std::atomic_int m_waiters;
+	QMutex m_mutex;
+	QWaitCondition m_cond;
+
+} ;
+
+
+#endif
@@ -83,6 +83,9 @@ public:
 
 	bool eventFilter (QObject *dist, QEvent *event) override;
 
+protected:
+	bool event( QEvent * _e ) override;
+
 private:
 	void drawFxLine( QPainter* p, const FxLine *fxLine, bool isActive, bool sendToThis, bool receiveFromThis );
 	QString elideName( const QString & name );
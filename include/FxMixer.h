@@ -26,14 +26,17 @@
 #define FX_MIXER_H
 
 #include "Model.h"
+#include "CpuUsage.h"
 #include "EffectChain.h"
 #include "JournallingObject.h"
 #include "ThreadableJob.h"
 
 #include <atomic>
+#include <vector>
 
 #include <QColor>
 
+class AudioPort;
 class FxRoute;
 typedef QVector<FxRoute *> FxRouteVector;
 
@@ -45,7 +48,7 @@ class FxChannel : public ThreadableJob
 
 		EffectChain m_fxChain;
 
-		// set to true when input fed from mixToChannel or child channel
+		// set to true when input fed from an audio port or child channel
 		bool m_hasInput;
 		// set to true if any effect in the channel is enabled and running
 		bool m_stillRunning;
@@ -53,12 +56,13 @@ class FxChannel : public ThreadableJob
 		float m_peakLeft;
 		float m_peakRight;
 		sampleFrame * m_buffer;
+		// per frame gains of the send currently being mixed in
+		sampleFrame * m_sendGains;
 		bool m_muteBeforeSolo;
 		BoolModel m_muteModel;
 		BoolModel m_soloModel;
 		FloatModel m_volumeModel;
 		QString m_name;
-		QMutex m_lock;
 		int m_channelIndex; // what channel index are we
 		bool m_queued; // are we queued up for rendering yet?
 		bool m_muted; // are we muted? updated per period so we don't have to call m_muteModel.value() twice
@@ -69,7 +73,23 @@ class FxChannel : public ThreadableJob
 		// pointers to other channels that send to this one
 		FxRouteVector m_receives;
 
+		// audio ports sending to this channel in the current period, their
+		// output is pulled in when the channel gets processed
+		std::vector<AudioPort *> m_inputPorts;
+
 		bool requiresProcessing() const override { return true; }
+		MixerProfiler::DetailType detailType() const override
+		{
+			return MixerProfiler::DetailType::Mixing;
+		}
+
+		void addProcessingTime( int64_t nanoseconds ) override
+		{
+			m_cpuUsage.add( nanoseconds );
+		}
+
+		// processing time of the channel including its effects
+		CpuUsage m_cpuUsage;
 		void unmuteForSolo();
 
 
@@ -84,6 +104,10 @@ class FxChannel : public ThreadableJob
 		bool m_hasColor;
 
 	
+		// number of senders not muted, updated along with the routing plan
+		int m_senderDependencies;
+		// number of senders and audio ports to wait for in this period
+		int m_dependencies;
 		std::atomic_int m_dependenciesMet;
 		void incrementDeps();
 		void processed();
@@ -141,11 +165,15 @@ public:
 	FxMixer();
 	virtual ~FxMixer();
 
-	void mixToChannel( const sampleFrame * _buf, fx_ch_t _ch );
-
 	void prepareMasterMix();
 	void masterMix( sampleFrame * _buf );
 
+	// job graph support - see Mixer::renderNextBuffer()
+	void prepareJobs();
+	void addInputPort( AudioPort * _port );
+	void queueJobs();
+	void portProcessed( fx_ch_t _ch );
+
 	void saveSettings( QDomDocument & _doc, QDomElement & _parent ) override;
 	void loadSettings( const QDomElement & _this ) override;
 
@@ -209,6 +237,9 @@ public:
 
 	FxRouteVector m_fxRoutes;
 
+private slots:
+	void invalidateRoutingPlan();
+
 private:
 	// the fx channels in the mixer. index 0 is always master.
 	QVector<FxChannel *> m_fxChannels;
@@ -216,6 +247,17 @@ private:
 	// make sure we have at least num channels
 	void allocateChannelsTo(int num);
 
+	// rebuild the lists below and the dependency counts of the channels,
+	// done whenever routes or mute states changed
+	void updateRoutingPlan();
+
+	std::atomic_bool m_routingChanged;
+	// channels not muted
+	std::vector<FxChannel *> m_activeChannels;
+	// channels not muted and without any sender that's not muted
+	std::vector<FxChannel *> m_rootChannels;
+	std::vector<FxChannel *> m_mutedChannels;
+
 	int m_lastSoloed;
 
 } ;
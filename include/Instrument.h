@@ -37,6 +37,7 @@
 // forward-declarations
 class InstrumentTrack;
 class MidiEvent;
+class NoteBatch;
 class NotePlayHandle;
 class Track;
 
@@ -51,6 +52,7 @@ public:
 		IsSingleStreamed = 0x01,	/*! Instrument provides a single audio stream for all notes */
 		IsMidiBased = 0x02,			/*! Instrument is controlled by MIDI events rather than NotePlayHandles */
 		IsNotBendable = 0x04,		/*! Instrument can't react to pitch bend changes */
+		IsBatchRendered = 0x08,		/*! Instrument renders all notes of a period in one call to playNotes() */
 	};
 
 	Q_DECLARE_FLAGS(Flags, Flag);
@@ -77,6 +79,11 @@ public:
 	{
 	}
 
+	// with IsBatchRendered, called instead of playNote() with all notes
+	// of the track playing in the current period - the default
+	// implementation still plays them one by one
+	virtual void playNotes( NoteBatch & batch );
+
 	// needed for deleting plugin-specific-data of a note - plugin has to
 	// cast void-ptr so that the plugin-data is deleted properly
 	// (call of dtor if it's a class etc.)
@@ -31,6 +31,7 @@
 #include "ModelView.h"
 
 
+class ComboBox;
 class GroupBox;
 class LcdSpinBox;
 class QToolButton;
@@ -77,10 +78,29 @@ public:
 		return m_pitchGroupBox;
 	}
 
+	GroupBox * polyphonyGroupBox()
+	{
+		return m_polyphonyGroupBox;
+	}
+
+	LcdSpinBox * maxVoicesSpinBox()
+	{
+		return m_maxVoicesSpinBox;
+	}
+
+	ComboBox * voiceStealingComboBox()
+	{
+		return m_voiceStealingComboBox;
+	}
+
 private:
 
 	GroupBox * m_pitchGroupBox;
 
+	GroupBox * m_polyphonyGroupBox;
+	LcdSpinBox * m_maxVoicesSpinBox;
+	ComboBox * m_voiceStealingComboBox;
+
 };
 
 #endif
@@ -27,11 +27,13 @@
 #define INSTRUMENT_TRACK_H
 
 #include "AudioPort.h"
+#include "ComboBoxModel.h"
 #include "GroupBox.h"
 #include "InstrumentFunctions.h"
 #include "InstrumentSoundShaping.h"
 #include "MidiEventProcessor.h"
 #include "MidiPort.h"
+#include "NoteBatch.h"
 #include "NotePlayHandle.h"
 #include "Piano.h"
 #include "PianoView.h"
@@ -97,6 +99,26 @@ public:
 	// filter and so on
 	void playNote( NotePlayHandle * _n, sampleFrame * _working_buffer );
 
+	// lets the instrument functions process the note, returns whether the
+	// instrument has to render it
+	bool processNoteFunctions( NotePlayHandle * n );
+
+	// the batch the mixer queues our notes in, if the instrument renders
+	// them together
+	NoteBatch * noteBatch();
+
+	enum VoiceStealingModes
+	{
+		StealOldest,
+		StealQuietest,
+		StealSameKey,
+		NumVoiceStealingModes
+	} ;
+
+	// fades out voices beyond the polyphony limit, called by the mixer
+	// with the voices of this track which aren't fading out already
+	void stealVoices( NotePlayHandle * * voices, int count );
+
 	QString instrumentName() const;
 	const Instrument *instrument() const
 	{
@@ -152,7 +174,7 @@ public:
 				const Plugin::Descriptor::SubPluginFeatures::Key* key = nullptr,
 				bool keyFromDnd = false);
 
-	AudioPort * audioPort()
+	AudioPort * audioPort() override
 	{
 		return &m_audioPort;
 	}
@@ -212,6 +234,21 @@ public:
 		return &m_effectChannelModel;
 	}
 
+	BoolModel * limitVoicesModel()
+	{
+		return &m_limitVoicesModel;
+	}
+
+	IntModel * maxVoicesModel()
+	{
+		return &m_maxVoicesModel;
+	}
+
+	ComboBoxModel * voiceStealingModel()
+	{
+		return &m_voiceStealingModel;
+	}
+
 	void setPreviewMode( const bool );
 
 	bool isPreviewMode() const
@@ -268,17 +305,24 @@ private:
 	IntModel m_baseNoteModel;
 
 	NotePlayHandleList m_processHandles;
+	// TCOs played in the current tick
+	tcoVector m_tcosToPlay;
 
 	FloatModel m_volumeModel;
 	FloatModel m_panningModel;
 
 	AudioPort m_audioPort;
+	NoteBatch m_noteBatch;
 
 	FloatModel m_pitchModel;
 	IntModel m_pitchRangeModel;
 	IntModel m_effectChannelModel;
 	BoolModel m_useMasterPitchModel;
 
+	BoolModel m_limitVoicesModel;
+	IntModel m_maxVoicesModel;
+	ComboBoxModel m_voiceStealingModel;
+
 
 	Instrument * m_instrument;
 	InstrumentSoundShaping m_soundShaping;
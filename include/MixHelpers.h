@@ -31,8 +31,40 @@ class ValueBuffer;
 namespace MixHelpers
 {
 
+//! Instruction sets the mixing kernels can run on
+enum class SimdLevel
+{
+	Scalar,
+	SSE2,
+	AVX2,
+	AVX512,
+	NEON
+} ;
+
+//! The instruction set the mixing kernels currently run on. At startup the
+//! best one supported by the CPU is selected.
+SimdLevel simdLevel();
+
+//! Whether kernels for @p level were compiled in and the CPU supports them
+bool isSimdLevelSupported( SimdLevel level );
+
+//! Switch the mixing kernels to @p level. Returns false, leaving the
+//! kernels untouched, if @p level is not supported. Not thread-safe - this
+//! is meant for tests and benchmarks only.
+bool setSimdLevel( SimdLevel level );
+
+const char * simdLevelName( SimdLevel level );
+
+
+//! Samples quieter than this count as silence
+const float SilenceThreshold = 0.0000001f;
+
+
 bool isSilent( const sampleFrame* src, int frames );
 
+/*! \brief Get the highest absolute sample of each channel, nans are ignored - returns true if infs/nans are found */
+bool peakValues( const sampleFrame* src, int frames, float & peakLeft, float & peakRight );
+
 bool useNaNHandler();
 
 void setNaNHandler( bool use );
@@ -64,6 +96,12 @@ void addSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, f
 /*! \brief Add samples from src multiplied by coeffSrc and coeffSrcBuf to dst - sanitized version */
 void addSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames );
 
+/*! \brief Add samples from src multiplied by the gain of the same frame and channel to dst */
+void addMultipliedByGains( sampleFrame* dst, const sampleFrame* src, const sampleFrame* gains, int frames );
+
+/*! \brief Add samples from src multiplied by the gain of the same frame and channel to dst - sanitized version */
+void addSanitizedMultipliedByGains( sampleFrame* dst, const sampleFrame* src, const sampleFrame* gains, int frames );
+
 /*! \brief Add samples from src multiplied by coeffSrcLeft/coeffSrcRight to dst */
 void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames );
 
@@ -31,6 +31,7 @@
 #include <QtCore/QWaitCondition>
 #include <samplerate.h>
 
+#include <vector>
 
 #include "lmms_basics.h"
 #include "LocklessList.h"
@@ -42,6 +43,8 @@
 class AudioDevice;
 class MidiClient;
 class AudioPort;
+class NoteBatch;
+class NotePlayHandle;
 
 
 const fpp_t MINIMUM_BUFFER_SIZE = 32;
@@ -227,6 +230,12 @@ public:
 		return m_framesPerPeriod;
 	}
 
+	//! Duration of one period in microseconds
+	float periodTime() const
+	{
+		return m_framesPerPeriod * 1000000.0f / processingSampleRate();
+	}
+
 
 	MixerProfiler& profiler()
 	{
@@ -238,6 +247,18 @@ public:
 		return m_profiler.cpuLoad();
 	}
 
+	//! Number of voices above which the least audible ones are faded out
+	//! when rendering gets close to the deadline, 0 for no limit
+	int voiceBudget() const
+	{
+		return m_voiceBudget;
+	}
+
+	void setVoiceBudget( int voices )
+	{
+		m_voiceBudget = voices;
+	}
+
 	const qualitySettings & currentQualitySettings() const
 	{
 		return m_qualitySettings;
@@ -303,11 +324,27 @@ public:
 		return m_inputBufferFrames[ m_inputBufferRead ];
 	}
 
+	//! The buffer stays valid until nextBuffer() is called again
 	inline const surroundSampleFrame * nextBuffer()
 	{
 		return hasFifoWriter() ? m_fifo->read() : renderNextBuffer();
 	}
 
+	//! Total time in microseconds the renderer waited for the audio device
+	//! to take buffers from the FIFO. Growing steadily means the FIFO is
+	//! deeper than needed.
+	int64_t fifoWriterBlockedTime() const
+	{
+		return m_fifo->writerBlockedTime();
+	}
+
+	//! Total time in microseconds the audio device waited for rendered
+	//! buffers. Growing means the FIFO is too shallow to absorb slow periods.
+	int64_t fifoReaderBlockedTime() const
+	{
+		return m_fifo->readerBlockedTime();
+	}
+
 	void changeQuality( const struct qualitySettings & _qs );
 
 	inline bool isMetronomeActive() const { return m_metronomeActive; }
@@ -334,6 +371,7 @@ private:
 	{
 	public:
 		fifoWriter( Mixer * _mixer, fifo * _fifo );
+		~fifoWriter();
 
 		void finish();
 
@@ -343,6 +381,10 @@ private:
 		fifo * m_fifo;
 		volatile bool m_writing;
 
+		// buffers handed to the reader in turn, owned by the writer
+		QVector<surroundSampleFrame *> m_buffers;
+		int m_nextBuffer;
+
 		void run() override;
 
 		void write( surroundSampleFrame * buffer );
@@ -365,6 +407,10 @@ private:
 
 	void clearInternal();
 
+	//! Fades out voices beyond the polyphony limit of their track and,
+	//! close to the deadline, beyond the voice budget
+	void stealVoices();
+
 	//! Called by the audio thread to give control to other threads,
 	//! such that they can do changes in the model (like e.g. removing effects)
 	void runChangesInModel();
@@ -398,6 +444,11 @@ private:
 	// place where new playhandles are added temporarily
 	LocklessList<PlayHandle *> m_newPlayHandles;
 	ConstPlayHandleList m_playHandlesToRemove;
+	// batches of notes queued in the current period
+	std::vector<NoteBatch *> m_noteBatches;
+	// voices to choose from when stealing
+	std::vector<NotePlayHandle *> m_voices;
+	int m_voiceBudget;
 
 
 	struct qualitySettings m_qualitySettings;
@@ -27,15 +27,46 @@
 
 #include <QFile>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "CpuUsage.h"
 #include "lmms_basics.h"
 #include "MicroTimer.h"
 
+//! Collects timing statistics of the periods rendered by the mixer
+//!
+//! All statistics are updated with atomic operations only, so the audio
+//! thread and the worker threads never block on the profiler. They can be
+//! read from any thread at any time, but values from different calls may
+//! belong to different periods.
 class MixerProfiler
 {
 public:
+	//! What the processing time of a period is spent on
+	enum class DetailType
+	{
+		NoteSetup,	// song and pattern sequencing, adding play handles
+		Instruments,	// rendering play handles
+		Effects,	// volume, panning and effects of audio ports
+		Mixing,		// FX channels and the master mix
+		Count
+	} ;
+
+	//! The render time histogram counts periods in bins of this many
+	//! percent of the period's deadline. The last bin also holds all
+	//! periods taking longer.
+	static const int HistogramBinWidth = 10;
+	static const int HistogramBins = 16;
+
 	MixerProfiler();
 	~MixerProfiler();
 
+	//! Set the number of threads processing jobs, including the one
+	//! rendering the period. Must not be called while rendering.
+	void setWorkerCount( int workers );
+
 	void startPeriod()
 	{
 		m_periodTimer.reset();
@@ -43,19 +74,126 @@ public:
 
 	void finishPeriod( sample_rate_t sampleRate, fpp_t framesPerPeriod );
 
+	//! Account time to the current period, thread-safe
+	void addDetailTime( DetailType type, int64_t nanoseconds )
+	{
+		m_currentDetailTime[static_cast<int>( type )].fetch_add(
+					nanoseconds, std::memory_order_relaxed );
+	}
+
+	//! Account the time a worker spent processing a job to the current
+	//! period, thread-safe
+	void addJobTime( DetailType type, int worker, int64_t nanoseconds )
+	{
+		addDetailTime( type, nanoseconds );
+		if( worker < m_workerCount )
+		{
+			m_workerBusyTime[worker].fetch_add( nanoseconds, std::memory_order_relaxed );
+		}
+	}
+
 	int cpuLoad() const
 	{
 		return m_cpuLoad;
 	}
 
+	//! Number of periods rendered so far
+	int64_t periods() const
+	{
+		return m_periods.load( std::memory_order_relaxed );
+	}
+
+	//! Number of periods which took longer to render than they last
+	int64_t deadlineMisses() const
+	{
+		return m_deadlineMisses.load( std::memory_order_relaxed );
+	}
+
+	int64_t histogramCount( int bin ) const
+	{
+		return m_histogram[bin].load( std::memory_order_relaxed );
+	}
+
+	//! Render time of the last period in microseconds
+	int lastPeriodTime() const
+	{
+		return m_lastPeriodTime.load( std::memory_order_relaxed );
+	}
+
+	//! Longest render time of any period so far in microseconds
+	int maxPeriodTime() const
+	{
+		return m_maxPeriodTime.load( std::memory_order_relaxed );
+	}
+
+	//! Duration of the last period in microseconds
+	int periodDeadline() const
+	{
+		return m_periodDeadline.load( std::memory_order_relaxed );
+	}
+
+	//! Processing time spent on @p type in the last period in microseconds,
+	//! summed over all threads - with several workers this can exceed the
+	//! render time of the period
+	int detailTime( DetailType type ) const
+	{
+		return m_lastDetailTime[static_cast<int>( type )].load( std::memory_order_relaxed );
+	}
+
+	int workerCount() const
+	{
+		return m_workerCount;
+	}
+
+	//! Total time in microseconds @p worker spent processing jobs
+	int64_t workerBusyTime( int worker ) const
+	{
+		return m_workerBusyTime[worker].load( std::memory_order_relaxed ) / 1000;
+	}
+
+	//! Total time in microseconds @p worker spent without a job while
+	//! periods were rendered
+	int64_t workerIdleTime( int worker ) const
+	{
+		return qMax<int64_t>( 0, m_totalPeriodTime.load( std::memory_order_relaxed ) / 1000 -
+								workerBusyTime( worker ) );
+	}
+
+	//! Untranslated name of @p type, for translating in the
+	//! "MixerProfiler" context
+	static const char * detailName( DetailType type );
+
+	//! Dump one line per period to @p outputFile and a summary of all
+	//! statistics once profiling ends
 	void setOutputFile( const QString& outputFile );
 
+	//! Add the CPU usage of a part of the project to the summary, if an
+	//! output file is set
+	void writeCpuUsage( const QString& name, const CpuUsage& usage );
+
 
 private:
+	void writeSummary();
+
 	MicroTimer m_periodTimer;
 	int m_cpuLoad;
 	QFile m_outputFile;
 
+	std::atomic<int64_t> m_periods;
+	std::atomic<int64_t> m_deadlineMisses;
+	std::atomic<int64_t> m_histogram[HistogramBins];
+	std::atomic_int m_lastPeriodTime;
+	std::atomic_int m_maxPeriodTime;
+	std::atomic_int m_periodDeadline;
+	std::atomic<int64_t> m_totalPeriodTime;
+
+	// in nanoseconds, as many jobs take less than a microsecond
+	std::atomic<int64_t> m_currentDetailTime[static_cast<int>( DetailType::Count )];
+	std::atomic_int m_lastDetailTime[static_cast<int>( DetailType::Count )];
+
+	int m_workerCount;
+	std::unique_ptr<std::atomic<int64_t>[]> m_workerBusyTime;
+
 };
 
 #endif
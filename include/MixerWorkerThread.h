@@ -28,9 +28,13 @@
 #include <QtCore/QThread>
 
 #include <atomic>
+#include <vector>
+
+#include "EventCount.h"
+#include "WorkStealingDeque.h"
 
-class QWaitCondition;
 class Mixer;
+class MixerProfiler;
 class ThreadableJob;
 
 class MixerWorkerThread : public QThread
@@ -38,6 +42,10 @@ class MixerWorkerThread : public QThread
 	Q_OBJECT
 public:
 	// internal representation of the job queue - all functions are thread-safe
+	//
+	// Every thread processing jobs owns a deque it pushes new jobs to and
+	// pops jobs from. Threads running out of work steal from the other
+	// deques and park on an event count once no job is left anywhere.
 	class JobQueue
 	{
 	public:
@@ -47,28 +55,71 @@ public:
 			Dynamic	// jobs can be added while processing queue
 		} ;
 
-#define JOB_QUEUE_SIZE 8192
-		JobQueue() :
-			m_items(),
-			m_writeIndex( 0 ),
-			m_itemsDone( 0 ),
-			m_opMode( Static )
-		{
-			std::fill(m_items, m_items + JOB_QUEUE_SIZE, nullptr);
-		}
+		JobQueue();
+		~JobQueue();
 
 		void reset( OperationMode _opMode );
 
-		void addJob( ThreadableJob * _job );
+		bool addJob( ThreadableJob * _job );
 
 		void run();
 		void wait();
 
+		// create the deque of a new worker thread and return its slot
+		int addSlot();
+
+		// highest number of jobs a single deque held at once so far
+		int peakDepth() const
+		{
+			return m_peakDepth;
+		}
+
+		// start or stop the thread preparing room in the deques whenever
+		// the peak depth rises, so neither rendering nor worker threads
+		// allocate - all slots must be added before starting it
+		void startGrower();
+		void stopGrower();
+
+		// wake up parked worker threads
+		void notifyWorkers()
+		{
+			m_jobsAvailable.notify();
+		}
+
+		void waitForJobs();
+
+		// job processing times are reported to this profiler, if any
+		void setProfiler( MixerProfiler * profiler )
+		{
+			m_profiler = profiler;
+		}
+
 	private:
-		std::atomic<ThreadableJob*> m_items[JOB_QUEUE_SIZE];
-		std::atomic_int m_writeIndex;
+		typedef WorkStealingDeque<ThreadableJob> Deque;
+		class Grower;
+
+		ThreadableJob * takeJob();
+
+		bool hasPendingJobs() const
+		{
+			return m_itemsTaken.load() < m_itemsQueued.load();
+		}
+
+		// slot 0 belongs to the thread rendering the current period
+		std::vector<Deque *> m_deques;
+		std::atomic_int m_itemsQueued;
+		std::atomic_int m_itemsTaken;
 		std::atomic_int m_itemsDone;
+		std::atomic_int m_peakDepth;
+		// depth the deques have room for without growing, with headroom
+		std::atomic_int m_reservedDepth;
 		OperationMode m_opMode;
+		MixerProfiler * m_profiler;
+
+		EventCount m_jobsAvailable;
+		EventCount m_jobsDone;
+		EventCount m_depthRaised;
+		Grower * m_grower;
 
 	} ;
 
@@ -84,9 +135,10 @@ public:
 		globalJobQueue.reset( _opMode );
 	}
 
-	static void addJob( ThreadableJob * _job )
+	// returns false if the job doesn't require processing
+	static bool addJob( ThreadableJob * _job )
 	{
-		globalJobQueue.addJob( _job );
+		return globalJobQueue.addJob( _job );
 	}
 
 	// a convenient helper function allowing to pass a container with pointers
@@ -104,14 +156,34 @@ public:
 
 	static void startAndWaitForJobs();
 
+	static void setProfiler( MixerProfiler * profiler )
+	{
+		globalJobQueue.setProfiler( profiler );
+	}
+
+	static int peakJobQueueDepth()
+	{
+		return globalJobQueue.peakDepth();
+	}
+
+	static void startDequeGrower()
+	{
+		globalJobQueue.startGrower();
+	}
+
+	static void stopDequeGrower()
+	{
+		globalJobQueue.stopGrower();
+	}
+
 
 private:
 	void run() override;
 
 	static JobQueue globalJobQueue;
-	static QWaitCondition * queueReadyWaitCond;
 	static QList<MixerWorkerThread *> workerThreads;
 
+	int m_slot;
 	volatile bool m_quit;
 
 } ;
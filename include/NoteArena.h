@@ -0,0 +1,67 @@
+/*
+ * NoteArena.h - contiguous storage for the notes of a pattern
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef NOTE_ARENA_H
+#define NOTE_ARENA_H
+
+#include <memory>
+#include <vector>
+
+#include "Note.h"
+
+
+//! Allocates the notes of a pattern in slabs of consecutive slots
+//!
+//! Notes added one after another, as when loading a project or importing
+//! a MIDI file, end up next to each other in memory, so walking the notes
+//! of a pattern doesn't miss the cache on every note. A note keeps its
+//! address until it is destroyed, so editors can hold on to Note pointers
+//! as before. All notes have to be destroyed before the arena.
+class NoteArena
+{
+public:
+	NoteArena();
+
+	NoteArena( const NoteArena & ) = delete;
+	NoteArena & operator=( const NoteArena & ) = delete;
+
+	Note * create( const Note & note = Note() );
+	void destroy( Note * note );
+
+private:
+	static const int SlabSize = 256;
+
+	union Slot
+	{
+		Slot * next;
+		alignas( Note ) unsigned char storage[sizeof( Note )];
+	} ;
+
+	std::vector<std::unique_ptr<Slot[]>> m_slabs;
+	Slot * m_freeList;
+
+} ;
+
+
+#endif
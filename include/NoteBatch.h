@@ -0,0 +1,138 @@
+/*
+ * NoteBatch.h - all notes of an instrument track rendered in one go
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef NOTE_BATCH_H
+#define NOTE_BATCH_H
+
+#include <vector>
+
+#include "lmms_basics.h"
+#include "lmms_export.h"
+#include "ThreadableJob.h"
+
+class InstrumentTrack;
+class NotePlayHandle;
+
+
+//! All notes of an instrument track which play in the current period
+//!
+//! The mixer renders the notes of instruments with the IsBatchRendered flag
+//! as one job per track instead of one job per note, and the instrument gets
+//! all voices passed to Instrument::playNotes() at once. The state of the
+//! voices is laid out as one array per property, so an instrument can
+//! process several voices in one loop. Each voice renders into the buffer
+//! of its note, as Instrument::playNote() does. The notes are only locked
+//! while they advance to the current period and after rendering, not
+//! while the instrument renders the whole batch.
+class LMMS_EXPORT NoteBatch : public ThreadableJob
+{
+public:
+	NoteBatch( InstrumentTrack * track );
+
+	//! Number of voices to render
+	int size() const
+	{
+		return static_cast<int>( m_voices.size() );
+	}
+
+	NotePlayHandle * note( int voice ) const
+	{
+		return m_voices[voice];
+	}
+
+	sampleFrame * const * buffers() const
+	{
+		return m_buffers.data();
+	}
+
+	//! Frequency of each voice in Hz
+	const float * frequencies() const
+	{
+		return m_frequencies.data();
+	}
+
+	//! First frame in the buffer each voice renders to, non-zero only in
+	//! the first period of a note
+	const f_cnt_t * offsets() const
+	{
+		return m_offsets.data();
+	}
+
+	//! Number of frames each voice renders from its offset on
+	const fpp_t * frames() const
+	{
+		return m_frames.data();
+	}
+
+	//! Number of frames each voice played in earlier periods
+	const f_cnt_t * framesPlayed() const
+	{
+		return m_framesPlayed.data();
+	}
+
+	//! Queue a note for the current period, returns true if it's the first
+	//! one, so the batch itself has to be queued
+	bool addNote( NotePlayHandle * note )
+	{
+		m_notes.push_back( note );
+		return m_notes.size() == 1;
+	}
+
+	bool requiresProcessing() const override
+	{
+		return !m_notes.empty();
+	}
+
+	MixerProfiler::DetailType detailType() const override
+	{
+		return MixerProfiler::DetailType::Instruments;
+	}
+
+	void addProcessingTime( int64_t nanoseconds ) override;
+
+
+protected:
+	void doProcessing() override;
+
+
+private:
+	InstrumentTrack * m_track;
+
+	// notes queued for this period
+	std::vector<NotePlayHandle *> m_notes;
+	// notes which play in this period
+	std::vector<NotePlayHandle *> m_playing;
+
+	// one entry per voice the instrument renders
+	std::vector<NotePlayHandle *> m_voices;
+	std::vector<sampleFrame *> m_buffers;
+	std::vector<float> m_frequencies;
+	std::vector<f_cnt_t> m_offsets;
+	std::vector<fpp_t> m_frames;
+	std::vector<f_cnt_t> m_framesPlayed;
+
+} ;
+
+
+#endif
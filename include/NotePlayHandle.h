@@ -34,7 +34,6 @@
 #include "Track.h"
 #include "MemoryManager.h"
 
-class QReadWriteLock;
 class InstrumentTrack;
 class NotePlayHandle;
 
@@ -110,10 +109,20 @@ public:
 	/*! Renders one chunk using the attached instrument into the buffer */
 	void play( sampleFrame* buffer ) override;
 
+	/*! First half of play() for rendering notes in batches: advances the
+	    note to the current period. Returns false if the note doesn't play
+	    in this period, otherwise it returns with the note locked and
+	    finishPlaying() must follow once the instrument rendered it. */
+	bool startPlaying();
+
+	/*! Second half of play(), called with the note locked, unlocks it */
+	void finishPlaying();
+
 	/*! Returns whether playback of note is finished and thus handle can be deleted */
 	bool isFinished() const override
 	{
-		return m_released && framesLeft() <= 0;
+		return ( m_released && framesLeft() <= 0 ) ||
+			( isFadingOut() && m_fadeOutDone >= m_fadeOutLength );
 	}
 
 	/*! Returns number of frames left for playback */
@@ -164,6 +173,24 @@ public:
 		return m_releaseStarted;
 	}
 
+	/*! Releases the note and fades it out within a few milliseconds,
+	    regardless of its release envelope - used for stealing voices */
+	void fadeOut();
+
+	/*! Returns whether the note is being faded out */
+	bool isFadingOut() const
+	{
+		return m_fadeOutLength > 0;
+	}
+
+	/*! Returns the peak of the period played last - notes which didn't
+	    play yet are considered loudest */
+	float lastPeak() const;
+
+	/*! Done rendering into the buffer, remembers its peak for lastPeak()
+	    since the buffer is released once the audio port mixed it */
+	void finishBuffer() override;
+
 	/*! Returns total numbers of frames played so far */
 	f_cnt_t totalFramesPlayed() const
 	{
@@ -297,6 +324,7 @@ private:
 	f_cnt_t m_totalFramesPlayed;			// total frame-counter - used for
 											// figuring out whether a whole note
 											// has been played
+	f_cnt_t m_framesThisPeriod;				// frames played in the current period
 	f_cnt_t m_framesBeforeRelease;			// number of frames after which note
 											// is released
 	f_cnt_t m_releaseFramesToDo;			// total numbers of frames to be
@@ -329,12 +357,22 @@ private:
 	Origin m_origin;
 
 	bool m_frequencyNeedsUpdate;				// used to update pitch
+
+	f_cnt_t m_fadeOutLength;				// length of fade out after stealing
+	f_cnt_t m_fadeOutDone;					// frames faded out so far
+	float m_lastPeak;						// peak of the period played last
 } ;
 
 
 const int INITIAL_NPH_CACHE = 256;
-const int NPH_CACHE_INCREMENT = 16;
-
+const int NPH_CACHE_INCREMENT = 64;
+
+//! Pool of memory for NotePlayHandles
+//!
+//! acquire() and release() neither block nor allocate: every thread keeps a
+//! small cache of free handles which it exchanges in batches with a shared
+//! lock-free freelist, and a background thread grows the pool before the
+//! freelist runs dry.
 class NotePlayHandleManager
 {
 	MM_OPERATORS
@@ -348,14 +386,9 @@ public:
 					int midiEventChannel = -1,
 					NotePlayHandle::Origin origin = NotePlayHandle::OriginPattern );
 	static void release( NotePlayHandle * nph );
+	//! Add at least @p i handles to the pool - allocates and may block
 	static void extend( int i );
 	static void free();
-
-private:
-	static NotePlayHandle ** s_available;
-	static QReadWriteLock s_mutex;
-	static std::atomic_int s_availableIndex;
-	static int s_size;
 };
 
 
@@ -34,6 +34,7 @@
 
 
 #include "Note.h"
+#include "NoteArena.h"
 #include "Track.h"
 
 
@@ -140,6 +141,7 @@ private:
 	PatternTypes m_patternType;
 
 	// data-stuff
+	NoteArena m_noteArena;
 	NoteVector m_notes;
 	int m_steps;
 
@@ -94,6 +94,13 @@ public:
 		return !isFinished();
 	}
 
+	MixerProfiler::DetailType detailType() const override
+	{
+		return MixerProfiler::DetailType::Instruments;
+	}
+
+	void addProcessingTime( int64_t nanoseconds ) override;
+
 	void lock()
 	{
 		m_processingLock.lock();
@@ -148,6 +155,15 @@ public:
 	
 	sampleFrame * buffer();
 
+	//! Clears the buffer for rendering a period into it, if the handle
+	//! uses one
+	void startBuffer();
+	//! Done rendering into the buffer
+	virtual void finishBuffer();
+	//! Peak of the period rendered last, zero if the handle doesn't use a
+	//! buffer
+	float bufferPeak() const;
+
 private:
 	Type m_type;
 	f_cnt_t m_offset;
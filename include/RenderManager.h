@@ -63,6 +63,9 @@ private slots:
 private:
 	QString pathForTrack( const Track *track, int num );
 	void restoreMutedState();
+	//! Write the CPU usage of all tracks, effects and FX channels to the
+	//! profiler output
+	void writeCpuUsage();
 
 	void render( QString outputPath );
 
@@ -26,6 +26,8 @@
 #ifndef SAMPLE_BUFFER_H
 #define SAMPLE_BUFFER_H
 
+#include <memory>
+
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QObject>
 
@@ -37,6 +39,8 @@
 #include "lmms_math.h"
 #include "shared_object.h"
 #include "MemoryManager.h"
+#include "SampleCache.h"
+#include "SampleStream.h"
 
 
 class QPainter;
@@ -73,6 +77,7 @@ public:
 		void setFrameIndex( f_cnt_t _index )
 		{
 			m_frameIndex = _index;
+			m_fraction = 0;
 		}
 
 		bool isBackwards() const
@@ -93,10 +98,15 @@ public:
 
 	private:
 		f_cnt_t m_frameIndex;
+		// position between m_frameIndex and the frame played after it,
+		// when SampleBuffer interpolates without libsamplerate
+		double m_fraction;
 		const bool m_varyingPitch;
 		bool m_isBackwards;
 		SRC_STATE * m_resamplingData;
 		int m_interpolationMode;
+		// the frames fed to libsamplerate when they aren't in one piece
+		MmAllocator<sampleFrame>::vector m_fragment;
 
 		friend class SampleBuffer;
 
@@ -206,11 +216,39 @@ public:
 		m_sampleRate = _rate;
 	}
 
+	//! Returns NULL while the audio file is streamed
 	inline const sampleFrame * data() const
 	{
 		return m_data;
 	}
 
+	//! Lets update() stream long audio files from disk instead of
+	//! decoding them into memory. Only for buffers that are just played
+	//! and drawn, as data() has nothing to offer then.
+	void setStreamingEnabled( bool _on )
+	{
+		m_streamingEnabled = _on;
+	}
+
+	bool isStreaming() const
+	{
+		return m_stream != nullptr;
+	}
+
+	//! Prepares a streamed audio file to start playing at @p _frame
+	void prefetch( f_cnt_t _frame );
+
+	//! Lets visualize() draw @p _peaks of data(), like the ones collected
+	//! while recording it, instead of computing them
+	void setPeaks( std::unique_ptr<SamplePeaks> _peaks );
+
+	//! Decodes @p _audio_file into the SampleCache, on any thread and
+	//! without stopping the mixer, and returns the entry, which keeps it
+	//! cached. Files that would be streamed if @p _streamed is set, or
+	//! that can't be loaded, are skipped and nullptr is returned.
+	static SampleCache::EntryPtr preload( const QString & _audio_file,
+							bool _streamed );
+
 	QString openAudioFile() const;
 	QString openAndSetAudioFile();
 	QString openAndSetWaveformFile();
@@ -265,6 +303,23 @@ private:
 	static sample_rate_t mixerSampleRate();
 
 	void update( bool _keep_settings = false );
+	void visualizeStream( QPainter & p, const QRect & dr, const QRect & clip,
+				f_cnt_t from_frame, f_cnt_t to_frame );
+	//! Draws the peaks of the pixels in @p clip, computed from @p data
+	//! where the peaks are too coarse, unless it's nullptr
+	void visualizePeaks( QPainter & p, const QRect & dr, const QRect & clip,
+				const SamplePeaks & samplePeaks, const sampleFrame * data,
+				f_cnt_t first, f_cnt_t nb_frames );
+	// the peaks of the cached frames, or of m_data, computed on demand
+	const SamplePeaks & peaks();
+	void adjustFrameSettings( const sample_rate_t _old_rate,
+						bool _keep_settings );
+
+	// frees m_data or lets go of the cached frames it points to, and
+	// closes the stream
+	void releaseData();
+	// gives the buffer its own copy of cached frames before changing them
+	void detachData();
 
 	void convertIntToFloat(int_sample_t * & ibuf, f_cnt_t frames, int channels);
 	void directFloatWrite(sample_t * & fbuf, f_cnt_t frames, int channels);
@@ -285,6 +340,14 @@ private:
 	sampleFrame * m_origData;
 	f_cnt_t m_origFrames;
 	sampleFrame * m_data;
+	// set if m_data points to frames shared through the SampleCache,
+	// which must not be changed
+	SampleCache::EntryPtr m_cacheEntry;
+	// set instead of m_data while the audio file is streamed
+	SampleStream::Ptr m_stream;
+	// peaks of m_data unless it's cached, reset whenever it changes
+	std::unique_ptr<SamplePeaks> m_peaks;
+	bool m_streamingEnabled;
 	QReadWriteLock m_varLock;
 	f_cnt_t m_frames;
 	f_cnt_t m_startFrame;
@@ -296,11 +359,17 @@ private:
 	float m_frequency;
 	sample_rate_t m_sampleRate;
 
-	sampleFrame * getSampleFragment( f_cnt_t _index, f_cnt_t _frames,
+	// returns the frames from _index on in playing order, right from
+	// m_data if possible, else copied to _buffer
+	const sampleFrame * getSampleFragment( f_cnt_t _index, f_cnt_t _frames,
 						LoopMode _loopmode,
-						sampleFrame * * _tmp,
+						sampleFrame * _buffer,
 						bool * _backwards, f_cnt_t _loopstart, f_cnt_t _loopend,
 						f_cnt_t _end ) const;
+	void readStream( sampleFrame * _dst, f_cnt_t _index, f_cnt_t _frames,
+						LoopMode _loopmode, bool * _backwards,
+						f_cnt_t _loopstart, f_cnt_t _loopend,
+						f_cnt_t _end ) const;
 	f_cnt_t getLoopedIndex( f_cnt_t _index, f_cnt_t _startf, f_cnt_t _endf  ) const;
 	f_cnt_t getPingPongIndex( f_cnt_t _index, f_cnt_t _startf, f_cnt_t _endf  ) const;
 
@@ -0,0 +1,144 @@
+/*
+ * SampleCache.h - decoded samples shared by all SampleBuffers of a file
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_CACHE_H
+#define SAMPLE_CACHE_H
+
+#include <deque>
+#include <memory>
+#include <utility>
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include "lmms_basics.h"
+#include "lmms_export.h"
+#include "SamplePeaks.h"
+
+
+class QFile;
+
+
+//! Process-wide cache of decoded audio files
+//!
+//! A file is decoded and resampled to the mixer's rate once, however many
+//! tracks and instruments play it. The frames are reference counted: an
+//! entry lives as long as a SampleBuffer uses it, plus a few of the most
+//! recently used ones, so samples that come and go like the metronome
+//! clicks aren't decoded over and over. Entries are keyed by the file's
+//! path, size and modification time and the sample rate, so an edited
+//! file or a changed sample rate never hits a stale entry.
+//!
+//! Entries are also written to cache files in the user's cache directory
+//! along with their peaks, named after a hash of the key. When a project
+//! is opened again, the files are mapped into memory read-only instead of
+//! being decoded, and several instances of LMMS share their pages.
+class LMMS_EXPORT SampleCache
+{
+public:
+	//! Decoded frames, immutable once cached
+	class LMMS_EXPORT Entry
+	{
+	public:
+		//! Takes ownership of @p data, which must be allocated with MM_ALLOC,
+		//! and computes its peaks
+		Entry( sampleFrame * data, f_cnt_t frames );
+		~Entry();
+
+		Entry( const Entry & ) = delete;
+		Entry & operator=( const Entry & ) = delete;
+
+		const sampleFrame * data() const
+		{
+			return m_data;
+		}
+
+		f_cnt_t frames() const
+		{
+			return m_frames;
+		}
+
+		const SamplePeaks & peaks() const
+		{
+			return m_peaks;
+		}
+
+	private:
+		// uses frames and peaks mapped from a cache file
+		Entry( std::unique_ptr<QFile> file, const sampleFrame * data,
+			f_cnt_t frames, const SamplePeaks::Peak * peaks );
+
+		// set if the entry is mapped from it, else m_data is owned
+		std::unique_ptr<QFile> m_file;
+		const sampleFrame * m_data;
+		f_cnt_t m_frames;
+		SamplePeaks m_peaks;
+
+		friend class SampleCache;
+	} ;
+
+	typedef std::shared_ptr<const Entry> EntryPtr;
+
+	//! Returns the key of the absolute path @p file decoded at @p sampleRate,
+	//! or an empty string if the file doesn't exist
+	static QString key( const QString & file, sample_rate_t sampleRate );
+
+	//! Returns the entry for @p key, from memory or a cache file, or nullptr
+	//! if it isn't cached. If another thread claimed the key, waits for it
+	//! to cache the file or give up first.
+	static EntryPtr find( const QString & key );
+
+	//! Tells other threads that the calling one is about to decode the
+	//! file of @p key, so they wait for it in find() instead of decoding
+	//! it as well. Returns false if the key is cached or claimed already.
+	//! The claim ends with insert() or release().
+	static bool claim( const QString & key );
+
+	//! Gives up a claim on @p key without caching anything
+	static void release( const QString & key );
+
+	//! Caches @p frames frames at @p data, taking ownership of them, and
+	//! returns the entry. If another thread cached the same key meanwhile,
+	//! its entry is returned and @p data freed. The cache file is written
+	//! in the background.
+	static EntryPtr insert( const QString & key, sampleFrame * data, f_cnt_t frames );
+
+	//! Writes the cache files still pending and stops the thread writing
+	//! them, called on exit
+	static void finishWriting();
+
+private:
+	static QString fileName( const QString & key );
+	static EntryPtr load( const QString & key );
+	// writes the cache files of a batch of entries, then prunes once
+	static void write( const std::deque<std::pair<QString, EntryPtr>> & entries );
+	static bool store( const QString & name, const QString & key, const Entry & entry );
+	static void prune( const QStringList & keep );
+
+	friend class SampleCacheWriter;
+
+} ;
+
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * SampleLoader.h - decodes the samples of a project in parallel
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_LOADER_H
+#define SAMPLE_LOADER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QtCore/QString>
+
+#include "SampleCache.h"
+
+
+class QDomElement;
+class QThread;
+
+
+//! Decodes the audio files a project refers to on several threads while
+//! the project is loaded
+//!
+//! The tracks are still created one after another on the loading thread,
+//! but by the time a SampleBuffer there gets to its file, it's usually in
+//! the SampleCache already. If a thread is still decoding it, the buffer
+//! waits for that one instead of decoding the file once more.
+class SampleLoader
+{
+public:
+	//! Starts decoding the files of the sample clips and
+	//! AudioFileProcessor instruments in @p project
+	SampleLoader( const QDomElement & project );
+	//! Skips the files not started yet and waits for the others
+	~SampleLoader();
+
+	SampleLoader( const SampleLoader & ) = delete;
+	SampleLoader & operator=( const SampleLoader & ) = delete;
+
+	//! Waits for all files and prints the ones that took longest, if
+	//! decoding took a noticeable time altogether
+	void report();
+
+private:
+	struct Sample
+	{
+		QString file;
+		// whether only sample clips play it, which may stream it
+		bool streamed;
+		// keeps the file cached until the project is loaded
+		SampleCache::EntryPtr entry;
+		qint64 msecs;
+	} ;
+
+	void addFiles( const QDomElement & project, const QString & tagName,
+							bool streamed );
+	void wait();
+
+	std::vector<Sample> m_samples;
+	std::atomic<std::size_t> m_next;
+	std::atomic_bool m_stop;
+	std::vector<std::unique_ptr<QThread>> m_threads;
+
+	friend class SampleLoaderThread;
+
+} ;
+
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * SamplePeaks.h - waveform overview of a sample at several zoom levels
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_PEAKS_H
+#define SAMPLE_PEAKS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "lmms_basics.h"
+#include "lmms_export.h"
+
+
+//! Minimum, maximum and RMS of a sample at several zoom levels
+//!
+//! Each peak of level 0 covers BaseFrames frames, each peak of the next
+//! level LevelFactor peaks of the one before, up to a level with a single
+//! peak. Stored one after another, the levels can be written to a file
+//! and used from it in place.
+class LMMS_EXPORT SamplePeaks
+{
+public:
+	struct Peak
+	{
+		float min[DEFAULT_CHANNELS];
+		float max[DEFAULT_CHANNELS];
+		float rms[DEFAULT_CHANNELS];
+	} ;
+
+	static const f_cnt_t BaseFrames = 256;
+	static const int LevelFactor = 4;
+
+	SamplePeaks();
+	//! Computes the peaks of @p frames frames at @p data
+	SamplePeaks( const sampleFrame * data, f_cnt_t frames );
+	//! Uses the size( @p frames ) peaks at @p peaks, which must stay valid
+	//! as long as this
+	SamplePeaks( const Peak * peaks, f_cnt_t frames );
+
+	SamplePeaks( const SamplePeaks & ) = delete;
+	SamplePeaks & operator=( const SamplePeaks & ) = delete;
+
+	//! Adds the peaks of @p frames more frames at @p data, which only
+	//! changes the last peaks of each level. Not for peaks used in place.
+	void append( const sampleFrame * data, f_cnt_t frames );
+
+	//! Makes room for the peaks of @p frames frames, so append() doesn't
+	//! allocate until there are more
+	void reserve( f_cnt_t frames );
+
+	f_cnt_t frames() const
+	{
+		return m_frames;
+	}
+
+	int levels() const
+	{
+		return static_cast<int>( m_levels.size() );
+	}
+
+	//! Returns the first peak of @p level
+	const Peak * level( int level ) const
+	{
+		return m_levels[level];
+	}
+
+	std::size_t levelSize( int level ) const;
+
+	//! Stores the peak of the frames from @p from to @p to in @p peak,
+	//! merged from at most 2 * LevelFactor peaks per level. The frames
+	//! are rounded out to whole peaks of level 0. Returns false if there
+	//! are none.
+	bool peak( f_cnt_t from, f_cnt_t to, Peak & peak ) const;
+
+	//! Returns the number of peaks of a sample of @p frames frames
+	static std::size_t size( f_cnt_t frames );
+
+private:
+	//! Returns the number of frames peak @p index of @p level covers
+	f_cnt_t peakFrames( int level, std::size_t index ) const;
+	void updateLevels();
+
+	// only used for peaks computed by this
+	std::vector<std::vector<Peak>> m_ownLevels;
+	f_cnt_t m_frames;
+	// first peak of each level
+	std::vector<const Peak *> m_levels;
+
+} ;
+
+
+#endif
@@ -26,11 +26,14 @@
 #ifndef SAMPLE_RECORD_HANDLE_H
 #define SAMPLE_RECORD_HANDLE_H
 
+#include <memory>
+
 #include <QtCore/QList>
 #include <QtCore/QPair>
 
 #include "MidiTime.h"
 #include "PlayHandle.h"
+#include "SamplePeaks.h"
 
 class BBTrack;
 class SampleBuffer;
@@ -59,6 +62,8 @@ private:
 
 	typedef QList<QPair<sampleFrame *, f_cnt_t> > bufferList;
 	bufferList m_buffers;
+	// collected along with the buffers for drawing the recorded sample
+	std::unique_ptr<SamplePeaks> m_peaks;
 	f_cnt_t m_framesRecorded;
 	MidiTime m_minLength;
 
@@ -0,0 +1,180 @@
+/*
+ * SampleStream.h - plays long audio files from disk
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SAMPLE_STREAM_H
+#define SAMPLE_STREAM_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+
+#include <sndfile.h>
+
+#include "lmms_basics.h"
+#include "lmms_export.h"
+#include "SamplePeaks.h"
+
+
+//! An audio file decoded while it plays instead of all at once
+//!
+//! A background I/O thread shared by all streams decodes ahead of the
+//! playback position into a ring, which the audio thread reads without
+//! locking. Jumps the player is going to make, like to the start of a
+//! clip or of the song's loop, can be cued: the frames after the cue point
+//! are kept decoded, so playback continues from there without a gap while
+//! the ring catches up. Any other jump plays silence until the I/O thread
+//! has decoded the new position, which takes a few milliseconds.
+//!
+//! A stream serves one player at a time. Frames are indexed at the file's
+//! own sample rate.
+class LMMS_EXPORT SampleStream
+{
+public:
+	//! Hands a stream to the I/O thread, which deletes it once it's done
+	//! with it, so a stream can be closed on the audio thread
+	struct Closer
+	{
+		void operator()( SampleStream * stream ) const;
+	} ;
+
+	typedef std::unique_ptr<SampleStream, Closer> Ptr;
+
+	//! Opens @p file for streaming, backwards if @p reversed is set, or
+	//! returns nullptr if libsndfile can't seek in it or it plays for less
+	//! than @p minSeconds. @p overviewUpdated is called on the I/O thread
+	//! whenever more peaks are available, but not anymore once the stream
+	//! is closed.
+	static Ptr open( const QString & file, bool reversed,
+					int minSeconds, std::function<void()> overviewUpdated );
+
+	//! Deletes the streams still being closed and stops the I/O thread,
+	//! called on exit
+	static void finishClosing();
+
+	SampleStream( const SampleStream & ) = delete;
+	SampleStream & operator=( const SampleStream & ) = delete;
+
+	f_cnt_t frames() const
+	{
+		return m_frames;
+	}
+
+	sample_rate_t sampleRate() const
+	{
+		return m_sampleRate;
+	}
+
+	//! Copies @p frames frames from @p index on to @p dst. Frames that
+	//! aren't decoded yet are silent and make it return false. Frames
+	//! before @p index are dropped from the ring, so reading on from a
+	//! later index is cheap but reading from an earlier one is a jump.
+	bool read( sampleFrame * dst, f_cnt_t index, f_cnt_t frames );
+
+	//! Keeps the frames from @p index on decoded for a jump there
+	void cue( f_cnt_t index );
+
+	//! Calls @p visit with the peaks of the frames the I/O thread has
+	//! scanned so far, which it doesn't add to meanwhile
+	void visitPeaks( const std::function<void( const SamplePeaks & )> & visit ) const;
+
+private:
+	SampleStream( std::unique_ptr<QFile> file, SNDFILE * sndFile,
+			const SF_INFO & info, bool reversed,
+			std::function<void()> overviewUpdated );
+	~SampleStream();
+
+	// reader side
+	f_cnt_t readRing( sampleFrame * dst, f_cnt_t index, f_cnt_t frames );
+	f_cnt_t readCue( sampleFrame * dst, f_cnt_t index, f_cnt_t frames,
+						f_cnt_t & cueEnd );
+	bool isSeekPending() const;
+	bool expects( f_cnt_t index ) const;
+	void requestSeek( f_cnt_t index );
+
+	// I/O thread side, each returns whether there was work to do
+	bool service();
+	bool seek();
+	bool loadCue();
+	bool fillRing();
+	bool scanOverview();
+	void decode( sampleFrame * dst, f_cnt_t index, f_cnt_t frames );
+
+	// libsndfile reads from the descriptor of m_file
+	std::unique_ptr<QFile> m_file;
+	SNDFILE * m_sndFile;
+	const f_cnt_t m_frames;
+	const sample_rate_t m_sampleRate;
+	const int m_channels;
+	const bool m_reversed;
+	const std::function<void()> m_overviewUpdated;
+
+	// the ring holds the frames from m_origin + m_read to
+	// m_origin + m_written. Only the reader moves m_read and only the I/O
+	// thread the others, except for resetting the ring after a jump.
+	const f_cnt_t m_ringFrames;
+	sampleFrame * m_ring;
+	std::atomic<f_cnt_t> m_origin;
+	std::atomic<f_cnt_t> m_written;
+	std::atomic<f_cnt_t> m_read;
+	std::atomic_flag m_reading;
+
+	// the reader asks for a jump by storing the frame and counting up
+	// m_seekRequest, the I/O thread acknowledges it by resetting the ring
+	// and setting m_seekDone to the same count
+	std::atomic<f_cnt_t> m_seekFrame;
+	std::atomic_int m_seekRequest;
+	std::atomic_int m_seekDone;
+	f_cnt_t m_requestedFrame;
+
+	// m_cueStart and m_cueFrames are only changed while m_cueValid is
+	// unset and no reader is in the cue
+	const f_cnt_t m_maxCueFrames;
+	sampleFrame * m_cue;
+	std::atomic<f_cnt_t> m_cueRequest;
+	f_cnt_t m_cueStart;
+	f_cnt_t m_cueFrames;
+	std::atomic_bool m_cueValid;
+	std::atomic_int m_cueReaders;
+
+	// only the I/O thread adds to m_peaks, with m_peaksMutex held
+	SamplePeaks m_peaks;
+	mutable QMutex m_peaksMutex;
+
+	// only used by the I/O thread
+	f_cnt_t m_filePos;
+	std::vector<float> m_decodeBuffer;
+	sampleFrame * m_scanBuffer;
+	// set when m_overviewUpdated is due
+	bool m_overviewPending;
+
+	friend class SampleStreamThread;
+
+} ;
+
+
+#endif
@@ -68,6 +68,9 @@ public:
 	MidiTime sampleLength() const;
 	void setSampleStartFrame( f_cnt_t startFrame );
 	void setSamplePlayLength( f_cnt_t length );
+	//! Lets a streamed sample start playing at song position @p time
+	//! without a gap
+	void prefetch( const MidiTime & time );
 	TrackContentObjectView * createView( TrackView * _tv ) override;
 
 
@@ -154,7 +157,7 @@ public:
 		return &m_effectChannelModel;
 	}
 
-	inline AudioPort * audioPort()
+	AudioPort * audioPort() override
 	{
 		return &m_audioPort;
 	}
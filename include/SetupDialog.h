@@ -89,6 +89,7 @@ private slots:
 	void toggleRunningAutoSave(bool enabled);
 	void toggleSmoothScroll(bool enabled);
 	void toggleAnimateAFP(bool enabled);
+	void setVoiceBudget(int value);
 	void toggleSyncVSTPlugins(bool enabled);
 	void vstEmbedMethodChanged();
 	void toggleVSTAlwaysOnTop(bool en);
@@ -152,6 +153,9 @@ private:
 	LedCheckBox * m_runningAutoSave;
 	bool m_smoothScroll;
 	bool m_animateAFP;
+	int m_voiceBudget;
+	QSlider * m_voiceBudgetSlider;
+	QLabel * m_voiceBudgetLbl;
 	QLabel * m_vstEmbedLbl;
 	QComboBox* m_vstEmbedComboBox;
 	QString m_vstEmbedMethod;
@@ -26,6 +26,7 @@
 #define SONG_H
 
 #include <utility>
+#include <vector>
 
 #include <QtCore/QSharedMemory>
 #include <QtCore/QVector>
@@ -268,9 +269,6 @@ public:
 		return m_globalAutomationTrack;
 	}
 
-	//TODO: Add Q_DECL_OVERRIDE when Qt4 is dropped
-	AutomatedValueMap automatedValuesAt(MidiTime time, int tcoNum = -1) const override;
-
 	// file management
 	void createNewProject();
 	void createNewProjectFromTemplate( const QString & templ );
@@ -405,7 +403,16 @@ private:
 
 	void removeAllControllers();
 
-	void processAutomations(const TrackList& tracks, MidiTime timeStart, fpp_t frames);
+	//! Applies automation to the frames [offset, offset + frames) of the
+	//! period, starting currentFrame frames into the tick at timeStart
+	void processAutomations(const TrackList& tracks, MidiTime timeStart,
+				float currentFrame, f_cnt_t offset, fpp_t frames);
+	//! Records the values of the recording patterns in @p container at
+	//! @p time and collects their models in m_recordedModels
+	void recordAutomation(const TrackContainer* container, MidiTime time,
+				float currentFrame);
+	void addAutomation(MidiTime time, int tcoNum, bool held,
+				AutomationCollection& collection) const override;
 
 	void setModified(bool value);
 
@@ -454,6 +461,15 @@ private:
 	tick_t m_elapsedTicks;
 	bar_t m_elapsedBars;
 
+	// kept between periods so processAutomations() doesn't allocate
+	Track::tcoVector m_automationTCOs;
+	std::vector<const AutomatableModel*> m_recordedModels;
+	// collected once per tick at m_automationTime, the patterns may
+	// change between periods
+	AutomationCollection m_automation;
+	MidiTime m_automationTime;
+	bool m_automationValid;
+
 	VstSyncController m_vstSyncController;
     
 	int m_loopRenderCount;
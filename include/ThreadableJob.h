@@ -26,6 +26,7 @@
 #define THREADABLE_JOB_H
 
 #include "lmms_basics.h"
+#include "MixerProfiler.h"
 
 #include <atomic>
 
@@ -78,6 +79,15 @@ public:
 
 	virtual bool requiresProcessing() const = 0;
 
+	//! What the profiler accounts the processing time of this job to
+	virtual MixerProfiler::DetailType detailType() const = 0;
+
+	//! Called with the time process() took, for per-track CPU accounting
+	virtual void addProcessingTime( int64_t nanoseconds )
+	{
+		Q_UNUSED( nanoseconds );
+	}
+
 
 protected:
 	virtual void doProcessing() = 0;
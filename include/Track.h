@@ -28,6 +28,9 @@
 
 #include <QtCore/QVector>
 #include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <atomic>
+#include <vector>
 #include <QWidget>
 #include <QSize>
 #include <QColor>
@@ -43,6 +46,7 @@
 #include "FadeButton.h"
 
 
+class AudioPort;
 class QMenu;
 class QPushButton;
 
@@ -620,6 +624,16 @@ public:
 	}
 	void getTCOsInRange( tcoVector & tcoV, const MidiTime & start,
 							const MidiTime & end );
+	//! Like getTCOsInRange(), but looks the TCOs up in an index sorted by
+	//! position. Moving forward through the song, as playback does, takes
+	//! amortized constant time. Only for the thread rendering the song.
+	void getTCOsToPlay( tcoVector & tcoV, const MidiTime & start,
+							const MidiTime & end );
+	//! Called whenever a TCO is added, removed, moved or resized
+	void invalidateTCOIndex()
+	{
+		m_tcoIndexValid = false;
+	}
 	void swapPositionOfTCOs( int tcoNum1, int tcoNum2 );
 
 	void createTCOsForBB( int bb );
@@ -636,6 +650,12 @@ public:
 		return m_trackContainer;
 	}
 
+	//! The port the track renders into, if it produces audio
+	virtual AudioPort * audioPort()
+	{
+		return nullptr;
+	}
+
 	// name-stuff
 	virtual const QString & name() const
 	{
@@ -712,6 +732,26 @@ private:
 
 	tcoVector m_trackContentObjects;
 
+	struct TCOIndexEntry
+	{
+		TrackContentObject * tco;
+		tick_t start;
+		tick_t end;
+		// highest end of this and all preceding TCOs
+		tick_t maxEnd;
+	} ;
+	void rebuildTCOIndex();
+
+	// TCOs sorted by start position for playback
+	std::vector<TCOIndexEntry> m_tcoIndex;
+	std::atomic_bool m_tcoIndexValid;
+	// range of the index looked at by the last getTCOsToPlay() call, which
+	// the next one most likely continues from
+	std::size_t m_tcoIndexFirst;
+	std::size_t m_tcoIndexLast;
+	tick_t m_tcoIndexStart;
+	tick_t m_tcoIndexEnd;
+
 	QMutex m_processingLock;
 	
 	QColor m_color;
@@ -26,6 +26,8 @@
 #ifndef TRACK_CONTAINER_H
 #define TRACK_CONTAINER_H
 
+#include <vector>
+
 #include <QtCore/QReadWriteLock>
 
 #include "Track.h"
@@ -48,6 +50,30 @@ public:
 		SongContainer
 	} ;
 
+	//! A model and the pattern automating it at some tick
+	struct ActiveAutomation
+	{
+		AutomatableModel* model;
+		const AutomationPattern* pattern;
+		//! the tick within the pattern
+		MidiTime time;
+		//! past the end of the pattern, so the value doesn't change
+		//! within the tick
+		bool held;
+		//! patterns collected later take precedence
+		int order;
+	} ;
+
+	//! The automation active at some tick, one entry per model, sorted
+	//! by model. Keeps its buffers, so collecting into the same
+	//! collection again doesn't allocate.
+	struct AutomationCollection
+	{
+		std::vector<ActiveAutomation> automation;
+		Track::tcoVector tcos;
+		Track::tcoVector bbTcos;
+	} ;
+
 	TrackContainer();
 	virtual ~TrackContainer();
 
@@ -93,13 +119,26 @@ public:
 		return m_TrackContainerType;
 	}
 
-	virtual AutomatedValueMap automatedValuesAt(MidiTime time, int tcoNum = -1) const;
+	//! Collects the pattern automating each model at @p time, in the
+	//! pattern with index @p tcoNum of every track or in all patterns if
+	//! it's negative
+	void collectAutomation(MidiTime time, int tcoNum, AutomationCollection& collection) const;
+
+	//! Values of all automated models at @p time
+	AutomatedValueMap automatedValuesAt(MidiTime time, int tcoNum = -1) const;
 
 signals:
 	void trackAdded( Track * _track );
 
 protected:
-	static AutomatedValueMap automatedValuesFromTracks(const TrackList &tracks, MidiTime timeStart, int tcoNum = -1);
+	//! Adds the automation of this container's tracks at @p time
+	virtual void addAutomation(MidiTime time, int tcoNum, bool held,
+				AutomationCollection& collection) const;
+	//! Adds the automation of @p globalTrack, if any, and @p tracks at
+	//! @p time, gathering their patterns in @p tcos
+	static void addAutomationFromTracks(Track* globalTrack, const TrackList& tracks,
+				MidiTime time, int tcoNum, bool held,
+				AutomationCollection& collection, Track::tcoVector& tcos);
 
 	mutable QReadWriteLock m_tracksMutex;
 
@@ -49,6 +49,7 @@ public slots:
 
 
 protected:
+	bool event( QEvent * _e ) override;
 	void dragEnterEvent( QDragEnterEvent * _dee ) override;
 	void dropEvent( QDropEvent * _de ) override;
 	void mousePressEvent( QMouseEvent * _me ) override;
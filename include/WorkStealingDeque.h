@@ -0,0 +1,239 @@
+/*
+ * WorkStealingDeque.h - lock-free work-stealing deque
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "MemoryManager.h"
+
+
+//! Chase-Lev work-stealing deque holding pointers
+//!
+//! The owning thread pushes and pops at the bottom, any other thread may
+//! steal from the top. Steal and pop never block or allocate. If a push
+//! finds the deque full, it switches to the array prepared by reserve() or
+//! doubles the capacity instead of failing.
+//! See Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+//! Models", PPoPP 2013.
+template<typename T>
+class WorkStealingDeque
+{
+public:
+	//! @param capacity Initial number of items, must be a power of two
+	WorkStealingDeque( std::size_t capacity ) :
+		m_top( 0 ),
+		m_bottom( 0 ),
+		m_array( new Array( capacity, nullptr ) ),
+		m_spare( nullptr )
+	{
+	}
+
+	~WorkStealingDeque()
+	{
+		delete m_array.load();
+		delete m_spare.load();
+	}
+
+	//! Owner only.
+	void push( T * item )
+	{
+		const int64_t b = m_bottom.load( std::memory_order_relaxed );
+		const int64_t t = m_top.load( std::memory_order_acquire );
+		Array * a = m_array.load( std::memory_order_relaxed );
+		if( b - t > static_cast<int64_t>( a->mask ) )
+		{
+			Array * spare = m_spare.exchange( nullptr, std::memory_order_acquire );
+			if( spare && spare->capacity() <= a->capacity() )
+			{
+				// we grew beyond it in the meantime
+				delete spare;
+				spare = nullptr;
+			}
+			a = grow( a, t, b, spare ? spare : new Array( a->capacity() * 2, nullptr ) );
+		}
+		a->put( b, item );
+		std::atomic_thread_fence( std::memory_order_release );
+		m_bottom.store( b + 1, std::memory_order_relaxed );
+	}
+
+	//! Owner only. Takes the most recently pushed item, or returns nullptr.
+	T * pop()
+	{
+		const int64_t b = m_bottom.load( std::memory_order_relaxed ) - 1;
+		Array * a = m_array.load( std::memory_order_relaxed );
+		m_bottom.store( b, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		int64_t t = m_top.load( std::memory_order_relaxed );
+
+		if( t > b )
+		{
+			// deque was empty
+			m_bottom.store( b + 1, std::memory_order_relaxed );
+			return nullptr;
+		}
+
+		T * item = a->get( b );
+		if( t == b )
+		{
+			// last item - race against thieves for it
+			if( !m_top.compare_exchange_strong( t, t + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed ) )
+			{
+				item = nullptr;
+			}
+			m_bottom.store( b + 1, std::memory_order_relaxed );
+		}
+		return item;
+	}
+
+	//! Any thread. Takes the oldest item, or returns nullptr if the deque
+	//! is empty or another thread won the race for the item.
+	T * steal()
+	{
+		int64_t t = m_top.load( std::memory_order_acquire );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		const int64_t b = m_bottom.load( std::memory_order_acquire );
+
+		if( t >= b )
+		{
+			return nullptr;
+		}
+
+		Array * a = m_array.load( std::memory_order_acquire );
+		T * item = a->get( t );
+		if( !m_top.compare_exchange_strong( t, t + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		{
+			return nullptr;
+		}
+		return item;
+	}
+
+	//! Any thread, but only one at a time. Allocates an array for @p count
+	//! items, which the owner switches to once the deque fills up, so that
+	//! pushing doesn't allocate until the deque holds more items than that.
+	void reserve( std::size_t count )
+	{
+		std::size_t capacity = this->capacity();
+		Array * spare = m_spare.load( std::memory_order_relaxed );
+		if( count <= capacity || ( spare && count <= spare->capacity() ) )
+		{
+			return;
+		}
+		while( capacity < count )
+		{
+			capacity *= 2;
+		}
+		delete m_spare.exchange( new Array( capacity, nullptr ), std::memory_order_acq_rel );
+	}
+
+	std::size_t capacity() const
+	{
+		return m_array.load( std::memory_order_acquire )->capacity();
+	}
+
+	//! Any thread. Number of items, may be outdated as soon as it returns.
+	std::size_t size() const
+	{
+		const int64_t t = m_top.load( std::memory_order_relaxed );
+		const int64_t b = m_bottom.load( std::memory_order_relaxed );
+		return b > t ? static_cast<std::size_t>( b - t ) : 0;
+	}
+
+	bool empty() const
+	{
+		return m_top.load( std::memory_order_relaxed ) >=
+				m_bottom.load( std::memory_order_relaxed );
+	}
+
+private:
+	struct Array
+	{
+		MM_OPERATORS
+
+		Array( std::size_t capacity, Array * previous ) :
+			mask( capacity - 1 ),
+			items( MM_ALLOC( std::atomic<T*>, capacity ) ),
+			previous( previous )
+		{
+			for( std::size_t i = 0; i < capacity; ++i )
+			{
+				items[i].store( nullptr, std::memory_order_relaxed );
+			}
+		}
+
+		~Array()
+		{
+			MM_FREE( items );
+			delete previous;
+		}
+
+		std::size_t capacity() const
+		{
+			return mask + 1;
+		}
+
+		T * get( int64_t i ) const
+		{
+			return items[i & mask].load( std::memory_order_relaxed );
+		}
+
+		void put( int64_t i, T * item )
+		{
+			items[i & mask].store( item, std::memory_order_relaxed );
+		}
+
+		const std::size_t mask;
+		std::atomic<T*> * items;
+		// thieves may still read from arrays we grew out of, so they are
+		// kept alive until the deque itself is destroyed
+		Array * previous;
+	} ;
+
+	Array * grow( Array * a, int64_t t, int64_t b, Array * grown )
+	{
+		grown->previous = a;
+		for( int64_t i = t; i < b; ++i )
+		{
+			grown->put( i, a->get( i ) );
+		}
+		m_array.store( grown, std::memory_order_release );
+		return grown;
+	}
+
+	// keep the index thieves fight over away from the owner's index
+	alignas( 64 ) std::atomic<int64_t> m_top;
+	alignas( 64 ) std::atomic<int64_t> m_bottom;
+	std::atomic<Array *> m_array;
+	// prepared by reserve(), taken over by push()
+	std::atomic<Array *> m_spare;
+
+} ;
+
+
+#endif
@@ -25,66 +25,135 @@
 #ifndef FIFO_BUFFER_H
 #define FIFO_BUFFER_H
 
-#include <QtCore/QSemaphore>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
+#include "EventCount.h"
 
+
+//! Lock-free FIFO of fixed size for one writer and one reader thread
+//!
+//! Neither side takes a lock. A side only enters the kernel if it has to
+//! wait for the other one, and the time spent waiting is recorded, which
+//! tells whether the FIFO is too small (the reader starves) or the writer
+//! is rendering ahead more than needed.
 template<typename T>
 class fifoBuffer
 {
 public:
 	fifoBuffer( int _size ) :
-		m_reader_sem( _size ),
-		m_writer_sem( _size ),
-		m_reader_index( 0 ),
-		m_writer_index( 0 ),
-		m_size( _size )
+		m_buffer( new T[_size] ),
+		m_size( _size ),
+		m_readerIndex( 0 ),
+		m_writerIndex( 0 ),
+		m_readerBlockedTime( 0 ),
+		m_writerBlockedTime( 0 )
 	{
-		m_buffer = new T[_size];
-		m_reader_sem.acquire( _size );
 	}
 
 	~fifoBuffer()
 	{
 		delete[] m_buffer;
-		m_reader_sem.release( m_size );
 	}
 
+	//! Writer only. Blocks while the FIFO is full.
 	void write( T _element )
 	{
-		m_writer_sem.acquire();
-		m_buffer[m_writer_index++] = _element;
-		m_writer_index %= m_size;
-		m_reader_sem.release();
+		const uint64_t w = m_writerIndex.load( std::memory_order_relaxed );
+		waitFor( m_readerProgress, m_writerBlockedTime, [this, w]() {
+			return w - m_readerIndex.load() < static_cast<uint64_t>( m_size );
+		} );
+		m_buffer[w % m_size] = _element;
+		m_writerIndex.store( w + 1 );
+		m_writerProgress.notify();
 	}
 
+	//! Reader only. Blocks while the FIFO is empty.
 	T read()
 	{
-		m_reader_sem.acquire();
-		T element = m_buffer[m_reader_index++];
-		m_reader_index %= m_size;
-		m_writer_sem.release();
+		const uint64_t r = m_readerIndex.load( std::memory_order_relaxed );
+		waitFor( m_writerProgress, m_readerBlockedTime, [this, r]() {
+			return m_writerIndex.load() != r;
+		} );
+		T element = m_buffer[r % m_size];
+		m_readerIndex.store( r + 1 );
+		m_readerProgress.notify();
 		return( element );
 	}
 
+	//! Writer only. Blocks until the reader took all elements.
 	void waitUntilRead()
 	{
-		m_writer_sem.acquire( m_size );
-		m_writer_sem.release( m_size );
+		const uint64_t w = m_writerIndex.load( std::memory_order_relaxed );
+		waitFor( m_readerProgress, m_writerBlockedTime, [this, w]() {
+			return m_readerIndex.load() == w;
+		} );
+	}
+
+	bool available() const
+	{
+		return m_writerIndex.load() != m_readerIndex.load();
+	}
+
+	int size() const
+	{
+		return m_size;
+	}
+
+	//! Total time in microseconds read() waited for the writer
+	int64_t readerBlockedTime() const
+	{
+		return m_readerBlockedTime.load( std::memory_order_relaxed );
 	}
 
-	bool available()
+	//! Total time in microseconds write() and waitUntilRead() waited for
+	//! the reader
+	int64_t writerBlockedTime() const
 	{
-		return( m_reader_sem.available() );
+		return m_writerBlockedTime.load( std::memory_order_relaxed );
 	}
 
 
 private:
-	QSemaphore m_reader_sem;
-	QSemaphore m_writer_sem;
-	int m_reader_index;
-	int m_writer_index;
-	int m_size;
+	template<typename Condition>
+	static void waitFor( EventCount & progress, std::atomic<int64_t> & blockedTime,
+							Condition condition )
+	{
+		if( condition() )
+		{
+			return;
+		}
+
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point start = Clock::now();
+		while( true )
+		{
+			const unsigned int key = progress.prepareWait();
+			if( condition() )
+			{
+				progress.cancelWait();
+				break;
+			}
+			progress.commitWait( key );
+		}
+		blockedTime.fetch_add( std::chrono::duration_cast<std::chrono::microseconds>(
+					Clock::now() - start ).count(), std::memory_order_relaxed );
+	}
+
 	T * m_buffer;
+	const int m_size;
+
+	// running counts of elements read and written, kept on separate cache
+	// lines as each is written by another thread
+	alignas( 64 ) std::atomic<uint64_t> m_readerIndex;
+	alignas( 64 ) std::atomic<uint64_t> m_writerIndex;
+
+	EventCount m_readerProgress;
+	EventCount m_writerProgress;
+
+	std::atomic<int64_t> m_readerBlockedTime;
+	std::atomic<int64_t> m_writerBlockedTime;
 
 } ;
 
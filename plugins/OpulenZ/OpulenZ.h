@@ -25,6 +25,8 @@
 #ifndef OPULENZ_H
 #define OPULENZ_H
 
+#include <QMutex>
+
 #include "Instrument.h"
 #include "InstrumentView.h"
 #include "opl.h"
@@ -33,6 +33,7 @@
 #include "Knob.h"
 #include "LedCheckbox.h"
 #include "Mixer.h"
+#include "NoteBatch.h"
 #include "NotePlayHandle.h"
 #include "Oscillator.h"
 #include "PixmapButton.h"
@@ -261,27 +262,34 @@ QString bitInvader::nodeName() const
 
 
 
+void bitInvader::startNote( NotePlayHandle * _n )
+{
+	float factor;
+	if( !m_normalize.value() )
+	{
+		factor = 1.0f;
+	}
+	else
+	{
+		factor = m_normalizeFactor;
+	}
+
+	_n->m_pluginData = new bSynth(
+				const_cast<float*>( m_graph.samples() ),
+				_n,
+				m_interpolation.value(), factor,
+			Engine::mixer()->processingSampleRate() );
+}
+
+
+
+
 void bitInvader::playNote( NotePlayHandle * _n,
 						sampleFrame * _working_buffer )
 {
 	if ( _n->totalFramesPlayed() == 0 || _n->m_pluginData == NULL )
 	{
-	
-		float factor;
-		if( !m_normalize.value() )
-		{
-			factor = 1.0f;
-		}
-		else
-		{
-			factor = m_normalizeFactor;
-		}
-
-		_n->m_pluginData = new bSynth(
-					const_cast<float*>( m_graph.samples() ),
-					_n,
-					m_interpolation.value(), factor,
-				Engine::mixer()->processingSampleRate() );
+		startNote( _n );
 	}
 
 	const fpp_t frames = _n->framesLeftForCurrentPeriod();
@@ -305,6 +313,65 @@ void bitInvader::playNote( NotePlayHandle * _n,
 
 
 
+void bitInvader::playNotes( NoteBatch & _batch )
+{
+	const float length = m_graph.length();
+	const int lastIndex = static_cast<int>( length ) - 1;
+
+	for( int voice = 0; voice < _batch.size(); ++voice )
+	{
+		NotePlayHandle * n = _batch.note( voice );
+		if( _batch.framesPlayed()[voice] == 0 || n->m_pluginData == NULL )
+		{
+			startNote( n );
+		}
+
+		// same as nextStringSample() for every frame, but the frequency
+		// stays the same for a period, so the step is computed once
+		bSynth * ps = static_cast<bSynth *>( n->m_pluginData );
+		const float step = static_cast<float>(
+			length / ( ps->sample_rate / _batch.frequencies()[voice] ) );
+		const float * shape = ps->sample_shape;
+		float index = ps->sample_realindex;
+
+		sampleFrame * buf = _batch.buffers()[voice] + _batch.offsets()[voice];
+		const fpp_t frames = _batch.frames()[voice];
+		for( fpp_t frame = 0; frame < frames; ++frame )
+		{
+			while( index >= length )
+			{
+				index -= length;
+			}
+			const int a = static_cast<int>( index );
+			sample_t cur;
+			if( ps->interpolation )
+			{
+				const int b = a < lastIndex ? static_cast<int>( index + 1 ) : 0;
+				cur = linearInterpolate( shape[a], shape[b], fraction( index ) );
+			}
+			else
+			{
+				cur = shape[a];
+			}
+			buf[frame][0] = buf[frame][1] = cur;
+			index += step;
+		}
+		ps->sample_realindex = index;
+	}
+
+	for( int voice = 0; voice < _batch.size(); ++voice )
+	{
+		NotePlayHandle * n = _batch.note( voice );
+		sampleFrame * buf = _batch.buffers()[voice];
+		applyRelease( buf, n );
+		instrumentTrack()->processAudioBuffer( buf,
+			_batch.frames()[voice] + _batch.offsets()[voice], n );
+	}
+}
+
+
+
+
 void bitInvader::deleteNotePluginData( NotePlayHandle * _n )
 {
 	delete static_cast<bSynth *>( _n->m_pluginData );
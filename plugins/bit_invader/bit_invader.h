@@ -49,6 +49,8 @@ public:
 	
 	sample_t nextStringSample( float sample_length );
 
+	// advances a whole period at once, see bitInvader::playNotes()
+	friend class bitInvader;
 
 private:
 	int sample_index;
@@ -70,8 +72,14 @@ public:
 
 	virtual void playNote( NotePlayHandle * _n,
 						sampleFrame * _working_buffer );
+	virtual void playNotes( NoteBatch & _batch );
 	virtual void deleteNotePluginData( NotePlayHandle * _n );
 
+	virtual Flags flags() const
+	{
+		return IsBatchRendered;
+	}
+
 
 	virtual void saveSettings( QDomDocument & _doc,
 							QDomElement & _parent );
@@ -94,6 +102,8 @@ protected slots:
 
 
 private:
+	void startNote( NotePlayHandle * _n );
+
 	FloatModel  m_sampleLength;
 	graphModel  m_graph;
 	
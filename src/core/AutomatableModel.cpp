@@ -24,6 +24,9 @@
 
 #include "AutomatableModel.h"
 
+#include <algorithm>
+#include <thread>
+
 #include "lmms_math.h"
 
 #include "AutomationPattern.h"
@@ -52,8 +55,12 @@ AutomatableModel::AutomatableModel(
 	m_hasStrictStepSize( false ),
 	m_controllerConnection( NULL ),
 	m_valueBuffer( static_cast<int>( Engine::mixer()->framesPerPeriod() ) ),
+	m_claimedPeriod( -1 ),
 	m_lastUpdatedPeriod( -1 ),
-	m_hasSampleExactData( false )
+	m_hasSampleExactData( false ),
+	m_automatedPeriod( -1 ),
+	m_automatedFrames( 0 ),
+	m_automationVaries( false )
 
 {
 	m_value = fittedValue( val );
@@ -400,6 +407,64 @@ void AutomatableModel::setAutomatedValue( const float value )
 
 
 
+void AutomatableModel::setAutomatedValues( const float startValue, const float endValue,
+						const f_cnt_t offset, const fpp_t frames )
+{
+	setAutomatedValue( startValue );
+
+	if( m_automatedPeriod != s_periodCounter )
+	{
+		m_automatedPeriod = s_periodCounter;
+		m_automatedFrames = 0;
+		m_automationVaries = false;
+	}
+
+	float * values = m_valueBuffer.values();
+	const f_cnt_t length = m_valueBuffer.length();
+	const f_cnt_t end = qMin<f_cnt_t>( offset + frames, length );
+	const float start = m_value;
+	const float target = fittedValue( scaledValue( endValue ) );
+
+	// frames the song skipped keep the previous value
+	const float last = m_automatedFrames > 0 ? values[m_automatedFrames - 1] : start;
+	for( f_cnt_t f = m_automatedFrames; f < offset && f < length; ++f )
+	{
+		values[f] = last;
+	}
+
+	if( start == target || frames < 2 )
+	{
+		std::fill( values + qMin( offset, length ), values + end, start );
+	}
+	else
+	{
+		const float slope = ( target - start ) / ( frames - 1 );
+		for( f_cnt_t f = offset; f < end; ++f )
+		{
+			values[f] = start + ( f - offset ) * slope;
+		}
+	}
+
+	if( start != target || start != values[0] )
+	{
+		m_automationVaries = true;
+	}
+	m_automatedFrames = qMax( m_automatedFrames, end );
+
+	++m_setValueDepth;
+	for( AutomatableModel * linkedModel : m_linkedModels )
+	{
+		if( linkedModel->m_setValueDepth < 1 )
+		{
+			linkedModel->setAutomatedValues( startValue, endValue, offset, frames );
+		}
+	}
+	--m_setValueDepth;
+}
+
+
+
+
 void AutomatableModel::setRange( const float min, const float max,
 							const float step )
 {
@@ -595,15 +660,37 @@ float AutomatableModel::controllerValue( int frameOffset ) const
 
 ValueBuffer * AutomatableModel::valueBuffer()
 {
-	QMutexLocker m( &m_valueBufferMutex );
+	const long period = s_periodCounter;
 	// if we've already calculated the valuebuffer this period, return the cached buffer
-	if( m_lastUpdatedPeriod == s_periodCounter )
+	if( m_lastUpdatedPeriod.load( std::memory_order_acquire ) != period )
 	{
-		return m_hasSampleExactData
-			? &m_valueBuffer
-			: NULL;
+		long claimed = m_claimedPeriod.load( std::memory_order_relaxed );
+		if( claimed != period &&
+			m_claimedPeriod.compare_exchange_strong( claimed, period,
+						std::memory_order_acquire ) )
+		{
+			m_hasSampleExactData = updateValueBuffer();
+			m_lastUpdatedPeriod.store( period, std::memory_order_release );
+		}
+		else
+		{
+			// another thread computes it right now, which takes no longer
+			// than filling one buffer
+			while( m_lastUpdatedPeriod.load( std::memory_order_acquire ) != period )
+			{
+				std::this_thread::yield();
+			}
+		}
 	}
 
+	return m_hasSampleExactData ? &m_valueBuffer : NULL;
+}
+
+
+
+
+bool AutomatableModel::updateValueBuffer()
+{
 	float val = m_value; // make sure our m_value doesn't change midway
 
 	ValueBuffer * vb;
@@ -633,9 +720,7 @@ ValueBuffer * AutomatableModel::valueBuffer()
 					"lacks implementation for a scale type");
 				break;
 			}
-			m_lastUpdatedPeriod = s_periodCounter;
-			m_hasSampleExactData = true;
-			return &m_valueBuffer;
+			return true;
 		}
 	}
 	AutomatableModel* lm = NULL;
@@ -652,25 +737,34 @@ ValueBuffer * AutomatableModel::valueBuffer()
 		{
 			nvalues[i] = fittedValue( values[i] );
 		}
-		m_lastUpdatedPeriod = s_periodCounter;
-		m_hasSampleExactData = true;
-		return &m_valueBuffer;
+		return true;
+	}
+
+	if( m_automatedPeriod == s_periodCounter )
+	{
+		// the song already wrote sample-exact automation into the buffer
+		m_oldValue = val;
+		if( !m_automationVaries )
+		{
+			// automation is constant this period, value() will do
+			return false;
+		}
+		std::fill( m_valueBuffer.values() + m_automatedFrames,
+			m_valueBuffer.values() + m_valueBuffer.length(),
+			m_valueBuffer.values()[m_automatedFrames - 1] );
+		return true;
 	}
 
 	if( m_oldValue != val )
 	{
 		m_valueBuffer.interpolate( m_oldValue, val );
 		m_oldValue = val;
-		m_lastUpdatedPeriod = s_periodCounter;
-		m_hasSampleExactData = true;
-		return &m_valueBuffer;
+		return true;
 	}
 
 	// if we have no sample-exact source for a ValueBuffer, return NULL to signify that no data is available at the moment
 	// in which case the recipient knows to use the static value() instead
-	m_lastUpdatedPeriod = s_periodCounter;
-	m_hasSampleExactData = false;
-	return NULL;
+	return false;
 }
 
 
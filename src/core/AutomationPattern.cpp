@@ -26,6 +26,8 @@
 
 #include "AutomationPattern.h"
 
+#include <QtCore/QThread>
+
 #include "AutomationPatternView.h"
 #include "AutomationTrack.h"
 #include "LocaleHelper.h"
@@ -34,6 +36,7 @@
 #include "BBTrackContainer.h"
 #include "Song.h"
 
+#include <algorithm>
 #include <cmath>
 
 int AutomationPattern::s_quantization = 1;
@@ -45,12 +48,19 @@ AutomationPattern::AutomationPattern( AutomationTrack * _auto_track ) :
 	TrackContentObject( _auto_track ),
 	m_autoTrack( _auto_track ),
 	m_objects(),
+	m_segments( std::make_shared<SegmentVector>() ),
+	m_segmentCursor( 0 ),
+	m_segmentsOutdated( false ),
 	m_tension( 1.0 ),
 	m_progressionType( DiscreteProgression ),
 	m_dragging( false ),
 	m_isRecording( false ),
 	m_lastRecordedValue( 0 )
 {
+	// rebuilds the segments after recording changed the pattern
+	connect( this, SIGNAL( dataChanged() ),
+			this, SLOT( updateOutdatedSegments() ) );
+
 	changeLength( MidiTime( 1, 0 ) );
 	if( getTrack() )
 	{
@@ -76,6 +86,9 @@ AutomationPattern::AutomationPattern( const AutomationPattern & _pat_to_copy ) :
 	TrackContentObject( _pat_to_copy.m_autoTrack ),
 	m_autoTrack( _pat_to_copy.m_autoTrack ),
 	m_objects( _pat_to_copy.m_objects ),
+	m_segments( _pat_to_copy.m_segments ),
+	m_segmentCursor( 0 ),
+	m_segmentsOutdated( false ),
 	m_tension( _pat_to_copy.m_tension ),
 	m_progressionType( _pat_to_copy.m_progressionType )
 {
@@ -85,6 +98,13 @@ AutomationPattern::AutomationPattern( const AutomationPattern & _pat_to_copy ) :
 		m_timeMap[it.key()] = it.value();
 		m_tangents[it.key()] = _pat_to_copy.m_tangents[it.key()];
 	}
+	if( _pat_to_copy.m_segmentsOutdated )
+	{
+		updateSegments();
+	}
+	connect( this, SIGNAL( dataChanged() ),
+			this, SLOT( updateOutdatedSegments() ) );
+
 	switch( getTrack()->trackContainer()->type() )
 	{
 		case TrackContainer::BBContainer:
@@ -135,6 +155,7 @@ void AutomationPattern::setProgressionType(
 		_new_progression_type == CubicHermiteProgression )
 	{
 		m_progressionType = _new_progression_type;
+		updateSegments();
 		emit dataChanged();
 	}
 }
@@ -150,6 +171,7 @@ void AutomationPattern::setTension( QString _new_tension )
 	if( ok && nt > -0.01 && nt < 1.01 )
 	{
 		m_tension = nt;
+		updateSegments();
 	}
 }
 
@@ -230,6 +252,7 @@ MidiTime AutomationPattern::putValue( const MidiTime & time,
 		--it;
 	}
 	generateTangents( it, 3 );
+	updateSegments();
 
 	updateLength();
 
@@ -245,7 +268,7 @@ void AutomationPattern::removeValue( const MidiTime & time )
 {
 	cleanObjects();
 
-	m_timeMap.remove( time );
+	const bool removed = m_timeMap.remove( time ) > 0;
 	m_tangents.remove( time );
 	timeMap::const_iterator it = m_timeMap.lowerBound( time );
 	if( it != m_timeMap.begin() )
@@ -253,6 +276,11 @@ void AutomationPattern::removeValue( const MidiTime & time )
 		--it;
 	}
 	generateTangents(it, 3);
+	// putValue() removes every tick around a new point
+	if( removed )
+	{
+		updateSegments();
+	}
 
 	updateLength();
 
@@ -329,89 +357,56 @@ void AutomationPattern::applyDragValue()
 
 float AutomationPattern::valueAt( const MidiTime & _time ) const
 {
-	if( m_timeMap.isEmpty() )
-	{
-		return 0;
-	}
+	// hold a reference, the pattern might get edited meanwhile
+	const std::shared_ptr<const SegmentVector> segments = std::atomic_load( &m_segments );
+	const Segment * segment = segmentAt( *segments, _time );
+
+	return segment ? segment->valueAt( _time ) : 0;
+}
 
-	if( m_timeMap.contains( _time ) )
-	{
-		return m_timeMap[_time];
-	}
 
-	// lowerBound returns next value with greater key, therefore we take
-	// the previous element to get the current value
-	timeMap::ConstIterator v = m_timeMap.lowerBound( _time );
 
-	if( v == m_timeMap.begin() )
-	{
-		return 0;
-	}
-	if( v == m_timeMap.end() )
-	{
-		return (v-1).value();
-	}
 
-	return valueAt( v-1, _time - (v-1).key() );
+float AutomationPattern::valueAt( const MidiTime & time, float offset ) const
+{
+	const std::shared_ptr<const SegmentVector> segments = std::atomic_load( &m_segments );
+	const Segment * segment = segmentAt( *segments, time );
+
+	return segment ? segment->valueAt( time, offset ) : 0;
 }
 
 
 
 
-float AutomationPattern::valueAt( timeMap::const_iterator v, int offset ) const
+void AutomationPattern::valuesAt( const MidiTime & time, float startOffset, float endOffset,
+							float & start, float & end ) const
 {
-	if( m_progressionType == DiscreteProgression || v == m_timeMap.end() )
-	{
-		return v.value();
-	}
-	else if( m_progressionType == LinearProgression )
-	{
-		float slope = ((v+1).value() - v.value()) /
-							((v+1).key() - v.key());
-		return v.value() + offset * slope;
-	}
-	else /* CubicHermiteProgression */
-	{
-		// Implements a Cubic Hermite spline as explained at:
-		// http://en.wikipedia.org/wiki/Cubic_Hermite_spline#Unit_interval_.280.2C_1.29
-		//
-		// Note that we are not interpolating a 2 dimensional point over
-		// time as the article describes.  We are interpolating a single
-		// value: y.  To make this work we map the values of x that this
-		// segment spans to values of t for t = 0.0 -> 1.0 and scale the
-		// tangents _m1 and _m2
-		int numValues = ((v+1).key() - v.key());
-		float t = (float) offset / (float) numValues;
-		float m1 = (m_tangents[v.key()]) * numValues * m_tension;
-		float m2 = (m_tangents[(v+1).key()]) * numValues * m_tension;
+	const std::shared_ptr<const SegmentVector> segments = std::atomic_load( &m_segments );
+	const Segment * segment = segmentAt( *segments, time );
 
-		return ( 2*pow(t,3) - 3*pow(t,2) + 1 ) * v.value()
-				+ ( pow(t,3) - 2*pow(t,2) + t) * m1
-				+ ( -2*pow(t,3) + 3*pow(t,2) ) * (v+1).value()
-				+ ( pow(t,3) - pow(t,2) ) * m2;
-	}
+	start = segment ? segment->valueAt( time, startOffset ) : 0;
+	end = segment ? segment->valueAt( time, endOffset ) : 0;
 }
 
 
 
 
-float *AutomationPattern::valuesAfter( const MidiTime & _time ) const
+bool AutomationPattern::valuesAfter( const MidiTime & time, std::vector<float> & values ) const
 {
-	timeMap::ConstIterator v = m_timeMap.lowerBound( _time );
-	if( v == m_timeMap.end() || (v+1) == m_timeMap.end() )
+	const std::shared_ptr<const SegmentVector> segments = std::atomic_load( &m_segments );
+	const Segment * segment = segmentAt( *segments, time );
+	if( segment == nullptr || segment->length == 0 )
 	{
-		return NULL;
+		return false;
 	}
 
-	int numValues = (v+1).key() - v.key();
-	float *ret = new float[numValues];
-
-	for( int i = 0; i < numValues; i++ )
+	values.resize( segment->length );
+	for( tick_t i = 0; i < segment->length; ++i )
 	{
-		ret[i] = valueAt( v, i );
+		values[i] = segment->valueAt( segment->start + i );
 	}
 
-	return ret;
+	return true;
 }
 
 
@@ -819,6 +814,7 @@ void AutomationPattern::clear()
 {
 	m_timeMap.clear();
 	m_tangents.clear();
+	updateSegments();
 
 	emit dataChanged();
 }
@@ -873,6 +869,7 @@ void AutomationPattern::cleanObjects()
 void AutomationPattern::generateTangents()
 {
 	generateTangents(m_timeMap.begin(), m_timeMap.size());
+	updateSegments();
 }
 
 
@@ -913,4 +910,95 @@ void AutomationPattern::generateTangents( timeMap::const_iterator it,
 
 
 
+void AutomationPattern::updateSegments()
+{
+	if( QThread::currentThread() != thread() )
+	{
+		// the mixer records into the pattern, leave rebuilding and
+		// allocating to our own thread, see updateOutdatedSegments()
+		m_segmentsOutdated = true;
+		return;
+	}
+	m_segmentsOutdated = false;
+
+	auto segments = std::make_shared<SegmentVector>();
+	segments->reserve( m_timeMap.size() );
+
+	for( timeMap::const_iterator it = m_timeMap.begin(); it != m_timeMap.end(); ++it )
+	{
+		const float v0 = it.value();
+		Segment segment = { it.key(), 0, 0, 0, 0, v0 };
+
+		timeMap::const_iterator next = it + 1;
+		if( next != m_timeMap.end() )
+		{
+			segment.length = next.key() - it.key();
+			const float v1 = next.value();
+			if( m_progressionType == LinearProgression )
+			{
+				segment.c = v1 - v0;
+			}
+			else if( m_progressionType == CubicHermiteProgression )
+			{
+				// Implements a Cubic Hermite spline as explained at:
+				// http://en.wikipedia.org/wiki/Cubic_Hermite_spline#Unit_interval_.280.2C_1.29
+				//
+				// Note that we are not interpolating a 2 dimensional point over
+				// time as the article describes.  We are interpolating a single
+				// value: y.  To make this work we map the values of x that this
+				// segment spans to values of t for t = 0.0 -> 1.0 and scale the
+				// tangents m1 and m2. The basis functions are multiplied out
+				// into a polynomial in t.
+				const float m1 = m_tangents.value( it.key() ) * segment.length * m_tension;
+				const float m2 = m_tangents.value( next.key() ) * segment.length * m_tension;
+				segment.a = 2 * v0 + m1 - 2 * v1 + m2;
+				segment.b = -3 * v0 - 2 * m1 + 3 * v1 - m2;
+				segment.c = m1;
+			}
+		}
+		segments->push_back( segment );
+	}
+
+	std::atomic_store( &m_segments, std::shared_ptr<const SegmentVector>( segments ) );
+}
+
+
+
+
+void AutomationPattern::updateOutdatedSegments()
+{
+	if( m_segmentsOutdated )
+	{
+		updateSegments();
+	}
+}
+
+
+
+
+const AutomationPattern::Segment * AutomationPattern::segmentAt(
+		const SegmentVector & segments, tick_t time ) const
+{
+	if( segments.empty() || time < segments.front().start )
+	{
+		return nullptr;
+	}
+
+	// playback mostly asks for the same or the following segment, so
+	// try where the last lookup ended before searching
+	const auto contains = [&segments, time]( std::size_t i )
+	{
+		return i < segments.size() && segments[i].start <= time &&
+			( i + 1 == segments.size() || segments[i + 1].start > time );
+	};
+	std::size_t i = m_segmentCursor.load( std::memory_order_relaxed );
+	if( !contains( i ) && !contains( ++i ) )
+	{
+		i = std::upper_bound( segments.begin(), segments.end(), time,
+			[]( tick_t t, const Segment & s ) { return t < s.start; } )
+				- segments.begin() - 1;
+	}
+	m_segmentCursor.store( i, std::memory_order_relaxed );
 
+	return &segments[i];
+}
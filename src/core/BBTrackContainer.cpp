@@ -242,18 +242,21 @@ void BBTrackContainer::createTCOsForBB( int _bb )
 	}
 }
 
-AutomatedValueMap BBTrackContainer::automatedValuesAt(MidiTime time, int tcoNum) const
+void BBTrackContainer::addAutomation(MidiTime time, int tcoNum, bool held,
+					AutomationCollection& collection) const
 {
 	Q_ASSERT(tcoNum >= 0);
 	Q_ASSERT(time.getTicks() >= 0);
 
 	auto length_bars = lengthOfBB(tcoNum);
 	auto length_ticks = length_bars * MidiTime::ticksPerBar();
-	if (time > length_ticks)
+	if (time >= length_ticks)
 	{
 		time = length_ticks;
+		held = true;
 	}
 
-	return TrackContainer::automatedValuesAt(time + (MidiTime::ticksPerBar() * tcoNum), tcoNum);
+	addAutomationFromTracks(nullptr, tracks(), time + (MidiTime::ticksPerBar() * tcoNum),
+				tcoNum, held, collection, collection.bbTcos);
 }
 
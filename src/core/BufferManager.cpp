@@ -29,9 +29,27 @@
 #include "Engine.h"
 #include "Mixer.h"
 #include "MemoryManager.h"
+#include "MixHelpers.h"
+
+#include <new>
 
 static fpp_t framesPerPeriod;
 
+
+// stored right in front of each buffer - the alignment keeps the sample
+// data as aligned as the memory manager's allocations
+struct alignas( 16 ) BufferHeader
+{
+	BufferInfo info;
+} ;
+
+static const BufferInfo UnknownContents = { false, false, false, false, 0.0f, 0.0f };
+
+static inline BufferHeader * header( const sampleFrame * buf )
+{
+	return reinterpret_cast<BufferHeader *>( const_cast<sampleFrame *>( buf ) ) - 1;
+}
+
 void BufferManager::init( fpp_t framesPerPeriod )
 {
 	::framesPerPeriod = framesPerPeriod;
@@ -40,7 +58,67 @@ void BufferManager::init( fpp_t framesPerPeriod )
 
 sampleFrame * BufferManager::acquire()
 {
-	return MM_ALLOC( sampleFrame, ::framesPerPeriod );
+	char * mem = MM_ALLOC( char, sizeof( BufferHeader ) + sizeof( sampleFrame ) * ::framesPerPeriod );
+	BufferHeader * h = new( mem ) BufferHeader;
+	h->info = UnknownContents;
+	return reinterpret_cast<sampleFrame *>( h + 1 );
+}
+
+
+
+
+const BufferInfo & BufferManager::info( const sampleFrame * buf )
+{
+	return header( buf )->info;
+}
+
+
+
+
+void BufferManager::invalidate( sampleFrame * buf )
+{
+	header( buf )->info = UnknownContents;
+}
+
+
+
+
+void BufferManager::markSilent( sampleFrame * buf )
+{
+	header( buf )->info = { true, true, true, false, 0.0f, 0.0f };
+}
+
+
+
+
+bool BufferManager::isSilent( const sampleFrame * buf )
+{
+	BufferInfo & info = header( buf )->info;
+	if( !info.silenceKnown )
+	{
+		info.silent = MixHelpers::isSilent( buf, ::framesPerPeriod );
+		info.silenceKnown = true;
+	}
+	return info.silent;
+}
+
+
+
+
+const BufferInfo & BufferManager::analyze( const sampleFrame * buf )
+{
+	BufferInfo & info = header( buf )->info;
+	if( !info.peaksKnown )
+	{
+		info.hasBadSamples = MixHelpers::peakValues( buf, ::framesPerPeriod,
+							info.peakLeft, info.peakRight );
+		info.peaksKnown = true;
+		// isSilent() ignores nans as well
+		info.silent = info.peakLeft < MixHelpers::SilenceThreshold &&
+					info.peakRight < MixHelpers::SilenceThreshold;
+		info.silenceKnown = true;
+	}
+	return info;
 }
 
 void BufferManager::clear( sampleFrame *ab, const f_cnt_t frames, const f_cnt_t offset )
@@ -59,6 +137,9 @@ void BufferManager::clear( surroundSampleFrame * ab, const f_cnt_t frames,
 
 void BufferManager::release( sampleFrame * buf )
 {
-	MM_FREE( buf );
+	if( buf )
+	{
+		MM_FREE( header( buf ) );
+	}
 }
 
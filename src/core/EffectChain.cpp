@@ -26,6 +26,8 @@
 
 #include <QDomElement>
 
+#include <chrono>
+
 #include "EffectChain.h"
 #include "Effect.h"
 #include "DummyEffect.h"
@@ -196,7 +198,10 @@ bool EffectChain::processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, b
 	{
 		if( hasInputNoise || ( *it )->isRunning() )
 		{
+			const auto start = std::chrono::steady_clock::now();
 			moreEffects |= ( *it )->processAudioBuffer( _buf, _frames );
+			( *it )->m_cpuUsage.add( std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::steady_clock::now() - start ).count() );
 			MixHelpers::sanitize( _buf, _frames );
 		}
 	}
@@ -207,6 +212,17 @@ bool EffectChain::processAudioBuffer( sampleFrame * _buf, const fpp_t _frames, b
 
 
 
+void EffectChain::finishPeriod()
+{
+	for( Effect * effect : m_effects )
+	{
+		effect->m_cpuUsage.finishPeriod();
+	}
+}
+
+
+
+
 void EffectChain::startRunning()
 {
 	if( m_enabledModel.value() == false )
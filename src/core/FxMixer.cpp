@@ -24,6 +24,7 @@
 
 #include <QDomElement>
 
+#include "AudioPort.h"
 #include "BufferManager.h"
 #include "FxMixer.h"
 #include "Mixer.h"
@@ -65,18 +66,22 @@ FxChannel::FxChannel( int idx, Model * _parent ) :
 	m_stillRunning( false ),
 	m_peakLeft( 0.0f ),
 	m_peakRight( 0.0f ),
-	m_buffer( new sampleFrame[Engine::mixer()->framesPerPeriod()] ),
+	m_buffer( BufferManager::acquire() ),
+	m_sendGains( BufferManager::acquire() ),
 	m_muteModel( false, _parent ),
 	m_soloModel( false, _parent ),
 	m_volumeModel( 1.0, 0.0, 2.0, 0.001, _parent ),
 	m_name(),
-	m_lock(),
 	m_channelIndex( idx ),
 	m_queued( false ),
+	m_muted( false ),
 	m_hasColor( false ),
+	m_senderDependencies( 0 ),
+	m_dependencies( 0 ),
 	m_dependenciesMet(0)
 {
 	BufferManager::clear( m_buffer, Engine::mixer()->framesPerPeriod() );
+	BufferManager::markSilent( m_buffer );
 }
 
 
@@ -84,7 +89,8 @@ FxChannel::FxChannel( int idx, Model * _parent ) :
 
 FxChannel::~FxChannel()
 {
-	delete[] m_buffer;
+	BufferManager::release( m_buffer );
+	BufferManager::release( m_sendGains );
 }
 
 
@@ -101,8 +107,7 @@ inline void FxChannel::processed()
 
 void FxChannel::incrementDeps()
 {
-	int i = m_dependenciesMet++ + 1;
-	if( i >= m_receives.size() && ! m_queued )
+	if( ++m_dependenciesMet == m_dependencies )
 	{
 		m_queued = true;
 		MixerWorkerThread::addJob( this );
@@ -123,9 +128,27 @@ void FxChannel::doProcessing()
 
 	if( m_muted == false )
 	{
+		// pull in the output of the audio ports sending to us - they are all
+		// processed at this point, so no locking is needed
+		for( AudioPort * port : m_inputPorts )
+		{
+			if( port->hasOutput() )
+			{
+				if( !BufferManager::isSilent( port->buffer() ) )
+				{
+					MixHelpers::add( m_buffer, port->buffer(), fpp );
+				}
+				m_hasInput = true;
+			}
+		}
+
 		for( FxRoute * senderRoute : m_receives )
 		{
 			FxChannel * sender = senderRoute->sender();
+			if( sender->m_muted )
+			{
+				continue;
+			}
 			FloatModel * sendModel = senderRoute->amount();
 			if( ! sendModel ) qFatal( "Error: no send model found from %d to %d", senderRoute->senderIndex(), m_channelIndex );
 
@@ -138,25 +161,32 @@ void FxChannel::doProcessing()
 				// mix it's output with this one's output
 				sampleFrame * ch_buf = sender->m_buffer;
 
+				// the sender analyzed its buffer already, so this doesn't
+				// touch the samples
+				if( BufferManager::isSilent( ch_buf ) )
+				{
+					m_hasInput = true;
+					continue;
+				}
+
 				// use sample-exact mixing if sample-exact values are available
 				if( ! volBuf && ! sendBuf ) // neither volume nor send has sample-exact data...
 				{
 					const float v = sender->m_volumeModel.value() * sendModel->value();
 					MixHelpers::addSanitizedMultiplied( m_buffer, ch_buf, v, fpp );
 				}
-				else if( volBuf && sendBuf ) // both volume and send have sample-exact data
-				{
-					MixHelpers::addSanitizedMultipliedByBuffers( m_buffer, ch_buf, volBuf, sendBuf, fpp );
-				}
-				else if( volBuf ) // volume has sample-exact data but send does not
-				{
-					const float v = sendModel->value();
-					MixHelpers::addSanitizedMultipliedByBuffer( m_buffer, ch_buf, v, volBuf, fpp );
-				}
-				else // vice versa
+				else
 				{
+					// same kernel as the volume and panning stage of the audio ports
 					const float v = sender->m_volumeModel.value();
-					MixHelpers::addSanitizedMultipliedByBuffer( m_buffer, ch_buf, v, sendBuf, fpp );
+					const float s = sendModel->value();
+					for( f_cnt_t f = 0; f < fpp; ++f )
+					{
+						m_sendGains[f][0] = m_sendGains[f][1] =
+							( volBuf ? volBuf->values()[f] : v ) *
+							( sendBuf ? sendBuf->values()[f] : s );
+					}
+					MixHelpers::addSanitizedMultipliedByGains( m_buffer, ch_buf, m_sendGains, fpp );
 				}
 				m_hasInput = true;
 			}
@@ -173,9 +203,12 @@ void FxChannel::doProcessing()
 
 		m_stillRunning = m_fxChain.processAudioBuffer( m_buffer, fpp, m_hasInput );
 
-		Mixer::StereoSample peakSamples = Engine::mixer()->getPeakValues(m_buffer, fpp);
-		m_peakLeft = qMax( m_peakLeft, peakSamples.left * v );
-		m_peakRight = qMax( m_peakRight, peakSamples.right * v );
+		// one pass yields the peaks for the meters as well as what our
+		// receivers need to know about the buffer
+		BufferManager::invalidate( m_buffer );
+		const BufferInfo & info = BufferManager::analyze( m_buffer );
+		m_peakLeft = qMax( m_peakLeft, info.peakLeft * v );
+		m_peakRight = qMax( m_peakRight, info.peakRight * v );
 	}
 	else
 	{
@@ -191,7 +224,8 @@ void FxChannel::doProcessing()
 FxMixer::FxMixer() :
 	Model( NULL ),
 	JournallingObject(),
-	m_fxChannels()
+	m_fxChannels(),
+	m_routingChanged( true )
 {
 	// create master channel
 	createChannel();
@@ -220,7 +254,11 @@ int FxMixer::createChannel()
 {
 	const int index = m_fxChannels.size();
 	// create new channel
-	m_fxChannels.push_back( new FxChannel( index, this ) );
+	FxChannel * ch = new FxChannel( index, this );
+	m_fxChannels.push_back( ch );
+	connect( &ch->m_muteModel, SIGNAL( dataChanged() ),
+			this, SLOT( invalidateRoutingPlan() ), Qt::DirectConnection );
+	invalidateRoutingPlan();
 
 	// reset channel state
 	clearChannel( index );
@@ -346,6 +384,7 @@ void FxMixer::deleteChannel( int index )
 	// actually delete the channel
 	m_fxChannels.remove(index);
 	delete ch;
+	invalidateRoutingPlan();
 
 	for( int i = index; i < m_fxChannels.size(); ++i )
 	{
@@ -480,6 +519,7 @@ FxRoute * FxMixer::createRoute( FxChannel * from, FxChannel * to, float amount )
 
 	// add us to fxmixer's list
 	Engine::fxMixer()->m_fxRoutes.append( route );
+	invalidateRoutingPlan();
 	Engine::mixer()->doneChangeInModel();
 
 	return route;
@@ -515,6 +555,7 @@ void FxMixer::deleteChannelSend( FxRoute * route )
 	// remove us from fxmixer's list
 	Engine::fxMixer()->m_fxRoutes.remove( Engine::fxMixer()->m_fxRoutes.indexOf( route ) );
 	delete route;
+	invalidateRoutingPlan();
 	Engine::mixer()->doneChangeInModel();
 }
 
@@ -580,73 +621,145 @@ FloatModel * FxMixer::channelSendModel( fx_ch_t fromChannel, fx_ch_t toChannel )
 
 
 
-void FxMixer::mixToChannel( const sampleFrame * _buf, fx_ch_t _ch )
+void FxMixer::prepareMasterMix()
 {
-	if( m_fxChannels[_ch]->m_muteModel.value() == false )
-	{
-		m_fxChannels[_ch]->m_lock.lock();
-		MixHelpers::add( m_fxChannels[_ch]->m_buffer, _buf, Engine::mixer()->framesPerPeriod() );
-		m_fxChannels[_ch]->m_hasInput = true;
-		m_fxChannels[_ch]->m_lock.unlock();
-	}
+	BufferManager::clear( m_fxChannels[0]->m_buffer,
+					Engine::mixer()->framesPerPeriod() );
+	BufferManager::markSilent( m_fxChannels[0]->m_buffer );
 }
 
 
 
-
-void FxMixer::prepareMasterMix()
+void FxMixer::invalidateRoutingPlan()
 {
-	BufferManager::clear( m_fxChannels[0]->m_buffer,
-					Engine::mixer()->framesPerPeriod() );
+	m_routingChanged = true;
 }
 
 
 
-void FxMixer::masterMix( sampleFrame * _buf )
+
+void FxMixer::updateRoutingPlan()
 {
-	const int fpp = Engine::mixer()->framesPerPeriod();
+	m_activeChannels.clear();
+	m_rootChannels.clear();
+	m_mutedChannels.clear();
 
-	// add the channels that have no dependencies (no incoming senders, ie.
-	// no receives) to the jobqueue. The channels that have receives get
-	// added when their senders get processed, which is detected by
-	// dependency counting.
-	// also instantly add all muted channels as they don't need to care
-	// about their senders, and can just increment the deps of their
-	// recipients right away.
-	MixerWorkerThread::resetJobQueue( MixerWorkerThread::JobQueue::Dynamic );
 	for( FxChannel * ch : m_fxChannels )
 	{
 		ch->m_muted = ch->m_muteModel.value();
-		if( ch->m_muted ) // instantly "process" muted channels
-		{
-			ch->processed();
-			ch->done();
-		}
-		else if( ch->m_receives.size() == 0 )
-		{
-			ch->m_queued = true;
-			MixerWorkerThread::addJob( ch );
-		}
 	}
-	while (m_fxChannels[0]->state() != ThreadableJob::ProcessingState::Done)
+
+	for( FxChannel * ch : m_fxChannels )
 	{
-		bool found = false;
-		for( FxChannel * ch : m_fxChannels )
+		if( ch->m_muted )
 		{
-			const auto s = ch->state();
-			if (s == ThreadableJob::ProcessingState::Queued
-				|| s == ThreadableJob::ProcessingState::InProgress)
+			// muted channels are never written to, so clear them once
+			// instead of every period
+			BufferManager::clear( ch->m_buffer,
+					Engine::mixer()->framesPerPeriod() );
+			BufferManager::markSilent( ch->m_buffer );
+			ch->m_hasInput = false;
+			m_mutedChannels.push_back( ch );
+			continue;
+		}
+
+		// muted senders don't send anything, so don't wait for them
+		ch->m_senderDependencies = 0;
+		for( const FxRoute * senderRoute : ch->m_receives )
+		{
+			if( senderRoute->sender()->m_muted == false )
 			{
-				found = true;
-				break;
+				++ch->m_senderDependencies;
 			}
 		}
-		if( !found )
+
+		m_activeChannels.push_back( ch );
+		if( ch->m_senderDependencies == 0 )
 		{
-			break;
+			m_rootChannels.push_back( ch );
 		}
-		MixerWorkerThread::startAndWaitForJobs();
 	}
+}
+
+
+
+
+void FxMixer::prepareJobs()
+{
+	if( m_routingChanged.exchange( false ) )
+	{
+		updateRoutingPlan();
+	}
+
+	for( FxChannel * ch : m_activeChannels )
+	{
+		ch->m_dependencies = ch->m_senderDependencies;
+		ch->m_inputPorts.clear();
+	}
+
+	// all jobs of the last period are done
+	for( FxChannel * ch : m_fxChannels )
+	{
+		ch->m_cpuUsage.finishPeriod();
+		ch->m_fxChain.finishPeriod();
+	}
+}
+
+
+
+
+void FxMixer::addInputPort( AudioPort * _port )
+{
+	FxChannel * ch = m_fxChannels[_port->jobFxChannel()];
+	if( ch->m_muted == false )
+	{
+		++ch->m_dependencies;
+		ch->m_inputPorts.push_back( _port );
+	}
+}
+
+
+
+
+void FxMixer::queueJobs()
+{
+	// add the channels that have no dependencies (no incoming senders and
+	// no audio ports sending to them) to the jobqueue. The other channels
+	// get added when their senders and ports get processed, which is
+	// detected by dependency counting.
+	for( FxChannel * ch : m_rootChannels )
+	{
+		if( ch->m_dependencies == 0 )
+		{
+			ch->m_queued = true;
+			MixerWorkerThread::addJob( ch );
+		}
+	}
+
+	for( FxChannel * ch : m_mutedChannels )
+	{
+		ch->m_peakLeft = ch->m_peakRight = 0.0f;
+	}
+}
+
+
+
+
+void FxMixer::portProcessed( fx_ch_t _ch )
+{
+	FxChannel * ch = m_fxChannels[_ch];
+	if( ch->m_muted == false )
+	{
+		ch->incrementDeps();
+	}
+}
+
+
+
+
+void FxMixer::masterMix( sampleFrame * _buf )
+{
+	const int fpp = Engine::mixer()->framesPerPeriod();
 
 	// handle sample-exact data in master volume fader
 	ValueBuffer * volBuf = m_fxChannels[0]->m_volumeModel.valueBuffer();
@@ -658,6 +771,7 @@ void FxMixer::masterMix( sampleFrame * _buf )
 			m_fxChannels[0]->m_buffer[f][0] *= volBuf->values()[f];
 			m_fxChannels[0]->m_buffer[f][1] *= volBuf->values()[f];
 		}
+		BufferManager::invalidate( m_fxChannels[0]->m_buffer );
 	}
 
 	const float v = volBuf
@@ -667,15 +781,15 @@ void FxMixer::masterMix( sampleFrame * _buf )
 
 	// clear all channel buffers and
 	// reset channel process state
-	for( int i = 0; i < numChannels(); ++i)
+	for( FxChannel * ch : m_activeChannels )
 	{
-		BufferManager::clear( m_fxChannels[i]->m_buffer,
-				Engine::mixer()->framesPerPeriod() );
-		m_fxChannels[i]->reset();
-		m_fxChannels[i]->m_queued = false;
+		BufferManager::clear( ch->m_buffer, fpp );
+		BufferManager::markSilent( ch->m_buffer );
+		ch->reset();
+		ch->m_queued = false;
 		// also reset hasInput
-		m_fxChannels[i]->m_hasInput = false;
-		m_fxChannels[i]->m_dependenciesMet = 0;
+		ch->m_hasInput = false;
+		ch->m_dependenciesMet = 0;
 	}
 }
 
@@ -28,6 +28,7 @@
 
 #include "DummyInstrument.h"
 #include "InstrumentTrack.h"
+#include "NoteBatch.h"
 #include "lmms_constants.h"
 
 
@@ -46,6 +47,17 @@ void Instrument::play( sampleFrame * )
 
 
 
+void Instrument::playNotes( NoteBatch & batch )
+{
+	for( int voice = 0; voice < batch.size(); ++voice )
+	{
+		playNote( batch.note( voice ), batch.buffers()[voice] );
+	}
+}
+
+
+
+
 void Instrument::deleteNotePluginData( NotePlayHandle * )
 {
 }
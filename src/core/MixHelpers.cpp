@@ -25,11 +25,34 @@
 #include "MixHelpers.h"
 
 #include <cstdio>
+#include <cstring>
 
 #include "lmms_math.h"
 #include "ValueBuffer.h"
 
-#include <cstdio>
+#if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
+#	if defined(__GNUC__)
+		// kernels for newer instruction sets are compiled per function and
+		// selected at runtime, so the rest of LMMS still runs on any x86
+#		define MIXHELPERS_X86
+#		define MIXHELPERS_AVX
+#		define SIMD_TARGET(isa) __attribute__((target(isa)))
+#	elif defined(_M_X64)
+#		define MIXHELPERS_X86
+#		define SIMD_TARGET(isa)
+#	endif
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#	define MIXHELPERS_NEON
+#endif
+
+#ifdef MIXHELPERS_X86
+#include <immintrin.h>
+#endif
+#ifdef MIXHELPERS_NEON
+#include <arm_neon.h>
+#endif
 
 
 static bool s_NaNHandler;
@@ -61,13 +84,95 @@ static inline void run( sampleFrame* dst, const sample_t* srcLeft, const sample_
 
 
 
-bool isSilent( const sampleFrame* src, int frames )
+static const float SanitizeLimit = 1000.0f;
+static const float MaxFinite = std::numeric_limits<float>::max();
+
+
+static inline bool isBad( sample_t s )
+{
+	return isinf( s ) || isnan( s );
+}
+
+
+static inline float * samples( sampleFrame * buf )
+{
+	return reinterpret_cast<float *>( buf );
+}
+
+static inline const float * samples( const sampleFrame * buf )
+{
+	return reinterpret_cast<const float *>( buf );
+}
+
+
+
+
+// Scalar reference kernels. The SIMD kernels below do the same operations
+// in the same order, so all of them produce bit-identical output. They also
+// handle the frames left over after the last full vector.
+
+static void addScalar( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		dst[f][0] += src[f][0];
+		dst[f][1] += src[f][1];
+	}
+}
+
+template<bool Sanitize>
+static void addMultipliedScalar( sampleFrame* dst, const sampleFrame* src, float coeff, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int c = 0; c < DEFAULT_CHANNELS; ++c )
+		{
+			dst[f][c] += Sanitize && isBad( src[f][c] ) ? 0.0f : src[f][c] * coeff;
+		}
+	}
+}
+
+template<bool Sanitize>
+static void addMultipliedByBuffersScalar( sampleFrame* dst, const sampleFrame* src,
+						const float* coeffs1, const float* coeffs2, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int c = 0; c < DEFAULT_CHANNELS; ++c )
+		{
+			dst[f][c] += Sanitize && isBad( src[f][c] ) ? 0.0f : src[f][c] * coeffs1[f] * coeffs2[f];
+		}
+	}
+}
+
+template<bool Sanitize>
+static void addMultipliedByGainsScalar( sampleFrame* dst, const sampleFrame* src,
+						const sampleFrame* gains, int frames )
 {
-	const float silenceThreshold = 0.0000001f;
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int c = 0; c < DEFAULT_CHANNELS; ++c )
+		{
+			dst[f][c] += Sanitize && isBad( src[f][c] ) ? 0.0f : src[f][c] * gains[f][c];
+		}
+	}
+}
+
+static void addMultipliedStereoScalar( sampleFrame* dst, const sampleFrame* src,
+						float coeffLeft, float coeffRight, int frames )
+{
+	for( int f = 0; f < frames; ++f )
+	{
+		dst[f][0] += src[f][0] * coeffLeft;
+		dst[f][1] += src[f][1] * coeffRight;
+	}
+}
 
+static bool isSilentScalar( const sampleFrame* src, int frames )
+{
 	for( int i = 0; i < frames; ++i )
 	{
-		if( fabsf( src[i][0] ) >= silenceThreshold || fabsf( src[i][1] ) >= silenceThreshold )
+		if( fabsf( src[i][0] ) >= SilenceThreshold || fabsf( src[i][1] ) >= SilenceThreshold )
 		{
 			return false;
 		}
@@ -76,88 +181,955 @@ bool isSilent( const sampleFrame* src, int frames )
 	return true;
 }
 
-bool useNaNHandler()
+//! Clamps all samples, returns false if any of them is inf or nan
+static bool clampScalar( sampleFrame* src, int frames )
 {
-	return s_NaNHandler;
+	bool good = true;
+	for( int f = 0; f < frames; ++f )
+	{
+		for( int c = 0; c < DEFAULT_CHANNELS; ++c )
+		{
+			good = good && !isBad( src[f][c] );
+			src[f][c] = qBound( -SanitizeLimit, src[f][c], SanitizeLimit );
+		}
+	}
+	return good;
 }
 
-void setNaNHandler( bool use )
+static bool sanitizeScalar( sampleFrame* src, int frames )
 {
-	s_NaNHandler = use;
+	if( !clampScalar( src, frames ) )
+	{
+		memset( src, 0, sizeof( sampleFrame ) * frames );
+		return true;
+	}
+	return false;
 }
 
-/*! \brief Function for sanitizing a buffer of infs/nans - returns true if those are found */
-bool sanitize( sampleFrame * src, int frames )
+//! Raises peaks to the highest absolute sample per channel, ignoring nans.
+//! Returns true if an inf or nan was found.
+static bool raisePeaksScalar( const sampleFrame* src, int frames, float* peaks )
 {
-	if( !useNaNHandler() )
+	bool bad = false;
+	for( int f = 0; f < frames; ++f )
 	{
-		return false;
+		for( int c = 0; c < DEFAULT_CHANNELS; ++c )
+		{
+			const float level = fabsf( src[f][c] );
+			peaks[c] = level > peaks[c] ? level : peaks[c];
+			bad = bad || isBad( src[f][c] );
+		}
 	}
+	return bad;
+}
 
-	bool found = false;
-	for( int f = 0; f < frames; ++f )
+static bool peakValuesScalar( const sampleFrame* src, int frames, float* peaks )
+{
+	peaks[0] = peaks[1] = 0.0f;
+	return raisePeaksScalar( src, frames, peaks );
+}
+
+
+
+
+#ifdef MIXHELPERS_X86
+
+// SSE2 - 2 frames per vector
+
+static inline SIMD_TARGET( "sse2" ) __m128 nonFiniteSse2( __m128 in )
+{
+	const __m128 absMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+	// true for nan as well, as the comparison is unordered
+	return _mm_cmpnle_ps( _mm_and_ps( in, absMask ), _mm_set1_ps( MaxFinite ) );
+}
+
+template<bool Sanitize>
+static inline SIMD_TARGET( "sse2" ) void accumulateSse2( float* dst, __m128 in, __m128 product )
+{
+	if( Sanitize )
+	{
+		product = _mm_andnot_ps( nonFiniteSse2( in ), product );
+	}
+	_mm_storeu_ps( dst, _mm_add_ps( _mm_loadu_ps( dst ), product ) );
+}
+
+static SIMD_TARGET( "sse2" ) void addSse2( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		_mm_storeu_ps( d + i, _mm_add_ps( _mm_loadu_ps( d + i ), _mm_loadu_ps( s + i ) ) );
+	}
+	addScalar( dst + vectorFrames, src + vectorFrames, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static SIMD_TARGET( "sse2" ) void addMultipliedSse2( sampleFrame* dst, const sampleFrame* src, float coeff, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m128 c = _mm_set1_ps( coeff );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const __m128 in = _mm_loadu_ps( s + i );
+		accumulateSse2<Sanitize>( d + i, in, _mm_mul_ps( in, c ) );
+	}
+	addMultipliedScalar<Sanitize>( dst + vectorFrames, src + vectorFrames, coeff, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static SIMD_TARGET( "sse2" ) void addMultipliedByBuffersSse2( sampleFrame* dst, const sampleFrame* src,
+						const float* coeffs1, const float* coeffs2, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const int vectorFrames = frames & ~3;
+	for( int f = 0; f < vectorFrames; f += 4 )
+	{
+		const __m128 c1 = _mm_loadu_ps( coeffs1 + f );
+		const __m128 c2 = _mm_loadu_ps( coeffs2 + f );
+		// duplicate each frame's coefficient for both channels
+		const __m128 in0 = _mm_loadu_ps( s + f * 2 );
+		const __m128 in1 = _mm_loadu_ps( s + f * 2 + 4 );
+		accumulateSse2<Sanitize>( d + f * 2, in0, _mm_mul_ps(
+			_mm_mul_ps( in0, _mm_unpacklo_ps( c1, c1 ) ), _mm_unpacklo_ps( c2, c2 ) ) );
+		accumulateSse2<Sanitize>( d + f * 2 + 4, in1, _mm_mul_ps(
+			_mm_mul_ps( in1, _mm_unpackhi_ps( c1, c1 ) ), _mm_unpackhi_ps( c2, c2 ) ) );
+	}
+	addMultipliedByBuffersScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+				coeffs1 + vectorFrames, coeffs2 + vectorFrames, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static SIMD_TARGET( "sse2" ) void addMultipliedByGainsSse2( sampleFrame* dst, const sampleFrame* src,
+						const sampleFrame* gains, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const float * g = samples( gains );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
 	{
-		for( int c = 0; c < 2; ++c )
+		const __m128 in = _mm_loadu_ps( s + i );
+		accumulateSse2<Sanitize>( d + i, in, _mm_mul_ps( in, _mm_loadu_ps( g + i ) ) );
+	}
+	addMultipliedByGainsScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+						gains + vectorFrames, frames - vectorFrames );
+}
+
+static SIMD_TARGET( "sse2" ) void addMultipliedStereoSse2( sampleFrame* dst, const sampleFrame* src,
+						float coeffLeft, float coeffRight, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m128 c = _mm_setr_ps( coeffLeft, coeffRight, coeffLeft, coeffRight );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const __m128 in = _mm_loadu_ps( s + i );
+		accumulateSse2<false>( d + i, in, _mm_mul_ps( in, c ) );
+	}
+	addMultipliedStereoScalar( dst + vectorFrames, src + vectorFrames,
+						coeffLeft, coeffRight, frames - vectorFrames );
+}
+
+static SIMD_TARGET( "sse2" ) bool isSilentSse2( const sampleFrame* src, int frames )
+{
+	const float * s = samples( src );
+	const __m128 absMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+	const __m128 threshold = _mm_set1_ps( SilenceThreshold );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const __m128 level = _mm_and_ps( _mm_loadu_ps( s + i ), absMask );
+		if( _mm_movemask_ps( _mm_cmpge_ps( level, threshold ) ) )
 		{
-			if( isinf( src[f][c] ) || isnan( src[f][c] ) )
-			{
-				#ifdef LMMS_DEBUG
-					printf("Bad data, clearing buffer. frame: ");
-					printf("%d: value %f\n", f, src[f][c]);
-				#endif
-				for( int f = 0; f < frames; ++f )
-				{
-					for( int c = 0; c < 2; ++c )
-					{
-						src[f][c] = 0.0f;
-					}
-				}
-				found = true;
-				return found;
-			}
-			else
-			{
-				src[f][c] = qBound( -1000.0f, src[f][c], 1000.0f );
-			}
+			return false;
 		}
 	}
-	return found;
+	return isSilentScalar( src + vectorFrames, frames - vectorFrames );
 }
 
+static SIMD_TARGET( "sse2" ) bool sanitizeSse2( sampleFrame* src, int frames )
+{
+	float * s = samples( src );
+	const __m128 lower = _mm_set1_ps( -SanitizeLimit );
+	const __m128 upper = _mm_set1_ps( SanitizeLimit );
+	__m128 bad = _mm_setzero_ps();
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const __m128 in = _mm_loadu_ps( s + i );
+		bad = _mm_or_ps( bad, nonFiniteSse2( in ) );
+		_mm_storeu_ps( s + i, _mm_max_ps( _mm_min_ps( in, upper ), lower ) );
+	}
+	const bool tailGood = clampScalar( src + vectorFrames, frames - vectorFrames );
+	if( _mm_movemask_ps( bad ) || !tailGood )
+	{
+		memset( src, 0, sizeof( sampleFrame ) * frames );
+		return true;
+	}
+	return false;
+}
 
-struct AddOp
+static SIMD_TARGET( "sse2" ) bool peakValuesSse2( const sampleFrame* src, int frames, float* peaks )
 {
-	void operator()( sampleFrame& dst, const sampleFrame& src ) const
+	const float * s = samples( src );
+	const __m128 absMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+	const __m128 maxFinite = _mm_set1_ps( MaxFinite );
+	__m128 peak = _mm_setzero_ps();
+	__m128 bad = _mm_setzero_ps();
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
 	{
-		dst[0] += src[0];
-		dst[1] += src[1];
+		const __m128 level = _mm_and_ps( _mm_loadu_ps( s + i ), absMask );
+		// with the level as first operand, nans leave the peak untouched
+		peak = _mm_max_ps( level, peak );
+		bad = _mm_or_ps( bad, _mm_cmpnle_ps( level, maxFinite ) );
 	}
-} ;
+	// fold both frames of the vector into one
+	peak = _mm_max_ps( peak, _mm_movehl_ps( peak, peak ) );
+	peaks[0] = _mm_cvtss_f32( peak );
+	peaks[1] = _mm_cvtss_f32( _mm_shuffle_ps( peak, peak, 1 ) );
+	const bool tailBad = raisePeaksScalar( src + vectorFrames, frames - vectorFrames, peaks );
+	return _mm_movemask_ps( bad ) || tailBad;
+}
 
-void add( sampleFrame* dst, const sampleFrame* src, int frames )
+#endif
+
+
+
+
+#ifdef MIXHELPERS_AVX
+
+// AVX2 - 4 frames per vector
+//
+// The AVX kernels clear the upper register halves before running the scalar
+// reference on the tail, as mixing VEX and legacy SSE code stalls otherwise.
+
+static inline SIMD_TARGET( "avx2" ) __m256 nonFiniteAvx2( __m256 in )
 {
-	run<>( dst, src, frames, AddOp() );
+	const __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+	return _mm256_cmp_ps( _mm256_and_ps( in, absMask ), _mm256_set1_ps( MaxFinite ), _CMP_NLE_UQ );
 }
 
+template<bool Sanitize>
+static inline SIMD_TARGET( "avx2" ) void accumulateAvx2( float* dst, __m256 in, __m256 product )
+{
+	if( Sanitize )
+	{
+		product = _mm256_andnot_ps( nonFiniteAvx2( in ), product );
+	}
+	_mm256_storeu_ps( dst, _mm256_add_ps( _mm256_loadu_ps( dst ), product ) );
+}
 
+static SIMD_TARGET( "avx2" ) void addAvx2( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const int vectorFrames = frames & ~3;
+	for( int i = 0; i < vectorFrames * 2; i += 8 )
+	{
+		_mm256_storeu_ps( d + i, _mm256_add_ps( _mm256_loadu_ps( d + i ), _mm256_loadu_ps( s + i ) ) );
+	}
+	_mm256_zeroupper();
+	addScalar( dst + vectorFrames, src + vectorFrames, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static SIMD_TARGET( "avx2" ) void addMultipliedAvx2( sampleFrame* dst, const sampleFrame* src, float coeff, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m256 c = _mm256_set1_ps( coeff );
+	const int vectorFrames = frames & ~3;
+	for( int i = 0; i < vectorFrames * 2; i += 8 )
+	{
+		const __m256 in = _mm256_loadu_ps( s + i );
+		accumulateAvx2<Sanitize>( d + i, in, _mm256_mul_ps( in, c ) );
+	}
+	_mm256_zeroupper();
+	addMultipliedScalar<Sanitize>( dst + vectorFrames, src + vectorFrames, coeff, frames - vectorFrames );
+}
 
-struct AddMultipliedOp
+template<bool Sanitize>
+static SIMD_TARGET( "avx2" ) void addMultipliedByBuffersAvx2( sampleFrame* dst, const sampleFrame* src,
+						const float* coeffs1, const float* coeffs2, int frames )
 {
-	AddMultipliedOp( float coeff ) : m_coeff( coeff ) { }
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m256i lowFrames = _mm256_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3 );
+	const __m256i highFrames = _mm256_setr_epi32( 4, 4, 5, 5, 6, 6, 7, 7 );
+	const int vectorFrames = frames & ~7;
+	for( int f = 0; f < vectorFrames; f += 8 )
+	{
+		const __m256 c1 = _mm256_loadu_ps( coeffs1 + f );
+		const __m256 c2 = _mm256_loadu_ps( coeffs2 + f );
+		const __m256 in0 = _mm256_loadu_ps( s + f * 2 );
+		const __m256 in1 = _mm256_loadu_ps( s + f * 2 + 8 );
+		accumulateAvx2<Sanitize>( d + f * 2, in0, _mm256_mul_ps(
+			_mm256_mul_ps( in0, _mm256_permutevar8x32_ps( c1, lowFrames ) ),
+			_mm256_permutevar8x32_ps( c2, lowFrames ) ) );
+		accumulateAvx2<Sanitize>( d + f * 2 + 8, in1, _mm256_mul_ps(
+			_mm256_mul_ps( in1, _mm256_permutevar8x32_ps( c1, highFrames ) ),
+			_mm256_permutevar8x32_ps( c2, highFrames ) ) );
+	}
+	_mm256_zeroupper();
+	addMultipliedByBuffersScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+				coeffs1 + vectorFrames, coeffs2 + vectorFrames, frames - vectorFrames );
+}
 
-	void operator()( sampleFrame& dst, const sampleFrame& src ) const
+template<bool Sanitize>
+static SIMD_TARGET( "avx2" ) void addMultipliedByGainsAvx2( sampleFrame* dst, const sampleFrame* src,
+						const sampleFrame* gains, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const float * g = samples( gains );
+	const int vectorFrames = frames & ~3;
+	for( int i = 0; i < vectorFrames * 2; i += 8 )
 	{
-		dst[0] += src[0] * m_coeff;
-		dst[1] += src[1] * m_coeff;
+		const __m256 in = _mm256_loadu_ps( s + i );
+		accumulateAvx2<Sanitize>( d + i, in, _mm256_mul_ps( in, _mm256_loadu_ps( g + i ) ) );
 	}
+	_mm256_zeroupper();
+	addMultipliedByGainsScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+						gains + vectorFrames, frames - vectorFrames );
+}
 
-	const float m_coeff;
+static SIMD_TARGET( "avx2" ) void addMultipliedStereoAvx2( sampleFrame* dst, const sampleFrame* src,
+						float coeffLeft, float coeffRight, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m256 c = _mm256_setr_ps( coeffLeft, coeffRight, coeffLeft, coeffRight,
+						coeffLeft, coeffRight, coeffLeft, coeffRight );
+	const int vectorFrames = frames & ~3;
+	for( int i = 0; i < vectorFrames * 2; i += 8 )
+	{
+		const __m256 in = _mm256_loadu_ps( s + i );
+		accumulateAvx2<false>( d + i, in, _mm256_mul_ps( in, c ) );
+	}
+	_mm256_zeroupper();
+	addMultipliedStereoScalar( dst + vectorFrames, src + vectorFrames,
+						coeffLeft, coeffRight, frames - vectorFrames );
+}
+
+static SIMD_TARGET( "avx2" ) bool isSilentAvx2( const sampleFrame* src, int frames )
+{
+	const float * s = samples( src );
+	const __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+	const __m256 threshold = _mm256_set1_ps( SilenceThreshold );
+	const int vectorFrames = frames & ~3;
+	for( int i = 0; i < vectorFrames * 2; i += 8 )
+	{
+		const __m256 level = _mm256_and_ps( _mm256_loadu_ps( s + i ), absMask );
+		if( _mm256_movemask_ps( _mm256_cmp_ps( level, threshold, _CMP_GE_OQ ) ) )
+		{
+			return false;
+		}
+	}
+	_mm256_zeroupper();
+	return isSilentScalar( src + vectorFrames, frames - vectorFrames );
+}
+
+static SIMD_TARGET( "avx2" ) bool sanitizeAvx2( sampleFrame* src, int frames )
+{
+	float * s = samples( src );
+	const __m256 lower = _mm256_set1_ps( -SanitizeLimit );
+	const __m256 upper = _mm256_set1_ps( SanitizeLimit );
+	__m256 bad = _mm256_setzero_ps();
+	const int vectorFrames = frames & ~3;
+	for( int i = 0; i < vectorFrames * 2; i += 8 )
+	{
+		const __m256 in = _mm256_loadu_ps( s + i );
+		bad = _mm256_or_ps( bad, nonFiniteAvx2( in ) );
+		_mm256_storeu_ps( s + i, _mm256_max_ps( _mm256_min_ps( in, upper ), lower ) );
+	}
+	_mm256_zeroupper();
+	const bool tailGood = clampScalar( src + vectorFrames, frames - vectorFrames );
+	if( _mm256_movemask_ps( bad ) || !tailGood )
+	{
+		memset( src, 0, sizeof( sampleFrame ) * frames );
+		return true;
+	}
+	return false;
+}
+
+static SIMD_TARGET( "avx2" ) bool peakValuesAvx2( const sampleFrame* src, int frames, float* peaks )
+{
+	const float * s = samples( src );
+	const __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+	const __m256 maxFinite = _mm256_set1_ps( MaxFinite );
+	__m256 peak = _mm256_setzero_ps();
+	__m256 bad = _mm256_setzero_ps();
+	const int vectorFrames = frames & ~3;
+	for( int i = 0; i < vectorFrames * 2; i += 8 )
+	{
+		const __m256 level = _mm256_and_ps( _mm256_loadu_ps( s + i ), absMask );
+		peak = _mm256_max_ps( level, peak );
+		bad = _mm256_or_ps( bad, _mm256_cmp_ps( level, maxFinite, _CMP_NLE_UQ ) );
+	}
+	__m128 folded = _mm_max_ps( _mm256_castps256_ps128( peak ), _mm256_extractf128_ps( peak, 1 ) );
+	folded = _mm_max_ps( folded, _mm_movehl_ps( folded, folded ) );
+	peaks[0] = _mm_cvtss_f32( folded );
+	peaks[1] = _mm_cvtss_f32( _mm_shuffle_ps( folded, folded, 1 ) );
+	const bool vectorBad = _mm256_movemask_ps( bad ) != 0;
+	_mm256_zeroupper();
+	const bool tailBad = raisePeaksScalar( src + vectorFrames, frames - vectorFrames, peaks );
+	return vectorBad || tailBad;
+}
+
+
+
+
+// AVX-512 - 8 frames per vector
+
+#if defined(__GNUC__) && !defined(__clang__)
+// the intrinsics of some GCC versions trip over their own
+// _mm512_undefined_ps() when inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+static inline SIMD_TARGET( "avx512f" ) __mmask16 nonFiniteAvx512( __m512 in )
+{
+	return _mm512_cmp_ps_mask( _mm512_abs_ps( in ), _mm512_set1_ps( MaxFinite ), _CMP_NLE_UQ );
+}
+
+template<bool Sanitize>
+static inline SIMD_TARGET( "avx512f" ) void accumulateAvx512( float* dst, __m512 in, __m512 product )
+{
+	if( Sanitize )
+	{
+		product = _mm512_maskz_mov_ps( ~nonFiniteAvx512( in ), product );
+	}
+	_mm512_storeu_ps( dst, _mm512_add_ps( _mm512_loadu_ps( dst ), product ) );
+}
+
+static SIMD_TARGET( "avx512f" ) void addAvx512( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const int vectorFrames = frames & ~7;
+	for( int i = 0; i < vectorFrames * 2; i += 16 )
+	{
+		_mm512_storeu_ps( d + i, _mm512_add_ps( _mm512_loadu_ps( d + i ), _mm512_loadu_ps( s + i ) ) );
+	}
+	_mm256_zeroupper();
+	addScalar( dst + vectorFrames, src + vectorFrames, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static SIMD_TARGET( "avx512f" ) void addMultipliedAvx512( sampleFrame* dst, const sampleFrame* src, float coeff, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m512 c = _mm512_set1_ps( coeff );
+	const int vectorFrames = frames & ~7;
+	for( int i = 0; i < vectorFrames * 2; i += 16 )
+	{
+		const __m512 in = _mm512_loadu_ps( s + i );
+		accumulateAvx512<Sanitize>( d + i, in, _mm512_mul_ps( in, c ) );
+	}
+	_mm256_zeroupper();
+	addMultipliedScalar<Sanitize>( dst + vectorFrames, src + vectorFrames, coeff, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static SIMD_TARGET( "avx512f" ) void addMultipliedByBuffersAvx512( sampleFrame* dst, const sampleFrame* src,
+						const float* coeffs1, const float* coeffs2, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m512i lowFrames = _mm512_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7 );
+	const __m512i highFrames = _mm512_setr_epi32( 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15 );
+	const int vectorFrames = frames & ~15;
+	for( int f = 0; f < vectorFrames; f += 16 )
+	{
+		const __m512 c1 = _mm512_loadu_ps( coeffs1 + f );
+		const __m512 c2 = _mm512_loadu_ps( coeffs2 + f );
+		const __m512 in0 = _mm512_loadu_ps( s + f * 2 );
+		const __m512 in1 = _mm512_loadu_ps( s + f * 2 + 16 );
+		accumulateAvx512<Sanitize>( d + f * 2, in0, _mm512_mul_ps(
+			_mm512_mul_ps( in0, _mm512_permutexvar_ps( lowFrames, c1 ) ),
+			_mm512_permutexvar_ps( lowFrames, c2 ) ) );
+		accumulateAvx512<Sanitize>( d + f * 2 + 16, in1, _mm512_mul_ps(
+			_mm512_mul_ps( in1, _mm512_permutexvar_ps( highFrames, c1 ) ),
+			_mm512_permutexvar_ps( highFrames, c2 ) ) );
+	}
+	_mm256_zeroupper();
+	addMultipliedByBuffersScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+				coeffs1 + vectorFrames, coeffs2 + vectorFrames, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static SIMD_TARGET( "avx512f" ) void addMultipliedByGainsAvx512( sampleFrame* dst, const sampleFrame* src,
+						const sampleFrame* gains, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const float * g = samples( gains );
+	const int vectorFrames = frames & ~7;
+	for( int i = 0; i < vectorFrames * 2; i += 16 )
+	{
+		const __m512 in = _mm512_loadu_ps( s + i );
+		accumulateAvx512<Sanitize>( d + i, in, _mm512_mul_ps( in, _mm512_loadu_ps( g + i ) ) );
+	}
+	_mm256_zeroupper();
+	addMultipliedByGainsScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+						gains + vectorFrames, frames - vectorFrames );
+}
+
+static SIMD_TARGET( "avx512f" ) void addMultipliedStereoAvx512( sampleFrame* dst, const sampleFrame* src,
+						float coeffLeft, float coeffRight, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const __m512 c = _mm512_setr4_ps( coeffLeft, coeffRight, coeffLeft, coeffRight );
+	const int vectorFrames = frames & ~7;
+	for( int i = 0; i < vectorFrames * 2; i += 16 )
+	{
+		const __m512 in = _mm512_loadu_ps( s + i );
+		accumulateAvx512<false>( d + i, in, _mm512_mul_ps( in, c ) );
+	}
+	_mm256_zeroupper();
+	addMultipliedStereoScalar( dst + vectorFrames, src + vectorFrames,
+						coeffLeft, coeffRight, frames - vectorFrames );
+}
+
+static SIMD_TARGET( "avx512f" ) bool isSilentAvx512( const sampleFrame* src, int frames )
+{
+	const float * s = samples( src );
+	const __m512 threshold = _mm512_set1_ps( SilenceThreshold );
+	const int vectorFrames = frames & ~7;
+	for( int i = 0; i < vectorFrames * 2; i += 16 )
+	{
+		const __m512 level = _mm512_abs_ps( _mm512_loadu_ps( s + i ) );
+		if( _mm512_cmp_ps_mask( level, threshold, _CMP_GE_OQ ) )
+		{
+			return false;
+		}
+	}
+	_mm256_zeroupper();
+	return isSilentScalar( src + vectorFrames, frames - vectorFrames );
+}
+
+static SIMD_TARGET( "avx512f" ) bool sanitizeAvx512( sampleFrame* src, int frames )
+{
+	float * s = samples( src );
+	const __m512 lower = _mm512_set1_ps( -SanitizeLimit );
+	const __m512 upper = _mm512_set1_ps( SanitizeLimit );
+	__mmask16 bad = 0;
+	const int vectorFrames = frames & ~7;
+	for( int i = 0; i < vectorFrames * 2; i += 16 )
+	{
+		const __m512 in = _mm512_loadu_ps( s + i );
+		bad |= nonFiniteAvx512( in );
+		_mm512_storeu_ps( s + i, _mm512_max_ps( _mm512_min_ps( in, upper ), lower ) );
+	}
+	_mm256_zeroupper();
+	const bool tailGood = clampScalar( src + vectorFrames, frames - vectorFrames );
+	if( bad || !tailGood )
+	{
+		memset( src, 0, sizeof( sampleFrame ) * frames );
+		return true;
+	}
+	return false;
+}
+
+static SIMD_TARGET( "avx512f" ) bool peakValuesAvx512( const sampleFrame* src, int frames, float* peaks )
+{
+	const float * s = samples( src );
+	const __m512 maxFinite = _mm512_set1_ps( MaxFinite );
+	__m512 peak = _mm512_setzero_ps();
+	__mmask16 bad = 0;
+	const int vectorFrames = frames & ~7;
+	for( int i = 0; i < vectorFrames * 2; i += 16 )
+	{
+		const __m512 level = _mm512_abs_ps( _mm512_loadu_ps( s + i ) );
+		peak = _mm512_max_ps( level, peak );
+		bad |= _mm512_cmp_ps_mask( level, maxFinite, _CMP_NLE_UQ );
+	}
+	// even lanes hold the left channel, odd lanes the right one
+	peaks[0] = _mm512_mask_reduce_max_ps( 0x5555, peak );
+	peaks[1] = _mm512_mask_reduce_max_ps( 0xaaaa, peak );
+	_mm256_zeroupper();
+	const bool tailBad = raisePeaksScalar( src + vectorFrames, frames - vectorFrames, peaks );
+	return bad || tailBad;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+
+
+
+#ifdef MIXHELPERS_NEON
+
+// NEON - 2 frames per vector
+
+static inline uint32x4_t nonFiniteNeon( float32x4_t in )
+{
+	return vmvnq_u32( vcleq_f32( vabsq_f32( in ), vdupq_n_f32( MaxFinite ) ) );
+}
+
+template<bool Sanitize>
+static inline void accumulateNeon( float* dst, float32x4_t in, float32x4_t product )
+{
+	if( Sanitize )
+	{
+		product = vreinterpretq_f32_u32( vbicq_u32( vreinterpretq_u32_f32( product ), nonFiniteNeon( in ) ) );
+	}
+	vst1q_f32( dst, vaddq_f32( vld1q_f32( dst ), product ) );
+}
+
+static void addNeon( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		vst1q_f32( d + i, vaddq_f32( vld1q_f32( d + i ), vld1q_f32( s + i ) ) );
+	}
+	addScalar( dst + vectorFrames, src + vectorFrames, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static void addMultipliedNeon( sampleFrame* dst, const sampleFrame* src, float coeff, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const float32x4_t c = vdupq_n_f32( coeff );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const float32x4_t in = vld1q_f32( s + i );
+		accumulateNeon<Sanitize>( d + i, in, vmulq_f32( in, c ) );
+	}
+	addMultipliedScalar<Sanitize>( dst + vectorFrames, src + vectorFrames, coeff, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static void addMultipliedByBuffersNeon( sampleFrame* dst, const sampleFrame* src,
+						const float* coeffs1, const float* coeffs2, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const int vectorFrames = frames & ~3;
+	for( int f = 0; f < vectorFrames; f += 4 )
+	{
+		const float32x4_t c1 = vld1q_f32( coeffs1 + f );
+		const float32x4_t c2 = vld1q_f32( coeffs2 + f );
+		const float32x4_t in0 = vld1q_f32( s + f * 2 );
+		const float32x4_t in1 = vld1q_f32( s + f * 2 + 4 );
+		accumulateNeon<Sanitize>( d + f * 2, in0, vmulq_f32(
+			vmulq_f32( in0, vzip1q_f32( c1, c1 ) ), vzip1q_f32( c2, c2 ) ) );
+		accumulateNeon<Sanitize>( d + f * 2 + 4, in1, vmulq_f32(
+			vmulq_f32( in1, vzip2q_f32( c1, c1 ) ), vzip2q_f32( c2, c2 ) ) );
+	}
+	addMultipliedByBuffersScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+				coeffs1 + vectorFrames, coeffs2 + vectorFrames, frames - vectorFrames );
+}
+
+template<bool Sanitize>
+static void addMultipliedByGainsNeon( sampleFrame* dst, const sampleFrame* src,
+						const sampleFrame* gains, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const float * g = samples( gains );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const float32x4_t in = vld1q_f32( s + i );
+		accumulateNeon<Sanitize>( d + i, in, vmulq_f32( in, vld1q_f32( g + i ) ) );
+	}
+	addMultipliedByGainsScalar<Sanitize>( dst + vectorFrames, src + vectorFrames,
+						gains + vectorFrames, frames - vectorFrames );
+}
+
+static void addMultipliedStereoNeon( sampleFrame* dst, const sampleFrame* src,
+						float coeffLeft, float coeffRight, int frames )
+{
+	float * d = samples( dst );
+	const float * s = samples( src );
+	const float coeffs[4] = { coeffLeft, coeffRight, coeffLeft, coeffRight };
+	const float32x4_t c = vld1q_f32( coeffs );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const float32x4_t in = vld1q_f32( s + i );
+		accumulateNeon<false>( d + i, in, vmulq_f32( in, c ) );
+	}
+	addMultipliedStereoScalar( dst + vectorFrames, src + vectorFrames,
+						coeffLeft, coeffRight, frames - vectorFrames );
+}
+
+static bool isSilentNeon( const sampleFrame* src, int frames )
+{
+	const float * s = samples( src );
+	const float32x4_t threshold = vdupq_n_f32( SilenceThreshold );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		if( vmaxvq_u32( vcgeq_f32( vabsq_f32( vld1q_f32( s + i ) ), threshold ) ) )
+		{
+			return false;
+		}
+	}
+	return isSilentScalar( src + vectorFrames, frames - vectorFrames );
+}
+
+static bool sanitizeNeon( sampleFrame* src, int frames )
+{
+	float * s = samples( src );
+	const float32x4_t lower = vdupq_n_f32( -SanitizeLimit );
+	const float32x4_t upper = vdupq_n_f32( SanitizeLimit );
+	uint32x4_t bad = vdupq_n_u32( 0 );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const float32x4_t in = vld1q_f32( s + i );
+		bad = vorrq_u32( bad, nonFiniteNeon( in ) );
+		vst1q_f32( s + i, vmaxq_f32( vminq_f32( in, upper ), lower ) );
+	}
+	const bool tailGood = clampScalar( src + vectorFrames, frames - vectorFrames );
+	if( vmaxvq_u32( bad ) || !tailGood )
+	{
+		memset( src, 0, sizeof( sampleFrame ) * frames );
+		return true;
+	}
+	return false;
+}
+
+static bool peakValuesNeon( const sampleFrame* src, int frames, float* peaks )
+{
+	const float * s = samples( src );
+	const float32x4_t maxFinite = vdupq_n_f32( MaxFinite );
+	float32x4_t peak = vdupq_n_f32( 0.0f );
+	uint32x4_t bad = vdupq_n_u32( 0 );
+	const int vectorFrames = frames & ~1;
+	for( int i = 0; i < vectorFrames * 2; i += 4 )
+	{
+		const float32x4_t level = vabsq_f32( vld1q_f32( s + i ) );
+		// unlike vmaxq, vmaxnmq ignores nans
+		peak = vmaxnmq_f32( level, peak );
+		bad = vorrq_u32( bad, vmvnq_u32( vcleq_f32( level, maxFinite ) ) );
+	}
+	const float32x2_t folded = vmax_f32( vget_low_f32( peak ), vget_high_f32( peak ) );
+	peaks[0] = vget_lane_f32( folded, 0 );
+	peaks[1] = vget_lane_f32( folded, 1 );
+	const bool tailBad = raisePeaksScalar( src + vectorFrames, frames - vectorFrames, peaks );
+	return vmaxvq_u32( bad ) || tailBad;
+}
+
+#endif
+
+
+
+
+struct Kernels
+{
+	SimdLevel level;
+	void (*add)( sampleFrame*, const sampleFrame*, int );
+	void (*addMultiplied)( sampleFrame*, const sampleFrame*, float, int );
+	void (*addSanitizedMultiplied)( sampleFrame*, const sampleFrame*, float, int );
+	void (*addMultipliedByBuffers)( sampleFrame*, const sampleFrame*, const float*, const float*, int );
+	void (*addSanitizedMultipliedByBuffers)( sampleFrame*, const sampleFrame*, const float*, const float*, int );
+	void (*addMultipliedByGains)( sampleFrame*, const sampleFrame*, const sampleFrame*, int );
+	void (*addSanitizedMultipliedByGains)( sampleFrame*, const sampleFrame*, const sampleFrame*, int );
+	void (*addMultipliedStereo)( sampleFrame*, const sampleFrame*, float, float, int );
+	bool (*isSilent)( const sampleFrame*, int );
+	bool (*sanitize)( sampleFrame*, int );
+	bool (*peakValues)( const sampleFrame*, int, float* );
 } ;
 
 
+#define MIXHELPERS_KERNELS( level, suffix ) \
+	{ level, add##suffix, addMultiplied##suffix<false>, addMultiplied##suffix<true>, \
+		addMultipliedByBuffers##suffix<false>, addMultipliedByBuffers##suffix<true>, \
+		addMultipliedByGains##suffix<false>, addMultipliedByGains##suffix<true>, \
+		addMultipliedStereo##suffix, \
+		isSilent##suffix, sanitize##suffix, peakValues##suffix }
+
+static const Kernels s_allKernels[] =
+{
+	MIXHELPERS_KERNELS( SimdLevel::Scalar, Scalar ),
+#ifdef MIXHELPERS_X86
+	MIXHELPERS_KERNELS( SimdLevel::SSE2, Sse2 ),
+#endif
+#ifdef MIXHELPERS_AVX
+	MIXHELPERS_KERNELS( SimdLevel::AVX2, Avx2 ),
+	MIXHELPERS_KERNELS( SimdLevel::AVX512, Avx512 ),
+#endif
+#ifdef MIXHELPERS_NEON
+	MIXHELPERS_KERNELS( SimdLevel::NEON, Neon ),
+#endif
+} ;
+
+#undef MIXHELPERS_KERNELS
+
+
+static bool cpuSupports( SimdLevel level )
+{
+	switch( level )
+	{
+		case SimdLevel::Scalar:
+			return true;
+#if defined(MIXHELPERS_AVX)
+		case SimdLevel::SSE2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "sse2" );
+		case SimdLevel::AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "avx2" );
+		case SimdLevel::AVX512:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "avx512f" );
+#elif defined(MIXHELPERS_X86)
+		case SimdLevel::SSE2:
+			return true;
+#endif
+#ifdef MIXHELPERS_NEON
+		case SimdLevel::NEON:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+
+static const Kernels * findKernels( SimdLevel level )
+{
+	for( const Kernels & kernels : s_allKernels )
+	{
+		if( kernels.level == level )
+		{
+			return cpuSupports( level ) ? &kernels : nullptr;
+		}
+	}
+	return nullptr;
+}
+
+
+static const Kernels * bestKernels()
+{
+	// s_allKernels is ordered from slowest to fastest
+	const Kernels * best = &s_allKernels[0];
+	for( const Kernels & kernels : s_allKernels )
+	{
+		if( cpuSupports( kernels.level ) )
+		{
+			best = &kernels;
+		}
+	}
+	return best;
+}
+
+
+static const Kernels * s_kernels = bestKernels();
+
+
+
+SimdLevel simdLevel()
+{
+	return s_kernels->level;
+}
+
+bool isSimdLevelSupported( SimdLevel level )
+{
+	return findKernels( level ) != nullptr;
+}
+
+bool setSimdLevel( SimdLevel level )
+{
+	const Kernels * kernels = findKernels( level );
+	if( kernels == nullptr )
+	{
+		return false;
+	}
+	s_kernels = kernels;
+	return true;
+}
+
+const char * simdLevelName( SimdLevel level )
+{
+	switch( level )
+	{
+		case SimdLevel::Scalar: return "Scalar";
+		case SimdLevel::SSE2: return "SSE2";
+		case SimdLevel::AVX2: return "AVX2";
+		case SimdLevel::AVX512: return "AVX-512";
+		case SimdLevel::NEON: return "NEON";
+	}
+	return "unknown";
+}
+
+
+
+bool isSilent( const sampleFrame* src, int frames )
+{
+	return s_kernels->isSilent( src, frames );
+}
+
+bool peakValues( const sampleFrame* src, int frames, float & peakLeft, float & peakRight )
+{
+	float peaks[DEFAULT_CHANNELS];
+	const bool bad = s_kernels->peakValues( src, frames, peaks );
+	peakLeft = peaks[0];
+	peakRight = peaks[1];
+	return bad;
+}
+
+bool useNaNHandler()
+{
+	return s_NaNHandler;
+}
+
+void setNaNHandler( bool use )
+{
+	s_NaNHandler = use;
+}
+
+/*! \brief Function for sanitizing a buffer of infs/nans - returns true if those are found */
+bool sanitize( sampleFrame * src, int frames )
+{
+	if( !useNaNHandler() )
+	{
+		return false;
+	}
+
+	if( s_kernels->sanitize( src, frames ) )
+	{
+		#ifdef LMMS_DEBUG
+			printf("Bad data, cleared buffer of %d frames\n", frames);
+		#endif
+		return true;
+	}
+	return false;
+}
+
+
+void add( sampleFrame* dst, const sampleFrame* src, int frames )
+{
+	s_kernels->add( dst, src, frames );
+}
+
+
+
 void addMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
-	run<>( dst, src, frames, AddMultipliedOp(coeffSrc) );
+	s_kernels->addMultiplied( dst, src, coeffSrc, frames );
 }
 
 
@@ -191,12 +1163,7 @@ void addMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coef
 
 void addMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src, ValueBuffer * coeffSrcBuf1, ValueBuffer * coeffSrcBuf2, int frames )
 {
-	for( int f = 0; f < frames; ++f )
-	{
-		dst[f][0] += src[f][0] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
-		dst[f][1] += src[f][1] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
-	}
-
+	s_kernels->addMultipliedByBuffers( dst, src, coeffSrcBuf1->values(), coeffSrcBuf2->values(), frames );
 }
 
 void addSanitizedMultipliedByBuffer( sampleFrame* dst, const sampleFrame* src, float coeffSrc, ValueBuffer * coeffSrcBuf, int frames )
@@ -224,32 +1191,10 @@ void addSanitizedMultipliedByBuffers( sampleFrame* dst, const sampleFrame* src,
 		return;
 	}
 
-	for( int f = 0; f < frames; ++f )
-	{
-		dst[f][0] += ( isinf( src[f][0] ) || isnan( src[f][0] ) )
-			? 0.0f
-			: src[f][0] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
-		dst[f][1] += ( isinf( src[f][1] ) || isnan( src[f][1] ) )
-			? 0.0f
-			: src[f][1] * coeffSrcBuf1->values()[f] * coeffSrcBuf2->values()[f];
-	}
-
+	s_kernels->addSanitizedMultipliedByBuffers( dst, src, coeffSrcBuf1->values(), coeffSrcBuf2->values(), frames );
 }
 
 
-struct AddSanitizedMultipliedOp
-{
-	AddSanitizedMultipliedOp( float coeff ) : m_coeff( coeff ) { }
-
-	void operator()( sampleFrame& dst, const sampleFrame& src ) const
-	{
-		dst[0] += ( isinf( src[0] ) || isnan( src[0] ) ) ? 0.0f : src[0] * m_coeff;
-		dst[1] += ( isinf( src[1] ) || isnan( src[1] ) ) ? 0.0f : src[1] * m_coeff;
-	}
-
-	const float m_coeff;
-};
-
 void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coeffSrc, int frames )
 {
 	if ( !useNaNHandler() )
@@ -258,33 +1203,31 @@ void addSanitizedMultiplied( sampleFrame* dst, const sampleFrame* src, float coe
 		return;
 	}
 
-	run<>( dst, src, frames, AddSanitizedMultipliedOp(coeffSrc) );
+	s_kernels->addSanitizedMultiplied( dst, src, coeffSrc, frames );
 }
 
 
 
-struct AddMultipliedStereoOp
+void addMultipliedByGains( sampleFrame* dst, const sampleFrame* src, const sampleFrame* gains, int frames )
 {
-	AddMultipliedStereoOp( float coeffLeft, float coeffRight )
-	{
-		m_coeffs[0] = coeffLeft;
-		m_coeffs[1] = coeffRight;
-	}
+	s_kernels->addMultipliedByGains( dst, src, gains, frames );
+}
 
-	void operator()( sampleFrame& dst, const sampleFrame& src ) const
+void addSanitizedMultipliedByGains( sampleFrame* dst, const sampleFrame* src, const sampleFrame* gains, int frames )
+{
+	if ( !useNaNHandler() )
 	{
-		dst[0] += src[0] * m_coeffs[0];
-		dst[1] += src[1] * m_coeffs[1];
+		addMultipliedByGains( dst, src, gains, frames );
+		return;
 	}
 
-	float m_coeffs[2];
-} ;
+	s_kernels->addSanitizedMultipliedByGains( dst, src, gains, frames );
+}
 
 
 void addMultipliedStereo( sampleFrame* dst, const sampleFrame* src, float coeffSrcLeft, float coeffSrcRight, int frames )
 {
-
-	run<>( dst, src, frames, AddMultipliedStereoOp(coeffSrcLeft, coeffSrcRight) );
+	s_kernels->addMultipliedStereo( dst, src, coeffSrcLeft, coeffSrcRight, frames );
 }
 
 
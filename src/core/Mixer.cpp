@@ -24,6 +24,8 @@
 
 #include "Mixer.h"
 
+#include <algorithm>
+
 #include "denormals.h"
 
 #include "lmmsconfig.h"
@@ -31,8 +33,11 @@
 #include "AudioPort.h"
 #include "FxMixer.h"
 #include "MixerWorkerThread.h"
+#include "MixHelpers.h"
 #include "Song.h"
 #include "EnvelopeAndLfoParameters.h"
+#include "InstrumentTrack.h"
+#include "NoteBatch.h"
 #include "NotePlayHandle.h"
 #include "ConfigManager.h"
 #include "SamplePlayHandle.h"
@@ -66,6 +71,9 @@ typedef LocklessList<PlayHandle *>::Element LocklessListElement;
 
 static thread_local bool s_renderingThread;
 
+// share of the deadline the last period may take before voices get culled
+static const float NearDeadline = 0.9f;
+
 
 
 
@@ -86,6 +94,7 @@ Mixer::Mixer( bool renderOnly ) :
 	m_oldAudioDev( NULL ),
 	m_audioDevStartFailed( false ),
 	m_profiler(),
+	m_voiceBudget( ConfigManager::inst()->value( "mixer", "voicebudget" ).toInt() ),
 	m_metronomeActive(false),
 	m_clearSignal( false ),
 	m_changesSignal( false ),
@@ -146,14 +155,21 @@ Mixer::Mixer( bool renderOnly ) :
 		m_bufferPool.push_back( m_readBuf );
 	}
 
+	// create all workers before starting any, as every worker registers
+	// a deque the others will steal jobs from
 	for( int i = 0; i < m_numWorkers+1; ++i )
 	{
-		MixerWorkerThread * wt = new MixerWorkerThread( this );
-		if( i < m_numWorkers )
-		{
-			wt->start( QThread::TimeCriticalPriority );
-		}
-		m_workers.push_back( wt );
+		m_workers.push_back( new MixerWorkerThread( this ) );
+	}
+	m_profiler.setWorkerCount( m_numWorkers + 1 );
+	MixerWorkerThread::setProfiler( &m_profiler );
+	MixerWorkerThread::startDequeGrower();
+
+	m_noteBatches.reserve( PlayHandle::MaxNumber );
+	m_voices.reserve( PlayHandle::MaxNumber );
+	for( int i = 0; i < m_numWorkers; ++i )
+	{
+		m_workers[i]->start( QThread::TimeCriticalPriority );
 	}
 
 	m_poolDepth = 2;
@@ -179,11 +195,9 @@ Mixer::~Mixer()
 	{
 		m_workers[w]->wait( 500 );
 	}
+	MixerWorkerThread::stopDequeGrower();
+	MixerWorkerThread::setProfiler( nullptr );
 
-	while( m_fifo->available() )
-	{
-		delete[] m_fifo->read();
-	}
 	delete m_fifo;
 
 	delete m_midiClient;
@@ -424,6 +438,7 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 	fxMixer->prepareMasterMix();
 
 	// create play-handles for new notes, samples etc.
+	MicroTimer detailTimer;
 	song->processNextBuffer();
 
 	// add all play-handles that have to be added
@@ -434,9 +449,55 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 		m_newPlayHandles.free( e );
 		e = next;
 	}
+	stealVoices();
+	m_profiler.addDetailTime( MixerProfiler::DetailType::NoteSetup, detailTimer.elapsed() * int64_t( 1000 ) );
 
-	// STAGE 1: run and render all play handles
-	MixerWorkerThread::fillJobQueue<PlayHandleList>( m_playHandles );
+	// Render all play handles, process the effects of all instrument- and
+	// sampletracks and process the FX mixer channels as one job graph:
+	// an audio port is queued once all its play handles are rendered,
+	// an FX channel once all ports and channels sending to it are done.
+	// This way a slow track doesn't hold up processing of any other.
+	MixerWorkerThread::resetJobQueue( MixerWorkerThread::JobQueue::Dynamic );
+	fxMixer->prepareJobs();
+	for( AudioPort * port : m_audioPorts )
+	{
+		port->resetDependencies();
+		fxMixer->addInputPort( port );
+	}
+	for( PlayHandle * handle : m_playHandles )
+	{
+		AudioPort * port = handle->audioPort();
+		NoteBatch * batch = handle->type() == PlayHandle::TypeNotePlayHandle ?
+			static_cast<NotePlayHandle *>( handle )->instrumentTrack()->noteBatch() : nullptr;
+		if( batch )
+		{
+			// rendered in one job with the other notes of its track
+			if( handle->requiresProcessing() &&
+				batch->addNote( static_cast<NotePlayHandle *>( handle ) ) )
+			{
+				port->addDependency();
+				m_noteBatches.push_back( batch );
+			}
+			continue;
+		}
+		port->addDependency();
+		if( !MixerWorkerThread::addJob( handle ) )
+		{
+			// handle is finished, don't wait for it
+			port->dependencyMet();
+		}
+	}
+	for( NoteBatch * batch : m_noteBatches )
+	{
+		MixerWorkerThread::addJob( batch );
+	}
+	m_noteBatches.clear();
+	// all play handles are queued, release the dependency we held
+	for( AudioPort * port : m_audioPorts )
+	{
+		port->dependencyMet();
+	}
+	fxMixer->queueJobs();
 	MixerWorkerThread::startAndWaitForJobs();
 
 	// removed all play handles which are done
@@ -465,13 +526,10 @@ const surroundSampleFrame * Mixer::renderNextBuffer()
 		}
 	}
 
-	// STAGE 2: process effects of all instrument- and sampletracks
-	MixerWorkerThread::fillJobQueue<QVector<AudioPort *> >( m_audioPorts );
-	MixerWorkerThread::startAndWaitForJobs();
-
-
-	// STAGE 3: do master mix in FX mixer
+	// do master mix in FX mixer
+	detailTimer.reset();
 	fxMixer->masterMix( m_writeBuf );
+	m_profiler.addDetailTime( MixerProfiler::DetailType::Mixing, detailTimer.elapsed() * int64_t( 1000 ) );
 
 
 	emit nextAudioBuffer( m_readBuf );
@@ -515,6 +573,77 @@ void Mixer::clearNewPlayHandles()
 
 
 
+// lets the tracks fade out the voices beyond their polyphony limit and culls
+// the least audible voices when the last period came close to the deadline
+void Mixer::stealVoices()
+{
+	const bool nearDeadline = m_voiceBudget > 0 &&
+		m_profiler.lastPeriodTime() > m_profiler.periodDeadline() * NearDeadline;
+
+	for( PlayHandle * handle : m_playHandles )
+	{
+		if( handle->type() == PlayHandle::TypeNotePlayHandle )
+		{
+			NotePlayHandle * n = static_cast<NotePlayHandle *>( handle );
+			// master notes of chords and arpeggios don't render anything,
+			// only the budget cares about tracks not limiting polyphony
+			if( !n->isMasterNote() && !n->isFadingOut() && !n->isFinished() &&
+				( nearDeadline || n->instrumentTrack()->limitVoicesModel()->value() ) )
+			{
+				m_voices.push_back( n );
+			}
+		}
+	}
+	if( m_voices.empty() )
+	{
+		return;
+	}
+
+	// let every track limit its polyphony
+	std::sort( m_voices.begin(), m_voices.end(),
+		[]( NotePlayHandle * a, NotePlayHandle * b )
+		{
+			return a->instrumentTrack() < b->instrumentTrack();
+		} );
+	for( auto first = m_voices.begin(); first != m_voices.end(); )
+	{
+		InstrumentTrack * track = ( *first )->instrumentTrack();
+		auto last = first;
+		while( last != m_voices.end() && ( *last )->instrumentTrack() == track )
+		{
+			++last;
+		}
+		track->stealVoices( &*first, static_cast<int>( last - first ) );
+		first = last;
+	}
+
+	// if the last period barely made it, fade out the least audible voices
+	// beyond the budget to catch up before we miss the deadline
+	if( nearDeadline )
+	{
+		m_voices.erase( std::remove_if( m_voices.begin(), m_voices.end(),
+			[]( const NotePlayHandle * n ) { return n->isFadingOut(); } ), m_voices.end() );
+		if( static_cast<int>( m_voices.size() ) > m_voiceBudget )
+		{
+			const auto excess = m_voices.begin() + ( m_voices.size() - m_voiceBudget );
+			std::nth_element( m_voices.begin(), excess, m_voices.end(),
+				[]( const NotePlayHandle * a, const NotePlayHandle * b )
+				{
+					return a->lastPeak() < b->lastPeak();
+				} );
+			for( auto it = m_voices.begin(); it != excess; ++it )
+			{
+				( *it )->fadeOut();
+			}
+		}
+	}
+
+	m_voices.clear();
+}
+
+
+
+
 // removes all play-handles. this is necessary, when the song is stopped ->
 // all remaining notes etc. would be played until their end
 void Mixer::clearInternal()
@@ -536,23 +665,9 @@ void Mixer::clearInternal()
 
 Mixer::StereoSample Mixer::getPeakValues(sampleFrame * _ab, const f_cnt_t _frames) const
 {
-	sample_t peakLeft = 0.0f;
-	sample_t peakRight = 0.0f;
-
-	for( f_cnt_t f = 0; f < _frames; ++f )
-	{
-		float const absLeft = qAbs( _ab[f][0] );
-		float const absRight = qAbs( _ab[f][1] );
-		if (absLeft > peakLeft)
-		{
-			peakLeft = absLeft;
-		}
-
-		if (absRight > peakRight)
-		{
-			peakRight = absRight;
-		}
-	}
+	sample_t peakLeft;
+	sample_t peakRight;
+	MixHelpers::peakValues( _ab, _frames, peakLeft, peakRight );
 
 	return StereoSample(peakLeft, peakRight);
 }
@@ -1221,9 +1336,29 @@ MidiClient * Mixer::tryMidiClients()
 Mixer::fifoWriter::fifoWriter( Mixer* mixer, fifo * _fifo ) :
 	m_mixer( mixer ),
 	m_fifo( _fifo ),
-	m_writing( true )
+	m_writing( true ),
+	m_nextBuffer( 0 )
 {
 	setObjectName("Mixer::fifoWriter");
+
+	// besides the buffers in the FIFO, the reader may still be copying
+	// the one it took last while we fill the next one - allocating them
+	// all up front keeps the audio thread free of allocations
+	for( int i = 0; i < m_fifo->size() + 2; ++i )
+	{
+		m_buffers.push_back( new surroundSampleFrame[m_mixer->framesPerPeriod()] );
+	}
+}
+
+
+
+
+Mixer::fifoWriter::~fifoWriter()
+{
+	for( surroundSampleFrame * buffer : m_buffers )
+	{
+		delete[] buffer;
+	}
 }
 
 
@@ -1255,7 +1390,10 @@ void Mixer::fifoWriter::run()
 	const fpp_t frames = m_mixer->framesPerPeriod();
 	while( m_writing )
 	{
-		surroundSampleFrame * buffer = new surroundSampleFrame[frames];
+		// the reader takes buffers in the order we write them, so the
+		// oldest one is free again
+		surroundSampleFrame * buffer = m_buffers[m_nextBuffer];
+		m_nextBuffer = ( m_nextBuffer + 1 ) % m_buffers.size();
 		const surroundSampleFrame * b = m_mixer->renderNextBuffer();
 		memcpy( buffer, b, frames * sizeof( surroundSampleFrame ) );
 		write( buffer );
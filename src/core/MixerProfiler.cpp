@@ -28,14 +28,46 @@
 MixerProfiler::MixerProfiler() :
 	m_periodTimer(),
 	m_cpuLoad( 0 ),
-	m_outputFile()
+	m_outputFile(),
+	m_periods( 0 ),
+	m_deadlineMisses( 0 ),
+	m_lastPeriodTime( 0 ),
+	m_maxPeriodTime( 0 ),
+	m_periodDeadline( 0 ),
+	m_totalPeriodTime( 0 ),
+	m_workerCount( 0 )
 {
+	for( std::atomic<int64_t> & count : m_histogram )
+	{
+		count = 0;
+	}
+	for( int i = 0; i < static_cast<int>( DetailType::Count ); ++i )
+	{
+		m_currentDetailTime[i] = 0;
+		m_lastDetailTime[i] = 0;
+	}
 }
 
 
 
 MixerProfiler::~MixerProfiler()
 {
+	if( m_outputFile.isOpen() )
+	{
+		writeSummary();
+	}
+}
+
+
+
+void MixerProfiler::setWorkerCount( int workers )
+{
+	m_workerBusyTime.reset( new std::atomic<int64_t>[workers] );
+	for( int i = 0; i < workers; ++i )
+	{
+		m_workerBusyTime[i] = 0;
+	}
+	m_workerCount = workers;
 }
 
 
@@ -46,18 +78,105 @@ void MixerProfiler::finishPeriod( sample_rate_t sampleRate, fpp_t framesPerPerio
 	const float newCpuLoad = periodElapsed / 10000.0f * sampleRate / framesPerPeriod;
     m_cpuLoad = qBound<int>( 0, ( newCpuLoad * 0.1f + m_cpuLoad * 0.9f ), 100 );
 
+	const int deadline = static_cast<int>( framesPerPeriod * 1000000.0f / sampleRate );
+	const int bin = periodElapsed * 100 / qMax( deadline, 1 ) / HistogramBinWidth;
+	m_histogram[qMin( bin, HistogramBins - 1 )].fetch_add( 1, std::memory_order_relaxed );
+	if( periodElapsed > deadline )
+	{
+		m_deadlineMisses.fetch_add( 1, std::memory_order_relaxed );
+	}
+	m_lastPeriodTime.store( periodElapsed, std::memory_order_relaxed );
+	if( periodElapsed > m_maxPeriodTime.load( std::memory_order_relaxed ) )
+	{
+		m_maxPeriodTime.store( periodElapsed, std::memory_order_relaxed );
+	}
+	m_periodDeadline.store( deadline, std::memory_order_relaxed );
+	m_totalPeriodTime.fetch_add( periodElapsed * int64_t( 1000 ), std::memory_order_relaxed );
+	m_periods.fetch_add( 1, std::memory_order_relaxed );
+
+	// all jobs of the period are done, so nobody adds to the current
+	// detail times anymore
+	for( int i = 0; i < static_cast<int>( DetailType::Count ); ++i )
+	{
+		m_lastDetailTime[i].store( static_cast<int>( m_currentDetailTime[i].exchange( 0,
+					std::memory_order_relaxed ) / 1000 ), std::memory_order_relaxed );
+	}
+
 	if( m_outputFile.isOpen() )
 	{
-		m_outputFile.write( QString( "%1\n" ).arg( periodElapsed ).toLatin1() );
+		m_outputFile.write( QString( "%1,%2,%3,%4,%5,%6\n" )
+			.arg( periodElapsed )
+			.arg( deadline )
+			.arg( detailTime( DetailType::NoteSetup ) )
+			.arg( detailTime( DetailType::Instruments ) )
+			.arg( detailTime( DetailType::Effects ) )
+			.arg( detailTime( DetailType::Mixing ) ).toLatin1() );
 	}
 }
 
 
 
+const char * MixerProfiler::detailName( DetailType type )
+{
+	switch( type )
+	{
+		case DetailType::NoteSetup: return QT_TRANSLATE_NOOP( "MixerProfiler", "note setup" );
+		case DetailType::Instruments: return QT_TRANSLATE_NOOP( "MixerProfiler", "instruments" );
+		case DetailType::Effects: return QT_TRANSLATE_NOOP( "MixerProfiler", "effects" );
+		case DetailType::Mixing: return QT_TRANSLATE_NOOP( "MixerProfiler", "mixing" );
+		case DetailType::Count: break;
+	}
+	return "unknown";
+}
+
+
+
 void MixerProfiler::setOutputFile( const QString& outputFile )
 {
+	if( m_outputFile.isOpen() )
+	{
+		writeSummary();
+	}
 	m_outputFile.close();
 	m_outputFile.setFileName( outputFile );
 	m_outputFile.open( QFile::WriteOnly | QFile::Truncate );
+	// one line per period: render time and deadline followed by the
+	// processing time of each detail, all in microseconds
+	m_outputFile.write( "# elapsed,deadline,note setup,instruments,effects,mixing\n" );
+}
+
+
+
+void MixerProfiler::writeCpuUsage( const QString& name, const CpuUsage& usage )
+{
+	if( m_outputFile.isOpen() )
+	{
+		m_outputFile.write( QString( "# cpu %1: average %2 us, peak %3 us, total %4 us\n" )
+				.arg( name )
+				.arg( usage.average(), 0, 'f', 1 )
+				.arg( usage.peak(), 0, 'f', 1 )
+				.arg( usage.total() ).toUtf8() );
+	}
 }
 
+
+
+
+void MixerProfiler::writeSummary()
+{
+	QString summary = QString( "# periods: %1, deadline misses: %2, longest period: %3 us\n" )
+				.arg( periods() ).arg( deadlineMisses() ).arg( maxPeriodTime() );
+	for( int bin = 0; bin < HistogramBins; ++bin )
+	{
+		summary += QString( "# %1%2% of deadline: %3\n" )
+				.arg( bin == HistogramBins - 1 ? ">= " : "< " )
+				.arg( bin == HistogramBins - 1 ? bin * HistogramBinWidth : ( bin + 1 ) * HistogramBinWidth )
+				.arg( histogramCount( bin ) );
+	}
+	for( int worker = 0; worker < m_workerCount; ++worker )
+	{
+		summary += QString( "# worker %1: busy %2 us, idle %3 us\n" )
+				.arg( worker ).arg( workerBusyTime( worker ) ).arg( workerIdleTime( worker ) );
+	}
+	m_outputFile.write( summary.toLatin1() );
+}
@@ -24,9 +24,7 @@
 
 #include "MixerWorkerThread.h"
 
-#include <QDebug>
-#include <QMutex>
-#include <QWaitCondition>
+#include <chrono>
 
 #include "denormals.h"
 #include "ThreadableJob.h"
@@ -37,13 +35,163 @@
 #endif
 
 MixerWorkerThread::JobQueue MixerWorkerThread::globalJobQueue;
-QWaitCondition * MixerWorkerThread::queueReadyWaitCond = NULL;
 QList<MixerWorkerThread *> MixerWorkerThread::workerThreads;
 
+// slot of the deque owned by the current thread, threads which are no
+// worker thread (i.e. the one rendering the period) use slot 0
+static thread_local int s_slot = 0;
+
+// how often to retry finding a job before parking
+static const int SpinCount = 256;
+
+// initial capacity of each deque, they grow as needed
+static const int InitialDequeSize = 1024;
+
+// room the grower prepares in every deque, relative to the peak depth
+static const int DequeHeadroom = 2;
+
+
+static inline void cpuRelax()
+{
+#if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
+	_mm_pause();
+#endif
+}
+
+
+
+
+// prepares room in all deques from outside of the render path whenever
+// more jobs piled up in a deque than they have room for with headroom
+class MixerWorkerThread::JobQueue::Grower : public QThread
+{
+public:
+	Grower( JobQueue * queue ) :
+		m_queue( queue ),
+		m_quit( false )
+	{
+	}
+
+	void stop()
+	{
+		m_quit = true;
+		m_queue->m_depthRaised.notify();
+	}
+
+private:
+	void run() override
+	{
+		MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
+		while( true )
+		{
+			const unsigned int key = m_queue->m_depthRaised.prepareWait();
+			const int depth = m_queue->m_peakDepth;
+			if( m_quit )
+			{
+				m_queue->m_depthRaised.cancelWait();
+				return;
+			}
+			if( depth > m_queue->m_reservedDepth )
+			{
+				m_queue->m_depthRaised.cancelWait();
+				for( Deque * deque : m_queue->m_deques )
+				{
+					deque->reserve( depth * DequeHeadroom );
+				}
+				m_queue->m_reservedDepth = depth;
+			}
+			else
+			{
+				m_queue->m_depthRaised.commitWait( key );
+			}
+		}
+	}
+
+	JobQueue * m_queue;
+	std::atomic_bool m_quit;
+} ;
+
+
+
+
 // implementation of internal JobQueue
+MixerWorkerThread::JobQueue::JobQueue() :
+	m_deques(),
+	m_itemsQueued( 0 ),
+	m_itemsTaken( 0 ),
+	m_itemsDone( 0 ),
+	m_peakDepth( 0 ),
+	m_reservedDepth( InitialDequeSize / DequeHeadroom ),
+	m_opMode( Static ),
+	m_profiler( nullptr ),
+	m_grower( nullptr )
+{
+}
+
+
+
+
+MixerWorkerThread::JobQueue::~JobQueue()
+{
+	stopGrower();
+	qDeleteAll( m_deques );
+}
+
+
+
+
+void MixerWorkerThread::JobQueue::startGrower()
+{
+	if( m_grower == nullptr )
+	{
+		m_grower = new Grower( this );
+		m_grower->start( QThread::LowPriority );
+	}
+}
+
+
+
+
+void MixerWorkerThread::JobQueue::stopGrower()
+{
+	if( m_grower )
+	{
+		m_grower->stop();
+		m_grower->wait();
+		delete m_grower;
+		m_grower = nullptr;
+	}
+}
+
+
+
+
+int MixerWorkerThread::JobQueue::addSlot()
+{
+	// new deques get as much room as the existing ones
+	int capacity = InitialDequeSize;
+	while( capacity < m_reservedDepth * DequeHeadroom )
+	{
+		capacity *= 2;
+	}
+	// deques use the MemoryManager which is not available during static
+	// initialization, so the rendering thread's deque is created along
+	// with the first worker
+	if( m_deques.empty() )
+	{
+		m_deques.push_back( new Deque( capacity ) );
+	}
+	m_deques.push_back( new Deque( capacity ) );
+	return static_cast<int>( m_deques.size() ) - 1;
+}
+
+
+
+
 void MixerWorkerThread::JobQueue::reset( OperationMode _opMode )
 {
-	m_writeIndex = 0;
+	m_itemsQueued = 0;
+	m_itemsTaken = 0;
 	m_itemsDone = 0;
 	m_opMode = _opMode;
 }
@@ -51,43 +199,104 @@ void MixerWorkerThread::JobQueue::reset( OperationMode _opMode )
 
 
 
-void MixerWorkerThread::JobQueue::addJob( ThreadableJob * _job )
+bool MixerWorkerThread::JobQueue::addJob( ThreadableJob * _job )
 {
 	if( _job->requiresProcessing() )
 	{
 		// update job state
 		_job->queue();
-		// actually queue the job via atomic operations
-		auto index = m_writeIndex++;
-		if (index < JOB_QUEUE_SIZE) {
-			m_items[index] = _job;
-		} else {
-			qWarning() << "Job queue is full!";
-			++m_itemsDone;
+		// count the job before publishing it, so m_itemsDone can't catch
+		// up with m_itemsQueued while the job adding this one is running
+		++m_itemsQueued;
+		// push to the deque of the calling thread, others will steal it
+		Deque * deque = m_deques[s_slot];
+		deque->push( _job );
+		// track how many jobs pile up at once and let the grower make
+		// room before the deques fill up
+		const int depth = static_cast<int>( deque->size() );
+		int peak = m_peakDepth.load( std::memory_order_relaxed );
+		while( depth > peak && !m_peakDepth.compare_exchange_weak( peak, depth,
+									std::memory_order_relaxed ) )
+		{
+		}
+		if( depth > peak && depth > m_reservedDepth.load( std::memory_order_relaxed ) )
+		{
+			m_depthRaised.notify();
 		}
+		// in static mode workers are woken up once all jobs are queued
+		if( m_opMode == Dynamic )
+		{
+			m_jobsAvailable.notify();
+		}
+		return true;
 	}
+	return false;
 }
 
 
 
+
+ThreadableJob * MixerWorkerThread::JobQueue::takeJob()
+{
+	ThreadableJob * job = m_deques[s_slot]->pop();
+	if( job == nullptr )
+	{
+		// start with our neighbour so thieves don't all hit the same deque
+		const int slots = static_cast<int>( m_deques.size() );
+		for( int i = 1; i < slots && job == nullptr; ++i )
+		{
+			job = m_deques[( s_slot + i ) % slots]->steal();
+		}
+	}
+	if( job )
+	{
+		++m_itemsTaken;
+	}
+	return job;
+}
+
+
+
+
 void MixerWorkerThread::JobQueue::run()
 {
-	bool processedJob = true;
-	while (processedJob && m_itemsDone < m_writeIndex)
+	int spins = 0;
+	while( hasPendingJobs() || spins < SpinCount )
 	{
-		processedJob = false;
-		for( int i = 0; i < m_writeIndex && i < JOB_QUEUE_SIZE; ++i )
+		ThreadableJob * job = takeJob();
+		if( job )
 		{
-			ThreadableJob * job = m_items[i].exchange(nullptr);
-			if( job )
+			if( m_profiler )
 			{
+				typedef std::chrono::steady_clock Clock;
+				const Clock::time_point start = Clock::now();
 				job->process();
-				processedJob = true;
-				++m_itemsDone;
+				const int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+								Clock::now() - start ).count();
+				m_profiler->addJobTime( job->detailType(), s_slot, time );
+				job->addProcessingTime( time );
 			}
+			else
+			{
+				job->process();
+			}
+			if( ++m_itemsDone == m_itemsQueued )
+			{
+				m_jobsDone.notify();
+			}
+			spins = 0;
+		}
+		else
+		{
+			// either another thread won the race for the remaining jobs
+			// or jobs still being processed might add new ones
+			if( !hasPendingJobs() && m_itemsDone == m_itemsQueued )
+			{
+				return;
+			}
+			++spins;
+			cpuRelax();
 		}
-		// always exit loop if we're not in dynamic mode
-		processedJob = processedJob && ( m_opMode == Dynamic );
 	}
 }
 
@@ -96,11 +305,36 @@ void MixerWorkerThread::JobQueue::run()
 
 void MixerWorkerThread::JobQueue::wait()
 {
-	while (m_itemsDone < m_writeIndex)
+	while( m_itemsDone < m_itemsQueued )
 	{
-#if defined(LMMS_HOST_X86) || defined(LMMS_HOST_X86_64)
-		_mm_pause();
-#endif
+		// help out as long as there is something to do
+		run();
+
+		const unsigned int key = m_jobsDone.prepareWait();
+		if( m_itemsDone >= m_itemsQueued || hasPendingJobs() )
+		{
+			m_jobsDone.cancelWait();
+		}
+		else
+		{
+			m_jobsDone.commitWait( key );
+		}
+	}
+}
+
+
+
+
+void MixerWorkerThread::JobQueue::waitForJobs()
+{
+	const unsigned int key = m_jobsAvailable.prepareWait();
+	if( hasPendingJobs() )
+	{
+		m_jobsAvailable.cancelWait();
+	}
+	else
+	{
+		m_jobsAvailable.commitWait( key );
 	}
 }
 
@@ -112,14 +346,9 @@ void MixerWorkerThread::JobQueue::wait()
 
 MixerWorkerThread::MixerWorkerThread( Mixer* mixer ) :
 	QThread( mixer ),
+	m_slot( globalJobQueue.addSlot() ),
 	m_quit( false )
 {
-	// initialize global static data
-	if( queueReadyWaitCond == NULL )
-	{
-		queueReadyWaitCond = new QWaitCondition;
-	}
-
 	// keep track of all instantiated worker threads - this is used for
 	// processing the last worker thread "inline", see comments in
 	// MixerWorkerThread::startAndWaitForJobs() for details
@@ -143,6 +372,7 @@ void MixerWorkerThread::quit()
 {
 	m_quit = true;
 	resetJobQueue();
+	globalJobQueue.notifyWorkers();
 }
 
 
@@ -150,7 +380,7 @@ void MixerWorkerThread::quit()
 
 void MixerWorkerThread::startAndWaitForJobs()
 {
-	queueReadyWaitCond->wakeAll();
+	globalJobQueue.notifyWorkers();
 	// The last worker-thread is never started. Instead it's processed "inline"
 	// i.e. within the global Mixer thread. This way we can reduce latencies
 	// that otherwise would be caused by synchronizing with another thread.
@@ -166,13 +396,12 @@ void MixerWorkerThread::run()
 	MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
 	disable_denormals();
 
-	QMutex m;
+	s_slot = m_slot;
+
 	while( m_quit == false )
 	{
-		m.lock();
-		queueReadyWaitCond->wait( &m );
+		globalJobQueue.waitForJobs();
 		globalJobQueue.run();
-		m.unlock();
 	}
 }
 
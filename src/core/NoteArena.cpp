@@ -0,0 +1,66 @@
+/*
+ * NoteArena.cpp - contiguous storage for the notes of a pattern
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "NoteArena.h"
+
+#include <new>
+
+
+NoteArena::NoteArena() :
+	m_freeList( nullptr )
+{
+}
+
+
+
+
+Note * NoteArena::create( const Note & note )
+{
+	if( m_freeList == nullptr )
+	{
+		m_slabs.emplace_back( new Slot[SlabSize] );
+		Slot * slab = m_slabs.back().get();
+		// chain the slots backwards, so they are handed out in order
+		for( int i = SlabSize - 1; i >= 0; --i )
+		{
+			slab[i].next = m_freeList;
+			m_freeList = &slab[i];
+		}
+	}
+
+	Slot * slot = m_freeList;
+	m_freeList = slot->next;
+	return new( slot->storage ) Note( note );
+}
+
+
+
+
+void NoteArena::destroy( Note * note )
+{
+	note->~Note();
+	Slot * slot = reinterpret_cast<Slot *>( note );
+	slot->next = m_freeList;
+	m_freeList = slot;
+}
@@ -0,0 +1,112 @@
+/*
+ * NoteBatch.cpp - all notes of an instrument track rendered in one go
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "NoteBatch.h"
+
+#include "AudioPort.h"
+#include "Instrument.h"
+#include "InstrumentTrack.h"
+#include "NotePlayHandle.h"
+
+
+// voices most tracks never exceed, so the audio threads don't allocate
+static const int ReservedVoices = 256;
+
+
+NoteBatch::NoteBatch( InstrumentTrack * track ) :
+	m_track( track )
+{
+	m_notes.reserve( ReservedVoices );
+	m_playing.reserve( ReservedVoices );
+	m_voices.reserve( ReservedVoices );
+	m_buffers.reserve( ReservedVoices );
+	m_frequencies.reserve( ReservedVoices );
+	m_offsets.reserve( ReservedVoices );
+	m_frames.reserve( ReservedVoices );
+	m_framesPlayed.reserve( ReservedVoices );
+}
+
+
+
+
+void NoteBatch::addProcessingTime( int64_t nanoseconds )
+{
+	m_track->audioPort()->addInstrumentTime( nanoseconds );
+}
+
+
+
+
+void NoteBatch::doProcessing()
+{
+	m_playing.clear();
+	m_voices.clear();
+	m_buffers.clear();
+	m_frequencies.clear();
+	m_offsets.clear();
+	m_frames.clear();
+	m_framesPlayed.clear();
+
+	for( NotePlayHandle * n : m_notes )
+	{
+		n->startBuffer();
+		if( !n->startPlaying() )
+		{
+			continue;
+		}
+		m_playing.push_back( n );
+		// see NotePlayHandle::play()
+		if( n->framesLeft() > 0 && m_track->processNoteFunctions( n ) )
+		{
+			m_voices.push_back( n );
+			m_buffers.push_back( n->buffer() );
+			m_frequencies.push_back( n->frequency() );
+			m_offsets.push_back( n->noteOffset() );
+			m_frames.push_back( n->framesLeftForCurrentPeriod() );
+			m_framesPlayed.push_back( n->totalFramesPlayed() );
+		}
+		// holding the locks of all notes at once would block on notes
+		// which lock their sub-notes
+		n->unlock();
+	}
+
+	if( !m_voices.empty() )
+	{
+		m_track->instrument()->playNotes( *this );
+	}
+
+	for( NotePlayHandle * n : m_playing )
+	{
+		n->lock();
+		n->finishPlaying();
+	}
+	for( NotePlayHandle * n : m_notes )
+	{
+		n->finishBuffer();
+	}
+	m_notes.clear();
+
+	// the mixer counted the whole batch as one of the port's play handles
+	m_track->audioPort()->dependencyMet();
+}
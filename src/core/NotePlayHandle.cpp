@@ -24,8 +24,18 @@
  */
 
 #include "NotePlayHandle.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <new>
+
 #include "BasicFilters.h"
 #include "DetuningHelper.h"
+#include "EventCount.h"
 #include "InstrumentSoundShaping.h"
 #include "InstrumentTrack.h"
 #include "Instrument.h"
@@ -33,6 +43,10 @@
 #include "Song.h"
 
 
+// stolen notes fade out within 1 / FadeOutRate seconds
+static const int FadeOutRate = 100;
+
+
 NotePlayHandle::BaseDetuning::BaseDetuning( DetuningHelper *detuning ) :
 	m_value( detuning ? detuning->automationPattern()->valueAt( 0 ) : 0 )
 {
@@ -56,6 +70,7 @@ NotePlayHandle::NotePlayHandle( InstrumentTrack* instrumentTrack,
 	m_instrumentTrack( instrumentTrack ),
 	m_frames( 0 ),
 	m_totalFramesPlayed( 0 ),
+	m_framesThisPeriod( 0 ),
 	m_framesBeforeRelease( 0 ),
 	m_releaseFramesToDo( 0 ),
 	m_releaseFramesDone( 0 ),
@@ -76,7 +91,10 @@ NotePlayHandle::NotePlayHandle( InstrumentTrack* instrumentTrack,
 	m_songGlobalParentOffset( 0 ),
 	m_midiChannel( midiEventChannel >= 0 ? midiEventChannel : instrumentTrack->midiPort()->realOutputChannel() ),
 	m_origin( origin ),
-	m_frequencyNeedsUpdate( false )
+	m_frequencyNeedsUpdate( false ),
+	m_fadeOutLength( 0 ),
+	m_fadeOutDone( 0 ),
+	m_lastPeak( 0.0f )
 {
 	lock();
 	if( hasParent() == false )
@@ -142,6 +160,9 @@ NotePlayHandle::~NotePlayHandle()
 		m_instrumentTrack->m_notes[key()] = NULL;
 	}
 
+	// stolen notes may die while the sustain pedal is still pressed
+	m_instrumentTrack->m_sustainedNotes.removeAll( this );
+
 	m_subNotes.clear();
 
 	if( buffer() ) releaseBuffer();
@@ -182,16 +203,40 @@ int NotePlayHandle::midiKey() const
 
 void NotePlayHandle::play( sampleFrame * _working_buffer )
 {
-	if( m_muted )
+	if( !startPlaying() )
 	{
 		return;
 	}
 
+	// under some circumstances we're called even if there's nothing to play
+	// therefore do an additional check which fixes crash e.g. when
+	// decreasing release of an instrument-track while the note is active
+	if( framesLeft() > 0 )
+	{
+		// play note!
+		m_instrumentTrack->playNote( this, _working_buffer );
+	}
+
+	finishPlaying();
+}
+
+
+
+
+bool NotePlayHandle::startPlaying()
+{
+	if( m_muted )
+	{
+		// nothing to fade out
+		m_fadeOutDone = m_fadeOutLength;
+		return false;
+	}
+
 	// if the note offset falls over to next period, then don't start playback yet
 	if( offset() >= Engine::mixer()->framesPerPeriod() )
 	{
 		setOffset( offset() - Engine::mixer()->framesPerPeriod() );
-		return;
+		return false;
 	}
 
 	lock();
@@ -221,35 +266,34 @@ void NotePlayHandle::play( sampleFrame * _working_buffer )
 	}
 
 	// number of frames that can be played this period
-	f_cnt_t framesThisPeriod = m_totalFramesPlayed == 0
+	m_framesThisPeriod = m_totalFramesPlayed == 0
 		? Engine::mixer()->framesPerPeriod() - offset()
 		: Engine::mixer()->framesPerPeriod();
 
 	// check if we start release during this period
 	if( m_released == false &&
 		instrumentTrack()->isSustainPedalPressed() == false &&
-		m_totalFramesPlayed + framesThisPeriod > m_frames )
+		m_totalFramesPlayed + m_framesThisPeriod > m_frames )
 	{
 		noteOff( m_totalFramesPlayed == 0
 			? ( m_frames + offset() ) // if we have noteon and noteoff during the same period, take offset in account for release frame
 			: ( m_frames - m_totalFramesPlayed ) ); // otherwise, the offset is already negated and can be ignored
 	}
 
-	// under some circumstances we're called even if there's nothing to play
-	// therefore do an additional check which fixes crash e.g. when
-	// decreasing release of an instrument-track while the note is active
-	if( framesLeft() > 0 )
-	{
-		// play note!
-		m_instrumentTrack->playNote( this, _working_buffer );
-	}
+	return true;
+}
+
 
+
+
+void NotePlayHandle::finishPlaying()
+{
 	if( m_released && (!instrumentTrack()->isSustainPedalPressed() ||
 		m_releaseStarted) )
 	{
 		m_releaseStarted = true;
 
-		f_cnt_t todo = framesThisPeriod;
+		f_cnt_t todo = m_framesThisPeriod;
 
 		// if this note is base-note for arpeggio, always set
 		// m_releaseFramesToDo to bigger value than m_releaseFramesDone
@@ -265,7 +309,7 @@ void NotePlayHandle::play( sampleFrame * _working_buffer )
 		{
 			// yes, then look whether these samples can be played
 			// within one audio-buffer
-			if( m_framesBeforeRelease <= framesThisPeriod )
+			if( m_framesBeforeRelease <= m_framesThisPeriod )
 			{
 				// yes, then we did less releaseFramesDone
 				todo -= m_framesBeforeRelease;
@@ -277,7 +321,7 @@ void NotePlayHandle::play( sampleFrame * _working_buffer )
 				// and wait for next loop... (we're not in
 				// release-phase yet)
 				todo = 0;
-				m_framesBeforeRelease -= framesThisPeriod;
+				m_framesBeforeRelease -= m_framesThisPeriod;
 			}
 		}
 		// look whether we're in release-phase
@@ -299,14 +343,82 @@ void NotePlayHandle::play( sampleFrame * _working_buffer )
 		}
 	}
 
+	// fade out stolen notes, the instrument can't do that on its own
+	if( isFadingOut() )
+	{
+		sampleFrame * buf = buffer();
+		if( buf )
+		{
+			const f_cnt_t end = noteOffset() + m_framesThisPeriod;
+			for( f_cnt_t f = noteOffset(); f < end; ++f )
+			{
+				const float gain = m_fadeOutDone < m_fadeOutLength
+					? 1.0f - (float) m_fadeOutDone++ / m_fadeOutLength
+					: 0.0f;
+				buf[f][0] *= gain;
+				buf[f][1] *= gain;
+			}
+		}
+		else
+		{
+			m_fadeOutDone = qMin( m_fadeOutDone + m_framesThisPeriod, m_fadeOutLength );
+		}
+	}
+
 	// update internal data
-	m_totalFramesPlayed += framesThisPeriod;
+	m_totalFramesPlayed += m_framesThisPeriod;
+	unlock();
+}
+
+
+
+
+void NotePlayHandle::fadeOut()
+{
+	if( isFadingOut() )
+	{
+		return;
+	}
+
+	lock();
+	noteOff( 0 );
+	if( m_totalFramesPlayed == 0 || m_muted )
+	{
+		// not audible yet, so it can end right away
+		m_fadeOutLength = m_fadeOutDone = 1;
+	}
+	else
+	{
+		m_fadeOutLength = qMax<f_cnt_t>( 1, Engine::mixer()->processingSampleRate() / FadeOutRate );
+		m_fadeOutDone = 0;
+	}
 	unlock();
 }
 
 
 
 
+float NotePlayHandle::lastPeak() const
+{
+	if( m_totalFramesPlayed == 0 )
+	{
+		return std::numeric_limits<float>::max();
+	}
+	return m_lastPeak;
+}
+
+
+
+
+void NotePlayHandle::finishBuffer()
+{
+	PlayHandle::finishBuffer();
+	m_lastPeak = bufferPeak();
+}
+
+
+
+
 f_cnt_t NotePlayHandle::framesLeft() const
 {
 	if( instrumentTrack()->isSustainPedalPressed() )
@@ -558,25 +670,172 @@ void NotePlayHandle::resize( const bpm_t _new_tempo )
 }
 
 
-NotePlayHandle ** NotePlayHandleManager::s_available;
-QReadWriteLock NotePlayHandleManager::s_mutex;
-std::atomic_int NotePlayHandleManager::s_availableIndex;
-int NotePlayHandleManager::s_size;
+namespace
+{
+
+// memory for one handle, linked into the freelist while unused
+struct NphSlot
+{
+	alignas( NotePlayHandle ) char storage[sizeof( NotePlayHandle )];
+	std::atomic<uint32_t> next;
+	uint32_t index;
+} ;
+
+const uint32_t NoSlot = 0xffffffff;
+
+// the pool grows by slabs of this many handles, which it never frees
+// before shutting down, so a slot can always be read safely
+const int SlabSize = NPH_CACHE_INCREMENT;
+const int MaxSlabs = 16384;
+
+// handles a thread keeps for itself and exchanges with the freelist at once
+const int ThreadCacheSize = 32;
+const int ThreadCacheBatch = ThreadCacheSize / 2;
+
+// the pool grows as soon as the freelist holds fewer handles
+const int LowWater = 2 * SlabSize;
+
+std::atomic<NphSlot *> s_slabs[MaxSlabs];
+int s_slabCount = 0;
+QMutex s_growMutex;
+
+// index of the first free slot in the lower 32 bits, a counter of all
+// changes in the upper ones keeps a pop from succeeding with a stale link
+std::atomic<uint64_t> s_freeList( NoSlot );
+std::atomic_int s_freeCount( 0 );
+
+std::atomic_bool s_alive( false );
+EventCount s_lowWater;
+QThread * s_grower = nullptr;
+
+
+NphSlot * slot( uint32_t index )
+{
+	return s_slabs[index / SlabSize].load( std::memory_order_acquire ) + index % SlabSize;
+}
+
+
+uint64_t freeListHead( uint64_t oldHead, uint32_t index )
+{
+	return ( ( oldHead >> 32 ) + 1 ) << 32 | index;
+}
+
+
+void pushFree( NphSlot * first, NphSlot * last, int count )
+{
+	uint64_t head = s_freeList.load( std::memory_order_relaxed );
+	do
+	{
+		last->next.store( static_cast<uint32_t>( head ), std::memory_order_relaxed );
+	}
+	while( !s_freeList.compare_exchange_weak( head, freeListHead( head, first->index ),
+					std::memory_order_release, std::memory_order_relaxed ) );
+	s_freeCount.fetch_add( count, std::memory_order_relaxed );
+}
+
+
+NphSlot * popFree()
+{
+	uint64_t head = s_freeList.load( std::memory_order_acquire );
+	while( static_cast<uint32_t>( head ) != NoSlot )
+	{
+		NphSlot * s = slot( static_cast<uint32_t>( head ) );
+		// the link is stale if another thread popped s meanwhile, but
+		// then the counter makes the exchange fail
+		const uint32_t next = s->next.load( std::memory_order_relaxed );
+		if( s_freeList.compare_exchange_weak( head, freeListHead( head, next ),
+					std::memory_order_acquire, std::memory_order_acquire ) )
+		{
+			s_freeCount.fetch_sub( 1, std::memory_order_relaxed );
+			return s;
+		}
+	}
+	return nullptr;
+}
 
 
-void NotePlayHandleManager::init()
+struct ThreadCache
 {
-	s_available = MM_ALLOC( NotePlayHandle*, INITIAL_NPH_CACHE );
+	NphSlot * slots[ThreadCacheSize];
+	int count = 0;
+
+	~ThreadCache()
+	{
+		// the main thread's cache outlives the pool
+		if( s_alive && count > 0 )
+		{
+			flush( count );
+		}
+	}
+
+	void refill()
+	{
+		while( count < ThreadCacheBatch )
+		{
+			NphSlot * s = popFree();
+			if( s == nullptr )
+			{
+				break;
+			}
+			slots[count++] = s;
+		}
+		if( s_freeCount.load( std::memory_order_relaxed ) < LowWater )
+		{
+			s_lowWater.notify();
+		}
+	}
 
-	NotePlayHandle * n = MM_ALLOC( NotePlayHandle, INITIAL_NPH_CACHE );
+	void flush( int n )
+	{
+		NphSlot * first = slots[count - n];
+		for( int i = count - n; i < count - 1; ++i )
+		{
+			slots[i]->next.store( slots[i + 1]->index, std::memory_order_relaxed );
+		}
+		pushFree( first, slots[count - 1], n );
+		count -= n;
+	}
+} ;
 
-	for( int i=0; i < INITIAL_NPH_CACHE; ++i )
+thread_local ThreadCache s_cache;
+
+
+class NphPoolGrower : public QThread
+{
+	void run() override
 	{
-		s_available[ i ] = n;
-		++n;
+		MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
+		while( true )
+		{
+			const unsigned int key = s_lowWater.prepareWait();
+			if( !s_alive )
+			{
+				s_lowWater.cancelWait();
+				return;
+			}
+			if( s_freeCount.load( std::memory_order_relaxed ) < LowWater )
+			{
+				s_lowWater.cancelWait();
+				NotePlayHandleManager::extend( NPH_CACHE_INCREMENT );
+			}
+			else
+			{
+				s_lowWater.commitWait( key );
+			}
+		}
 	}
-	s_availableIndex = INITIAL_NPH_CACHE - 1;
-	s_size = INITIAL_NPH_CACHE;
+} ;
+
+} // namespace
+
+
+void NotePlayHandleManager::init()
+{
+	s_alive = true;
+	extend( INITIAL_NPH_CACHE );
+
+	s_grower = new NphPoolGrower;
+	s_grower->start( QThread::LowPriority );
 }
 
 
@@ -588,43 +847,74 @@ NotePlayHandle * NotePlayHandleManager::acquire( InstrumentTrack* instrumentTrac
 				int midiEventChannel,
 				NotePlayHandle::Origin origin )
 {
-	// TODO: use some lockless data structures
-	s_mutex.lockForWrite();
-	if (s_availableIndex < 0) { extend(NPH_CACHE_INCREMENT); }
-	NotePlayHandle * nph = s_available[s_availableIndex--];
-	s_mutex.unlock();
+	ThreadCache & cache = s_cache;
+	if( cache.count == 0 )
+	{
+		cache.refill();
+		while( cache.count == 0 )
+		{
+			// the grower fell behind, nothing left but to allocate here
+			extend( NPH_CACHE_INCREMENT );
+			cache.refill();
+		}
+	}
+	NphSlot * s = cache.slots[--cache.count];
 
-	new( (void*)nph ) NotePlayHandle( instrumentTrack, offset, frames, noteToPlay, parent, midiEventChannel, origin );
-	return nph;
+	return new( s->storage ) NotePlayHandle( instrumentTrack, offset, frames, noteToPlay, parent, midiEventChannel, origin );
 }
 
 
 void NotePlayHandleManager::release( NotePlayHandle * nph )
 {
 	nph->NotePlayHandle::~NotePlayHandle();
-	s_mutex.lockForRead();
-	s_available[++s_availableIndex] = nph;
-	s_mutex.unlock();
+
+	ThreadCache & cache = s_cache;
+	if( cache.count == ThreadCacheSize )
+	{
+		cache.flush( ThreadCacheBatch );
+	}
+	// storage is the first member of the slot
+	cache.slots[cache.count++] = reinterpret_cast<NphSlot *>( nph );
 }
 
 
 void NotePlayHandleManager::extend( int c )
 {
-	s_size += c;
-	NotePlayHandle ** tmp = MM_ALLOC( NotePlayHandle*, s_size );
-	MM_FREE( s_available );
-	s_available = tmp;
-
-	NotePlayHandle * n = MM_ALLOC( NotePlayHandle, c );
-
-	for( int i=0; i < c; ++i )
+	QMutexLocker lock( &s_growMutex );
+	for( int added = 0; added < c; added += SlabSize )
 	{
-		s_available[++s_availableIndex] = n;
-		++n;
+		if( s_slabCount == MaxSlabs )
+		{
+			qFatal( "NotePlayHandleManager: too many note play handles" );
+		}
+		NphSlot * slots = MM_ALLOC( NphSlot, SlabSize );
+		for( int i = 0; i < SlabSize; ++i )
+		{
+			NphSlot * s = new( slots + i ) NphSlot;
+			s->index = s_slabCount * SlabSize + i;
+			s->next.store( s->index + 1, std::memory_order_relaxed );
+		}
+		s_slabs[s_slabCount++].store( slots, std::memory_order_release );
+		pushFree( slots, slots + SlabSize - 1, SlabSize );
 	}
 }
 
 void NotePlayHandleManager::free()
 {
-	MM_FREE(s_available);
+	s_alive = false;
+	if( s_grower )
+	{
+		s_lowWater.notify();
+		s_grower->wait();
+		delete s_grower;
+		s_grower = nullptr;
+	}
+
+	for( int i = 0; i < s_slabCount; ++i )
+	{
+		MM_FREE( s_slabs[i].exchange( nullptr ) );
+	}
+	s_slabCount = 0;
+	s_freeList = NoSlot;
+	s_freeCount = 0;
 }
@@ -23,6 +23,7 @@
  */
  
 #include "PlayHandle.h"
+#include "AudioPort.h"
 #include "BufferManager.h"
 #include "Engine.h"
 #include "Mixer.h"
@@ -50,17 +51,49 @@ PlayHandle::~PlayHandle()
 
 
 void PlayHandle::doProcessing()
+{
+	startBuffer();
+	play( m_usesBuffer ? buffer() : NULL );
+	finishBuffer();
+
+	// let the port mix our buffer as soon as all its play handles are done
+	m_audioPort->dependencyMet();
+}
+
+
+void PlayHandle::addProcessingTime( int64_t nanoseconds )
+{
+	m_audioPort->addInstrumentTime( nanoseconds );
+}
+
+
+void PlayHandle::startBuffer()
 {
 	if( m_usesBuffer )
 	{
 		m_bufferReleased = false;
 		BufferManager::clear(m_playHandleBuffer, Engine::mixer()->framesPerPeriod());
-		play( buffer() );
 	}
-	else
+}
+
+
+void PlayHandle::finishBuffer()
+{
+	if( m_usesBuffer )
+	{
+		BufferManager::invalidate(m_playHandleBuffer);
+	}
+}
+
+
+float PlayHandle::bufferPeak() const
+{
+	if( !m_usesBuffer || m_bufferReleased )
 	{
-		play( NULL );
+		return 0.0f;
 	}
+	const BufferInfo & info = BufferManager::analyze( m_playHandleBuffer );
+	return qMax( info.peakLeft, info.peakRight );
 }
 
 
@@ -28,7 +28,11 @@
 #include "RenderManager.h"
 #include "Song.h"
 #include "BBTrackContainer.h"
+#include "AudioPort.h"
 #include "BBTrack.h"
+#include "Effect.h"
+#include "EffectChain.h"
+#include "FxMixer.h"
 
 
 RenderManager::RenderManager(
@@ -70,6 +74,7 @@ void RenderManager::renderNextTrack()
 	{
 		// nothing left to render
 		restoreMutedState();
+		writeCpuUsage();
 		emit finished();
 	}
 	else
@@ -176,6 +181,50 @@ void RenderManager::restoreMutedState()
 	}
 }
 
+static void writeEffectsCpuUsage( MixerProfiler & profiler, const QString & owner,
+							const EffectChain & chain )
+{
+	for( const Effect * effect : chain.effects() )
+	{
+		profiler.writeCpuUsage( owner + " / " + effect->displayName(),
+							effect->cpuUsage() );
+	}
+}
+
+void RenderManager::writeCpuUsage()
+{
+	MixerProfiler & profiler = Engine::mixer()->profiler();
+
+	TrackContainer::TrackList tracks = Engine::getSong()->tracks();
+	tracks += Engine::getBBTrackContainer()->tracks();
+	for( Track * track : tracks )
+	{
+		AudioPort * port = track->audioPort();
+		if( port )
+		{
+			profiler.writeCpuUsage( "track " + track->name(), port->cpuUsage() );
+			if( track->type() == Track::InstrumentTrack )
+			{
+				profiler.writeCpuUsage( "track " + track->name() + " / instrument",
+							port->instrumentCpuUsage() );
+			}
+			if( port->effects() )
+			{
+				writeEffectsCpuUsage( profiler, "track " + track->name(), *port->effects() );
+			}
+		}
+	}
+
+	FxMixer * fxMixer = Engine::fxMixer();
+	for( int i = 0; i < fxMixer->numChannels(); ++i )
+	{
+		FxChannel * ch = fxMixer->effectChannel( i );
+		const QString name = QString( "fx %1 %2" ).arg( i ).arg( ch->m_name );
+		profiler.writeCpuUsage( name, ch->m_cpuUsage );
+		writeEffectsCpuUsage( profiler, name, ch->m_fxChain );
+	}
+}
+
 // Determine the output path for a track when rendering tracks individually
 QString RenderManager::pathForTrack(const Track *track, int num)
 {
@@ -57,15 +57,231 @@
 #include "GuiApplication.h"
 #include "Mixer.h"
 #include "PathUtil.h"
+#include "SampleStream.h"
 
 #include "FileDialog.h"
 
 
+namespace
+{
+
+// File size and sample length limits
+const int fileSizeMax = 300; // MB
+const int sampleLengthMax = 90; // Minutes
+// Streamed files aren't limited
+const int streamingLengthMin = 3; // Minutes
+
+
+//! Returns the playing time of @p file in seconds as far as libsndfile
+//! can tell without decoding it, or 0
+f_cnt_t fileSeconds( const QString & file )
+{
+	// Use QFile to handle unicode file names on Windows
+	QFile f( file );
+	f.open( QIODevice::ReadOnly );
+	SF_INFO sf_info;
+	sf_info.format = 0;
+	f_cnt_t seconds = 0;
+	SNDFILE * snd_file = sf_open_fd( f.handle(), SFM_READ, &sf_info, false );
+	if( snd_file != NULL )
+	{
+		if( sf_info.samplerate > 0 )
+		{
+			seconds = sf_info.frames / sf_info.samplerate;
+		}
+		sf_close( snd_file );
+	}
+	f.close();
+	return seconds;
+}
+
+
+bool exceedsLimits( const QString & file )
+{
+	return QFileInfo( file ).size() > fileSizeMax * 1024 * 1024 ||
+		fileSeconds( file ) > sampleLengthMax * 60;
+}
+
+
+//! Plays frames in place, following loops and ping-pong loops. A ping-pong
+//! loop turns on the loop's end frame, or the last one if the loop ends
+//! with the sample, and on its start frame.
+class FrameWalker
+{
+public:
+	FrameWalker( SampleBuffer::LoopMode loopMode, f_cnt_t loopStart,
+				f_cnt_t loopEnd, f_cnt_t end, f_cnt_t frames ) :
+		m_loopMode( loopMode ),
+		m_loopStart( loopStart ),
+		m_end( loopMode == SampleBuffer::LoopOff ? end :
+			loopMode == SampleBuffer::LoopOn ? loopEnd :
+			qMin( loopEnd, frames - 1 ) )
+	{
+		// loops too short to play are played like the next simpler mode
+		if( m_loopMode == SampleBuffer::LoopPingPong && m_end <= m_loopStart )
+		{
+			m_loopMode = SampleBuffer::LoopOn;
+			m_end = qMin( loopEnd, frames );
+		}
+		if( m_loopMode == SampleBuffer::LoopOn && m_end <= m_loopStart )
+		{
+			m_loopMode = SampleBuffer::LoopOff;
+			m_end = end;
+		}
+	}
+
+	//! Writes @p frames frames of @p data, from @p frame on, to @p dst,
+	//! amplified by @p amp. @p ratio is the number of frames of @p data
+	//! per frame written, and @p fraction the position between @p frame
+	//! and the frame after it, which are interpolated linearly if
+	//! @p interpolate is set. Frames after the end are silent.
+	void play( sampleFrame * dst, fpp_t frames, const sampleFrame * data,
+			double ratio, bool interpolate, float amp,
+			f_cnt_t & frame, bool & backwards, double & fraction ) const
+	{
+		if( m_loopMode == SampleBuffer::LoopOff )
+		{
+			backwards = false;
+		}
+		else if( m_loopMode == SampleBuffer::LoopPingPong && frame > m_end )
+		{
+			frame = m_end;
+			backwards = true;
+		}
+		else if( run( frame, backwards ) <= 0 )
+		{
+			// a straight copy stops right at the end of the loop
+			turn( frame, backwards );
+		}
+
+		fpp_t i = 0;
+		if( ratio == 1.0 && fraction == 0 )
+		{
+			// a straight copy, run by run
+			while( i < frames )
+			{
+				const f_cnt_t n = qMin<f_cnt_t>( frames - i, run( frame, backwards ) );
+				if( n <= 0 )
+				{
+					if( !turn( frame, backwards ) )
+					{
+						break;
+					}
+					continue;
+				}
+				const int step = backwards ? -1 : 1;
+				const sampleFrame * src = data + frame;
+				for( f_cnt_t f = 0; f < n; ++f, src += step )
+				{
+					dst[i + f][0] = ( *src )[0] * amp;
+					dst[i + f][1] = ( *src )[1] * amp;
+				}
+				frame += n * step;
+				i += n;
+			}
+		}
+		else
+		{
+			for( ; i < frames && playing( frame ); ++i )
+			{
+				const sampleFrame & a = data[frame];
+				float left = a[0];
+				float right = a[1];
+				if( interpolate && fraction > 0 )
+				{
+					f_cnt_t next = frame;
+					bool nextBackwards = backwards;
+					advance( next, nextBackwards );
+					const float b0 = playing( next ) ? data[next][0] : 0.0f;
+					const float b1 = playing( next ) ? data[next][1] : 0.0f;
+					left += ( b0 - left ) * fraction;
+					right += ( b1 - right ) * fraction;
+				}
+				dst[i][0] = left * amp;
+				dst[i][1] = right * amp;
+
+				fraction += ratio;
+				for( ; fraction >= 1.0 && playing( frame ); fraction -= 1.0 )
+				{
+					advance( frame, backwards );
+				}
+			}
+		}
+
+		for( ; i < frames; ++i )
+		{
+			dst[i][0] = 0.0f;
+			dst[i][1] = 0.0f;
+		}
+	}
+
+private:
+	bool playing( f_cnt_t frame ) const
+	{
+		return m_loopMode != SampleBuffer::LoopOff || frame < m_end;
+	}
+
+	//! Moves @p frame on to the frame played after it
+	void advance( f_cnt_t & frame, bool & backwards ) const
+	{
+		if( run( frame, backwards ) <= 0 )
+		{
+			turn( frame, backwards );
+		}
+		frame += backwards ? -1 : 1;
+		if( run( frame, backwards ) <= 0 && m_loopMode != SampleBuffer::LoopOff )
+		{
+			turn( frame, backwards );
+		}
+	}
+
+	//! Returns the number of frames from @p frame on before the loop
+	//! turns or wraps, or the sample ends
+	f_cnt_t run( f_cnt_t frame, bool backwards ) const
+	{
+		return backwards ? frame - m_loopStart : m_end - frame;
+	}
+
+	//! Turns or wraps the loop at @p frame, or returns false at the end
+	//! of the sample
+	bool turn( f_cnt_t & frame, bool & backwards ) const
+	{
+		if( backwards )
+		{
+			backwards = false;
+		}
+		else if( m_loopMode == SampleBuffer::LoopOn )
+		{
+			frame = m_loopStart;
+		}
+		else if( m_loopMode == SampleBuffer::LoopPingPong )
+		{
+			backwards = true;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	SampleBuffer::LoopMode m_loopMode;
+	const f_cnt_t m_loopStart;
+	// the frame a ping-pong loop turns on, else the one after the loop
+	// or sample
+	f_cnt_t m_end;
+
+} ;
+
+}
+
+
 SampleBuffer::SampleBuffer() :
 	m_audioFile( "" ),
 	m_origData( NULL ),
 	m_origFrames( 0 ),
 	m_data( NULL ),
+	m_streamingEnabled( false ),
 	m_frames( 0 ),
 	m_startFrame( 0 ),
 	m_endFrame( 0 ),
@@ -94,6 +310,9 @@ SampleBuffer::SampleBuffer( const QString & _audio_file,
 	else
 	{
 		m_audioFile = _audio_file;
+		// nobody plays the buffer yet, so update() needn't stop the
+		// mixer for replacing the frame SampleBuffer() made up
+		releaseData();
 		update();
 	}
 }
@@ -109,6 +328,7 @@ SampleBuffer::SampleBuffer( const sampleFrame * _data, const f_cnt_t _frames )
 		m_origData = MM_ALLOC( sampleFrame, _frames );
 		memcpy( m_origData, _data, _frames * BYTES_PER_FRAME );
 		m_origFrames = _frames;
+		releaseData();
 		update();
 	}
 }
@@ -124,6 +344,7 @@ SampleBuffer::SampleBuffer( const f_cnt_t _frames )
 		m_origData = MM_ALLOC( sampleFrame, _frames );
 		memset( m_origData, 0, _frames * BYTES_PER_FRAME );
 		m_origFrames = _frames;
+		releaseData();
 		update();
 	}
 }
@@ -134,7 +355,7 @@ SampleBuffer::SampleBuffer( const f_cnt_t _frames )
 SampleBuffer::~SampleBuffer()
 {
 	MM_FREE( m_origData );
-	MM_FREE( m_data );
+	releaseData();
 }
 
 
@@ -152,20 +373,40 @@ sample_rate_t SampleBuffer::mixerSampleRate()
 
 void SampleBuffer::update( bool _keep_settings )
 {
-	const bool lock = ( m_data != NULL );
+	// opened before the mixer is stopped, which needn't wait for the disk
+	SampleStream::Ptr stream;
+	if( m_streamingEnabled && !m_audioFile.isEmpty() )
+	{
+		stream = SampleStream::open( PathUtil::toAbsolute( m_audioFile ),
+			m_reversed, streamingLengthMin * 60, [this]()
+			{
+				// on the stream's I/O thread
+				QMetaObject::invokeMethod( this, "sampleUpdated", Qt::QueuedConnection );
+			} );
+	}
+
+	const bool lock = ( m_data != NULL || m_stream );
 	if( lock )
 	{
 		Engine::mixer()->requestChangeInModel();
 		m_varLock.lockForWrite();
-		MM_FREE( m_data );
+		releaseData();
 	}
-
-	// File size and sample length limits
-	const int fileSizeMax = 300; // MB
-	const int sampleLengthMax = 90; // Minutes
+	m_stream = std::move( stream );
 
 	bool fileLoadError = false;
-	if( m_audioFile.isEmpty() && m_origData != NULL && m_origFrames > 0 )
+	if( m_stream )
+	{
+		// the stream plays at the file's sample rate
+		m_frames = m_stream->frames();
+		m_sampleRate = m_stream->sampleRate();
+		if( _keep_settings == false )
+		{
+			m_loopStartFrame = m_startFrame = 0;
+			m_loopEndFrame = m_endFrame = m_frames;
+		}
+	}
+	else if( m_audioFile.isEmpty() && m_origData != NULL && m_origFrames > 0 )
 	{
 		// TODO: reverse- and amplification-property is not covered
 		// by following code...
@@ -187,33 +428,22 @@ void SampleBuffer::update( bool _keep_settings )
 		sample_rate_t samplerate = mixerSampleRate();
 		m_frames = 0;
 
+		// the cache holds the frames unreversed, so every buffer playing
+		// the file can share them
+		const bool reversed = m_reversed;
+		m_reversed = false;
+
+		const QString cacheKey = SampleCache::key( file, mixerSampleRate() );
+		SampleCache::EntryPtr cached = cacheKey.isEmpty()
+			? nullptr : SampleCache::find( cacheKey );
+
 		const QFileInfo fileInfo( file );
-		if( fileInfo.size() > fileSizeMax * 1024 * 1024 )
+		if( !cached && exceedsLimits( file ) )
 		{
 			fileLoadError = true;
 		}
-		else
-		{
-			// Use QFile to handle unicode file names on Windows
-			QFile f(file);
-			f.open(QIODevice::ReadOnly);
-			SNDFILE * snd_file;
-			SF_INFO sf_info;
-			sf_info.format = 0;
-			if( ( snd_file = sf_open_fd( f.handle(), SFM_READ, &sf_info, false ) ) != NULL )
-			{
-				f_cnt_t frames = sf_info.frames;
-				int rate = sf_info.samplerate;
-				if( frames / rate > sampleLengthMax * 60 )
-				{
-					fileLoadError = true;
-				}
-				sf_close( snd_file );
-			}
-			f.close();
-		}
 
-		if( !fileLoadError )
+		if( !cached && !fileLoadError )
 		{
 #ifdef LMMS_HAVE_OGGVORBIS
 			// workaround for a bug in libsndfile or our libsndfile decoder
@@ -243,7 +473,17 @@ void SampleBuffer::update( bool _keep_settings )
 			}
 		}
 
-		if ( m_frames == 0 || fileLoadError )  // if still no frames, bail
+		if( cached )
+		{
+			const sample_rate_t old_rate = m_sampleRate;
+			m_cacheEntry = cached;
+			// read-only while m_cacheEntry is set
+			m_data = const_cast<sampleFrame *>( cached->data() );
+			m_frames = cached->frames();
+			adjustFrameSettings( old_rate, _keep_settings );
+			m_sampleRate = mixerSampleRate();
+		}
+		else if ( m_frames == 0 || fileLoadError )  // if still no frames, bail
 		{
 			// sample couldn't be decoded, create buffer containing
 			// one sample-frame
@@ -256,7 +496,20 @@ void SampleBuffer::update( bool _keep_settings )
 		else // otherwise normalize sample rate
 		{
 			normalizeSampleRate( samplerate, _keep_settings );
+			if( !cacheKey.isEmpty() )
+			{
+				m_cacheEntry = SampleCache::insert( cacheKey, m_data, m_frames );
+				m_data = const_cast<sampleFrame *>( m_cacheEntry->data() );
+				m_frames = m_cacheEntry->frames();
+			}
 		}
+
+		if( reversed )
+		{
+			detachData();
+			std::reverse( m_data, m_data + m_frames );
+		}
+		m_reversed = reversed;
 	}
 	else
 	{
@@ -296,6 +549,37 @@ void SampleBuffer::update( bool _keep_settings )
 }
 
 
+void SampleBuffer::releaseData()
+{
+	m_stream.reset();
+	m_peaks.reset();
+	if( m_cacheEntry )
+	{
+		m_cacheEntry.reset();
+	}
+	else
+	{
+		MM_FREE( m_data );
+	}
+	m_data = NULL;
+}
+
+
+
+
+void SampleBuffer::detachData()
+{
+	m_peaks.reset();
+	if( m_cacheEntry )
+	{
+		sampleFrame * data = MM_ALLOC( sampleFrame, m_frames );
+		memcpy( data, m_data, m_frames * BYTES_PER_FRAME );
+		m_data = data;
+		m_cacheEntry.reset();
+	}
+}
+
+
 void SampleBuffer::convertIntToFloat(
 	int_sample_t * & ibuf,
 	f_cnt_t frames,
@@ -353,7 +637,7 @@ void SampleBuffer::normalizeSampleRate( const sample_rate_t _src_sr,
 					mixerSampleRate() );
 
 		m_sampleRate = mixerSampleRate();
-		MM_FREE( m_data );
+		releaseData();
 		m_frames = resampled->frames();
 		m_data = MM_ALLOC( sampleFrame, m_frames );
 		memcpy( m_data, resampled->data(), m_frames *
@@ -361,15 +645,24 @@ void SampleBuffer::normalizeSampleRate( const sample_rate_t _src_sr,
 		delete resampled;
 	}
 
+	adjustFrameSettings( old_rate, _keep_settings );
+}
+
+
+
+
+void SampleBuffer::adjustFrameSettings( const sample_rate_t _old_rate,
+							bool _keep_settings )
+{
 	if( _keep_settings == false )
 	{
 		// update frame-variables
 		m_loopStartFrame = m_startFrame = 0;
 		m_loopEndFrame = m_endFrame = m_frames;
 	}
-	else if( old_rate != mixerSampleRate() )
+	else if( _old_rate != mixerSampleRate() )
 	{
-		auto old_rate_to_new_rate_ratio = static_cast<float>(mixerSampleRate()) / old_rate;
+		auto old_rate_to_new_rate_ratio = static_cast<float>(mixerSampleRate()) / _old_rate;
 
 		m_startFrame = qBound(0, f_cnt_t(m_startFrame*old_rate_to_new_rate_ratio), m_frames);
 		m_endFrame = qBound(m_startFrame, f_cnt_t(m_endFrame*old_rate_to_new_rate_ratio), m_frames);
@@ -658,18 +951,58 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 		play_frame = getPingPongIndex( play_frame, loopStartFrame, loopEndFrame );
 	}
 
-	f_cnt_t fragment_size = (f_cnt_t)( _frames * freq_factor ) + MARGIN[ _state->interpolationMode() ];
+	if( m_stream && _loopmode != LoopOff )
+	{
+		// keep the start of the loop ready for the jump back
+		m_stream->cue( loopStartFrame );
+	}
+
+	const bool pitched = freq_factor != 1.0 || _state->m_varyingPitch;
 
-	sampleFrame * tmp = NULL;
+	if( !m_stream && ( !pitched ||
+		_state->interpolationMode() == SRC_LINEAR ||
+		_state->interpolationMode() == SRC_ZERO_ORDER_HOLD ) )
+	{
+		// read the frames right where they are, without copying the loop
+		// into a fragment first
+		const FrameWalker walker( _loopmode, loopStartFrame, loopEndFrame,
+							endFrame, m_frames );
+		walker.play( _ab, _frames, m_data, freq_factor,
+				_state->interpolationMode() == SRC_LINEAR, m_amplification,
+				play_frame, is_backwards, _state->m_fraction );
+
+		_state->setBackwards( is_backwards );
+		_state->m_frameIndex = play_frame;
+		return true;
+	}
 
 	// check whether we have to change pitch...
-	if( freq_factor != 1.0 || _state->m_varyingPitch )
+	if( pitched )
 	{
+		if( _state->m_resamplingData == NULL )
+		{
+			int error;
+			if( ( _state->m_resamplingData = src_new( _state->interpolationMode(),
+							DEFAULT_CHANNELS, &error ) ) == NULL )
+			{
+				printf( "Error: src_new() failed in sample_buffer.cpp!\n" );
+				return false;
+			}
+		}
+
+		const f_cnt_t fragment_size = (f_cnt_t)( _frames * freq_factor ) + MARGIN[ _state->interpolationMode() ];
+		// only grows, so it's allocated once per note in practice
+		if( _state->m_fragment.size() < static_cast<std::size_t>( fragment_size ) )
+		{
+			_state->m_fragment.resize( fragment_size );
+		}
+
 		SRC_DATA src_data;
 		// Generate output
 		src_data.data_in =
-			getSampleFragment( play_frame, fragment_size, _loopmode, &tmp, &is_backwards,
-			loopStartFrame, loopEndFrame, endFrame )->data ();
+			getSampleFragment( play_frame, fragment_size, _loopmode,
+				_state->m_fragment.data(), &is_backwards,
+				loopStartFrame, loopEndFrame, endFrame )->data ();
 		src_data.data_out = _ab->data ();
 		src_data.input_frames = fragment_size;
 		src_data.output_frames = _frames;
@@ -718,14 +1051,10 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 	}
 	else
 	{
-		// we don't have to pitch, so we just copy the sample-data
-		// as is into pitched-copy-buffer
-
-		// Generate output
-		memcpy( _ab,
-			getSampleFragment( play_frame, _frames, _loopmode, &tmp, &is_backwards,
-						loopStartFrame, loopEndFrame, endFrame ),
-						_frames * BYTES_PER_FRAME );
+		// we don't have to pitch, so the stream is read right into
+		// the output
+		readStream( _ab, play_frame, _frames, _loopmode, &is_backwards,
+					loopStartFrame, loopEndFrame, endFrame );
 		// Advance
 		switch( _loopmode )
 		{
@@ -756,11 +1085,6 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 		}
 	}
 
-	if( tmp != NULL )
-	{
-		MM_FREE( tmp );
-	}
-
 	_state->setBackwards( is_backwards );
 	_state->setFrameIndex( play_frame );
 
@@ -776,10 +1100,17 @@ bool SampleBuffer::play( sampleFrame * _ab, handleState * _state,
 
 
 
-sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
-		f_cnt_t _frames, LoopMode _loopmode, sampleFrame * * _tmp, bool * _backwards,
+const sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
+		f_cnt_t _frames, LoopMode _loopmode, sampleFrame * _buffer, bool * _backwards,
 		f_cnt_t _loopstart, f_cnt_t _loopend, f_cnt_t _end ) const
 {
+	if( m_stream )
+	{
+		readStream( _buffer, _index, _frames, _loopmode, _backwards,
+						_loopstart, _loopend, _end );
+		return _buffer;
+	}
+
 	if( _loopmode == LoopOff )
 	{
 		if( _index + _frames <= _end )
@@ -802,24 +1133,22 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		}
 	}
 
-	*_tmp = MM_ALLOC( sampleFrame, _frames );
-
 	if( _loopmode == LoopOff )
 	{
 		f_cnt_t available = _end - _index;
-		memcpy( *_tmp, m_data + _index, available * BYTES_PER_FRAME );
-		memset( *_tmp + available, 0, ( _frames - available ) *
+		memcpy( _buffer, m_data + _index, available * BYTES_PER_FRAME );
+		memset( _buffer + available, 0, ( _frames - available ) *
 							BYTES_PER_FRAME );
 	}
 	else if( _loopmode == LoopOn )
 	{
 		f_cnt_t copied = qMin( _frames, _loopend - _index );
-		memcpy( *_tmp, m_data + _index, copied * BYTES_PER_FRAME );
+		memcpy( _buffer, m_data + _index, copied * BYTES_PER_FRAME );
 		f_cnt_t loop_frames = _loopend - _loopstart;
 		while( copied < _frames )
 		{
 			f_cnt_t todo = qMin( _frames - copied, loop_frames );
-			memcpy( *_tmp + copied, m_data + _loopstart, todo * BYTES_PER_FRAME );
+			memcpy( _buffer + copied, m_data + _loopstart, todo * BYTES_PER_FRAME );
 			copied += todo;
 		}
 	}
@@ -837,8 +1166,8 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 			copied = qMin( _frames, pos - _loopstart );
 			for( int i=0; i < copied; i++ )
 			{
-				(*_tmp)[i][0] = m_data[ pos - i ][0];
-				(*_tmp)[i][1] = m_data[ pos - i ][1];
+				_buffer[i][0] = m_data[ pos - i ][0];
+				_buffer[i][1] = m_data[ pos - i ][1];
 			}
 			pos -= copied;
 			if( pos == _loopstart ) backwards = false;
@@ -846,7 +1175,7 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		else
 		{
 			copied = qMin( _frames, _loopend - pos );
-			memcpy( *_tmp, m_data + pos, copied * BYTES_PER_FRAME );
+			memcpy( _buffer, m_data + pos, copied * BYTES_PER_FRAME );
 			pos += copied;
 			if( pos == _loopend ) backwards = true;
 		}
@@ -858,8 +1187,8 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 				f_cnt_t todo = qMin( _frames - copied, pos - _loopstart );
 				for ( int i=0; i < todo; i++ )
 				{
-					(*_tmp)[ copied + i ][0] = m_data[ pos - i ][0];
-					(*_tmp)[ copied + i ][1] = m_data[ pos - i ][1];
+					_buffer[ copied + i ][0] = m_data[ pos - i ][0];
+					_buffer[ copied + i ][1] = m_data[ pos - i ][1];
 				}
 				pos -= todo;
 				copied += todo;
@@ -868,7 +1197,7 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 			else
 			{
 				f_cnt_t todo = qMin( _frames - copied, _loopend - pos );
-				memcpy( *_tmp + copied, m_data + pos, todo * BYTES_PER_FRAME );
+				memcpy( _buffer + copied, m_data + pos, todo * BYTES_PER_FRAME );
 				pos += todo;
 				copied += todo;
 				if( pos >= _loopend ) backwards = true;
@@ -877,7 +1206,57 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 		*_backwards = backwards;
 	}
 
-	return *_tmp;
+	return _buffer;
+}
+
+
+
+
+void SampleBuffer::readStream( sampleFrame * _dst, f_cnt_t _index,
+		f_cnt_t _frames, LoopMode _loopmode, bool * _backwards,
+		f_cnt_t _loopstart, f_cnt_t _loopend, f_cnt_t _end ) const
+{
+	if( _loopmode == LoopOff || _loopend <= _loopstart )
+	{
+		const f_cnt_t available = qBound( 0, _end - _index, _frames );
+		m_stream->read( _dst, _index, available );
+		memset( _dst + available, 0, ( _frames - available ) * BYTES_PER_FRAME );
+		return;
+	}
+
+	// same as getSampleFragment(), but reading the stream
+	f_cnt_t pos = _index;
+	bool backwards = _loopmode == LoopPingPong && pos >= _loopstart && *_backwards;
+	f_cnt_t copied = 0;
+	while( copied < _frames )
+	{
+		if( backwards )
+		{
+			const f_cnt_t todo = qMin( _frames - copied, pos - _loopstart );
+			m_stream->read( _dst + copied, pos - todo + 1, todo );
+			std::reverse( _dst + copied, _dst + copied + todo );
+			pos -= todo;
+			copied += todo;
+			if( pos <= _loopstart ) backwards = false;
+		}
+		else
+		{
+			const f_cnt_t todo = qMin( _frames - copied, _loopend - pos );
+			m_stream->read( _dst + copied, pos, todo );
+			pos += todo;
+			copied += todo;
+			if( pos >= _loopend )
+			{
+				if( _loopmode == LoopOn ) pos = _loopstart;
+				else backwards = true;
+			}
+		}
+	}
+
+	if( _loopmode == LoopPingPong )
+	{
+		*_backwards = backwards;
+	}
 }
 
 
@@ -885,7 +1264,8 @@ sampleFrame * SampleBuffer::getSampleFragment( f_cnt_t _index,
 
 f_cnt_t SampleBuffer::getLoopedIndex( f_cnt_t _index, f_cnt_t _startf, f_cnt_t _endf ) const
 {
-	if( _index < _endf )
+	// empty loops aren't played, see FrameWalker
+	if( _index < _endf || _endf <= _startf )
 	{
 		return _index;
 	}
@@ -896,7 +1276,7 @@ f_cnt_t SampleBuffer::getLoopedIndex( f_cnt_t _index, f_cnt_t _startf, f_cnt_t _
 
 f_cnt_t SampleBuffer::getPingPongIndex( f_cnt_t _index, f_cnt_t _startf, f_cnt_t _endf ) const
 {
-	if( _index < _endf )
+	if( _index < _endf || _endf <= _startf )
 	{
 		return _index;
 	}
@@ -918,6 +1298,12 @@ void SampleBuffer::visualize(
 {
 	if (m_frames == 0) { return; }
 
+	if (m_stream)
+	{
+		visualizeStream(p, dr, clip, from_frame, to_frame);
+		return;
+	}
+
 	const bool focus_on_range = to_frame <= m_frames && 0 <= from_frame && from_frame < to_frame;
 	//p.setClipRect( clip );
 	const int w = dr.width();
@@ -927,7 +1313,13 @@ void SampleBuffer::visualize(
 	const float y_space = h*0.5f;
 	const int nb_frames = focus_on_range ? to_frame - from_frame : m_frames;
 
-	const int fpp = qBound<int>(1, nb_frames / w, 20);
+	if (nb_frames / w > 20)
+	{
+		visualizePeaks(p, dr, clip, peaks(), m_data, focus_on_range ? from_frame : 0, nb_frames);
+		return;
+	}
+
+	const int fpp = qMax(1, nb_frames / w);
 	QPointF * l = new QPointF[nb_frames / fpp + 1];
 	QPointF * r = new QPointF[nb_frames / fpp + 1];
 	int n = 0;
@@ -955,6 +1347,101 @@ void SampleBuffer::visualize(
 
 
 
+void SampleBuffer::visualizePeaks(QPainter & p, const QRect & dr, const QRect & clip,
+	const SamplePeaks & samplePeaks, const sampleFrame * data,
+	f_cnt_t first, f_cnt_t nb_frames)
+{
+	// too many frames for a polyline, so draw a line from the minimum to
+	// the maximum of each pixel, only for the pixels that are painted
+	const int w = dr.width();
+	const int yb = dr.height() / 2 + dr.y();
+	const float py = dr.height() * 0.5f * m_amplification;
+	const int from_x = qMax(dr.left(), clip.left()) - dr.x();
+	const int to_x = qMin(dr.right(), clip.right()) - dr.x();
+
+	QVector<QLineF> lines;
+	lines.reserve(2 * qMax(0, to_x - from_x + 1));
+	for (int x = from_x; x <= to_x; ++x)
+	{
+		const f_cnt_t begin = first + f_cnt_t(double(x) * nb_frames / w);
+		const f_cnt_t end = first + f_cnt_t(double(x + 1) * nb_frames / w);
+		SamplePeaks::Peak peak;
+		if (!data || end - begin >= SamplePeaks::BaseFrames * SamplePeaks::LevelFactor)
+		{
+			// rounded out to whole peaks, which are small next to the
+			// pixel or all there is without the frames
+			if (!samplePeaks.peak(begin, qMax(end, begin + 1), peak)) { continue; }
+		}
+		else
+		{
+			for (int ch = 0; ch < DEFAULT_CHANNELS; ++ch)
+			{
+				peak.min[ch] = peak.max[ch] = data[begin][ch];
+				for (f_cnt_t f = begin + 1; f < end; ++f)
+				{
+					peak.min[ch] = qMin(peak.min[ch], data[f][ch]);
+					peak.max[ch] = qMax(peak.max[ch], data[f][ch]);
+				}
+			}
+		}
+		for (int ch = 0; ch < DEFAULT_CHANNELS; ++ch)
+		{
+			lines.append(QLineF(dr.x() + x, yb - peak.max[ch] * py,
+						dr.x() + x, yb - peak.min[ch] * py));
+		}
+	}
+
+	p.drawLines(lines);
+}
+
+
+
+
+const SamplePeaks & SampleBuffer::peaks()
+{
+	if (m_cacheEntry)
+	{
+		return m_cacheEntry->peaks();
+	}
+	if (!m_peaks)
+	{
+		m_peaks.reset(new SamplePeaks(m_data, m_frames));
+	}
+	return *m_peaks;
+}
+
+
+
+
+void SampleBuffer::setPeaks( std::unique_ptr<SamplePeaks> _peaks )
+{
+	if( _peaks && _peaks->frames() == m_frames && !m_cacheEntry && !m_stream )
+	{
+		m_peaks = std::move( _peaks );
+	}
+}
+
+
+
+
+void SampleBuffer::visualizeStream(QPainter & p, const QRect & dr, const QRect & clip,
+	f_cnt_t from_frame, f_cnt_t to_frame)
+{
+	// the frames aren't in memory, so draw the peaks the stream's I/O
+	// thread has scanned so far
+	const bool focus_on_range = to_frame <= m_frames && 0 <= from_frame && from_frame < to_frame;
+	const f_cnt_t first = focus_on_range ? from_frame : 0;
+	const f_cnt_t nb_frames = focus_on_range ? to_frame - from_frame : m_frames;
+
+	m_stream->visitPeaks([&](const SamplePeaks & samplePeaks)
+	{
+		visualizePeaks(p, dr, clip, samplePeaks, nullptr, first, nb_frames);
+	});
+}
+
+
+
+
 QString SampleBuffer::openAudioFile() const
 {
 	FileDialog ofd( NULL, tr( "Open audio file" ) );
@@ -1194,13 +1681,47 @@ SampleBuffer * SampleBuffer::resample( const sample_rate_t _src_sr,
 	{
 		printf( "Error: src_new() failed in sample_buffer.cpp!\n" );
 	}
-	dst_sb->update();
+	// the new buffer isn't played yet, so there's no need for update()
+	// and stopping the mixer
+	memcpy( dst_sb->m_data, dst_buf, dst_frames * BYTES_PER_FRAME );
 	return dst_sb;
 }
 
 
 
 
+SampleCache::EntryPtr SampleBuffer::preload( const QString & _audio_file,
+							bool _streamed )
+{
+	const QString file = PathUtil::toAbsolute( _audio_file );
+	const QString cacheKey = SampleCache::key( file, mixerSampleRate() );
+	// DrumSynth keeps its state in globals, so .ds files are left to the
+	// thread the project is loaded on
+	if( cacheKey.isEmpty() || QFileInfo( file ).suffix() == "ds" ||
+		exceedsLimits( file ) ||
+		( _streamed && fileSeconds( file ) >= streamingLengthMin * 60 ) )
+	{
+		return nullptr;
+	}
+	if( !SampleCache::claim( cacheKey ) )
+	{
+		// cached already or another thread is on it
+		return SampleCache::find( cacheKey );
+	}
+
+	// a buffer of its own, which update() doesn't stop the mixer for
+	SampleBuffer buffer;
+	buffer.m_audioFile = file;
+	buffer.releaseData();
+	buffer.update();
+	SampleCache::release( cacheKey );
+
+	return buffer.m_cacheEntry;
+}
+
+
+
+
 void SampleBuffer::setAudioFile( const QString & _audio_file )
 {
 	m_audioFile = PathUtil::toShortestRelative( _audio_file );
@@ -1382,6 +1903,17 @@ void SampleBuffer::setEndFrame( const f_cnt_t _e )
 
 
 
+void SampleBuffer::prefetch( f_cnt_t _frame )
+{
+	if( m_stream )
+	{
+		m_stream->cue( _frame );
+	}
+}
+
+
+
+
 void SampleBuffer::setAmplification( float _a )
 {
 	m_amplification = _a;
@@ -1393,9 +1925,21 @@ void SampleBuffer::setAmplification( float _a )
 
 void SampleBuffer::setReversed( bool _on )
 {
+	if( m_stream )
+	{
+		// the stream decodes backwards once reopened
+		m_reversed = _on;
+		update( true );
+		return;
+	}
+
 	Engine::mixer()->requestChangeInModel();
 	m_varLock.lockForWrite();
-	if (m_reversed != _on) { std::reverse(m_data, m_data + m_frames); }
+	if (m_reversed != _on)
+	{
+		detachData();
+		std::reverse(m_data, m_data + m_frames);
+	}
 	m_reversed = _on;
 	m_varLock.unlock();
 	Engine::mixer()->doneChangeInModel();
@@ -1415,16 +1959,14 @@ void SampleBuffer::setReversed( bool _on )
 
 SampleBuffer::handleState::handleState( bool _varying_pitch, int interpolation_mode ) :
 	m_frameIndex( 0 ),
+	m_fraction( 0 ),
 	m_varyingPitch( _varying_pitch ),
-	m_isBackwards( false )
+	m_isBackwards( false ),
+	// created by play() once it's needed, which it isn't for linear
+	// interpolation or none of samples in memory
+	m_resamplingData( NULL ),
+	m_interpolationMode( interpolation_mode )
 {
-	int error;
-	m_interpolationMode = interpolation_mode;
-
-	if( ( m_resamplingData = src_new( interpolation_mode, DEFAULT_CHANNELS, &error ) ) == NULL )
-	{
-		qDebug( "Error: src_new() failed in sample_buffer.cpp!\n" );
-	}
 }
 
 
@@ -1432,5 +1974,8 @@ SampleBuffer::handleState::handleState( bool _varying_pitch, int interpolation_m
 
 SampleBuffer::handleState::~handleState()
 {
-	src_delete( m_resamplingData );
+	if( m_resamplingData != NULL )
+	{
+		src_delete( m_resamplingData );
+	}
 }
@@ -0,0 +1,502 @@
+/*
+ * SampleCache.cpp - decoded samples shared by all SampleBuffers of a file
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <limits>
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include "EventCount.h"
+#include "MemoryManager.h"
+
+
+namespace
+{
+
+// number of recently used entries kept alive without a user
+const size_t RecentEntries = 8;
+// only short samples are kept that way, about 10 s at 48 kHz
+const f_cnt_t RecentMaxFrames = 480000;
+
+// cache files are kept below this size altogether, the ones written
+// longest ago are removed first
+const qint64 DiskBytesMax = qint64( 2 ) << 30;
+// bigger entries aren't written to a file
+const qint64 FileBytesMax = DiskBytesMax / 4;
+
+const char FileSuffix[] = ".lmmssample";
+const char FileMagic[8] = { 'L', 'M', 'M', 'S', 'S', 'M', 'P', 'L' };
+const quint32 FileVersion = 1;
+// tells whether a file was written on a machine with the same byte order
+const quint32 ByteOrderMark = 0x01020304;
+// the frames start at a page boundary
+const qint64 FramesAlignment = 4096;
+
+//! The start of a cache file. It is followed by the UTF-8 encoded key,
+//! the frames and the peaks, all in the machine's own representation.
+struct FileHeader
+{
+	char magic[8];
+	quint32 version;
+	quint32 byteOrder;
+	quint32 keySize;
+	quint32 peakSize;
+	qint64 frames;
+	qint64 framesOffset;
+	qint64 peaksOffset;
+} ;
+
+QMutex s_mutex;
+QHash<QString, std::weak_ptr<const SampleCache::Entry>> s_entries;
+std::deque<SampleCache::EntryPtr> s_recent;
+// keys being decoded and the threads decoding them
+QHash<QString, QThread *> s_claims;
+// signalled with s_mutex held whenever a claim ends
+QWaitCondition s_claimEnded;
+
+// guards the entries waiting for their cache file and s_writer
+QMutex s_writeMutex;
+std::deque<std::pair<QString, SampleCache::EntryPtr>> s_unwritten;
+QThread * s_writer = nullptr;
+bool s_stopWriting = false;
+EventCount s_writeQueued;
+
+
+QString cacheDir()
+{
+	const QString dir = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	return dir.isEmpty() ? dir : dir + "/samples/";
+}
+
+
+void touch( const SampleCache::EntryPtr & entry )
+{
+	if( entry->frames() > RecentMaxFrames )
+	{
+		return;
+	}
+
+	auto it = std::find( s_recent.begin(), s_recent.end(), entry );
+	if( it != s_recent.end() )
+	{
+		s_recent.erase( it );
+	}
+	else if( s_recent.size() >= RecentEntries )
+	{
+		s_recent.pop_back();
+	}
+	s_recent.push_front( entry );
+}
+
+
+//! Remembers @p entry for @p key unless there's an entry already, which
+//! is returned then. Must be called with s_mutex held.
+SampleCache::EntryPtr share( const QString & key, const SampleCache::EntryPtr & entry )
+{
+	SampleCache::EntryPtr shared = s_entries.value( key ).lock();
+	if( !shared )
+	{
+		// forget the entries nobody uses anymore
+		for( auto it = s_entries.begin(); it != s_entries.end(); )
+		{
+			if( it.value().expired() )
+			{
+				it = s_entries.erase( it );
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		shared = entry;
+		s_entries.insert( key, shared );
+	}
+	touch( shared );
+
+	if( s_claims.remove( key ) > 0 )
+	{
+		s_claimEnded.wakeAll();
+	}
+
+	return shared;
+}
+
+}
+
+
+
+
+//! Writes cache files in the background, so neither the audio thread nor
+//! the threads decoding a project wait for the disk
+class SampleCacheWriter : public QThread
+{
+	void run() override
+	{
+		MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
+		while( true )
+		{
+			const unsigned int key = s_writeQueued.prepareWait();
+
+			s_writeMutex.lock();
+			std::deque<std::pair<QString, SampleCache::EntryPtr>> unwritten;
+			unwritten.swap( s_unwritten );
+			const bool stop = s_stopWriting;
+			s_writeMutex.unlock();
+
+			if( !unwritten.empty() )
+			{
+				s_writeQueued.cancelWait();
+				SampleCache::write( unwritten );
+			}
+			else if( stop )
+			{
+				s_writeQueued.cancelWait();
+				return;
+			}
+			else
+			{
+				s_writeQueued.commitWait( key );
+			}
+		}
+	}
+} ;
+
+
+
+
+SampleCache::Entry::Entry( sampleFrame * data, f_cnt_t frames ) :
+	m_data( data ),
+	m_frames( frames ),
+	m_peaks( data, frames )
+{
+}
+
+
+
+
+SampleCache::Entry::Entry( std::unique_ptr<QFile> file, const sampleFrame * data,
+				f_cnt_t frames, const SamplePeaks::Peak * peaks ) :
+	m_file( std::move( file ) ),
+	m_data( data ),
+	m_frames( frames ),
+	m_peaks( peaks, frames )
+{
+}
+
+
+
+
+SampleCache::Entry::~Entry()
+{
+	// closing m_file unmaps it
+	if( !m_file )
+	{
+		MM_FREE( const_cast<sampleFrame *>( m_data ) );
+	}
+}
+
+
+
+
+QString SampleCache::key( const QString & file, sample_rate_t sampleRate )
+{
+	const QFileInfo info( file );
+	if( !info.exists() )
+	{
+		return QString();
+	}
+
+	return QString( "%1:%2:%3:%4" )
+		.arg( sampleRate )
+		.arg( info.size() )
+		.arg( info.lastModified().toMSecsSinceEpoch() )
+		.arg( info.absoluteFilePath() );
+}
+
+
+
+
+SampleCache::EntryPtr SampleCache::find( const QString & key )
+{
+	s_mutex.lock();
+	EntryPtr entry;
+	while( !( entry = s_entries.value( key ).lock() ) &&
+		s_claims.value( key, QThread::currentThread() ) != QThread::currentThread() )
+	{
+		s_claimEnded.wait( &s_mutex );
+	}
+	if( entry )
+	{
+		touch( entry );
+	}
+	s_mutex.unlock();
+
+	if( !entry && ( entry = load( key ) ) )
+	{
+		QMutexLocker lock( &s_mutex );
+		entry = share( key, entry );
+	}
+
+	return entry;
+}
+
+
+
+
+SampleCache::EntryPtr SampleCache::insert( const QString & key,
+						sampleFrame * data, f_cnt_t frames )
+{
+	// if another thread was faster, this frees data again
+	const EntryPtr entry( new Entry( data, frames ) );
+
+	s_mutex.lock();
+	const EntryPtr shared = share( key, entry );
+	s_mutex.unlock();
+
+	if( shared == entry )
+	{
+		s_writeMutex.lock();
+		s_unwritten.emplace_back( key, entry );
+		if( s_writer == nullptr )
+		{
+			s_writer = new SampleCacheWriter;
+			s_writer->start( QThread::LowPriority );
+		}
+		s_writeMutex.unlock();
+		s_writeQueued.notify();
+	}
+
+	return shared;
+}
+
+
+
+
+void SampleCache::finishWriting()
+{
+	s_writeMutex.lock();
+	QThread * writer = s_writer;
+	s_stopWriting = true;
+	s_writer = nullptr;
+	s_writeMutex.unlock();
+
+	if( writer )
+	{
+		s_writeQueued.notify();
+		writer->wait();
+		delete writer;
+	}
+}
+
+
+
+
+bool SampleCache::claim( const QString & key )
+{
+	QMutexLocker lock( &s_mutex );
+	if( key.isEmpty() || s_claims.contains( key ) || !s_entries.value( key ).expired() )
+	{
+		return false;
+	}
+
+	s_claims.insert( key, QThread::currentThread() );
+	return true;
+}
+
+
+
+
+void SampleCache::release( const QString & key )
+{
+	QMutexLocker lock( &s_mutex );
+	if( s_claims.remove( key ) > 0 )
+	{
+		s_claimEnded.wakeAll();
+	}
+}
+
+
+
+
+QString SampleCache::fileName( const QString & key )
+{
+	const QString dir = cacheDir();
+	if( dir.isEmpty() || key.isEmpty() )
+	{
+		return QString();
+	}
+
+	return dir + QCryptographicHash::hash( key.toUtf8(), QCryptographicHash::Sha1 ).toHex() +
+		FileSuffix;
+}
+
+
+
+
+SampleCache::EntryPtr SampleCache::load( const QString & key )
+{
+	const QString name = fileName( key );
+	if( name.isEmpty() || !QFileInfo::exists( name ) )
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<QFile> file( new QFile( name ) );
+	const qint64 size = file->size();
+	if( !file->open( QIODevice::ReadOnly ) || size < qint64( sizeof( FileHeader ) ) )
+	{
+		return nullptr;
+	}
+	const uchar * map = file->map( 0, size );
+	if( map == nullptr )
+	{
+		return nullptr;
+	}
+
+	FileHeader header;
+	memcpy( &header, map, sizeof( header ) );
+	const QByteArray utf8 = key.toUtf8();
+	const qint64 keyEnd = sizeof( header ) + utf8.size();
+	// the key is compared as well, in case of a hash collision
+	if( memcmp( header.magic, FileMagic, sizeof( FileMagic ) ) != 0 ||
+		header.version != FileVersion ||
+		header.byteOrder != ByteOrderMark ||
+		header.peakSize != sizeof( SamplePeaks::Peak ) ||
+		header.keySize != quint32( utf8.size() ) || keyEnd > size ||
+		memcmp( map + sizeof( header ), utf8.constData(), utf8.size() ) != 0 ||
+		header.frames <= 0 || header.frames > std::numeric_limits<f_cnt_t>::max() ||
+		header.framesOffset < keyEnd || header.framesOffset % FramesAlignment != 0 ||
+		header.peaksOffset < header.framesOffset + header.frames * qint64( sizeof( sampleFrame ) ) ||
+		header.peaksOffset % sizeof( float ) != 0 ||
+		header.peaksOffset + qint64( SamplePeaks::size( header.frames ) *
+					sizeof( SamplePeaks::Peak ) ) > size )
+	{
+		return nullptr;
+	}
+
+	const f_cnt_t frames = static_cast<f_cnt_t>( header.frames );
+	const sampleFrame * data = reinterpret_cast<const sampleFrame *>( map + header.framesOffset );
+	const SamplePeaks::Peak * peaks =
+		reinterpret_cast<const SamplePeaks::Peak *>( map + header.peaksOffset );
+	return EntryPtr( new Entry( std::move( file ), data, frames, peaks ) );
+}
+
+
+
+
+void SampleCache::write( const std::deque<std::pair<QString, EntryPtr>> & entries )
+{
+	QStringList written;
+	for( const auto & entry : entries )
+	{
+		const QString name = fileName( entry.first );
+		if( store( name, entry.first, *entry.second ) )
+		{
+			written << QFileInfo( name ).absoluteFilePath();
+		}
+	}
+	if( !written.isEmpty() )
+	{
+		prune( written );
+	}
+}
+
+
+
+
+bool SampleCache::store( const QString & name, const QString & key, const Entry & entry )
+{
+	const QByteArray utf8 = key.toUtf8();
+	const qint64 frameBytes = entry.frames() * qint64( sizeof( sampleFrame ) );
+	const qint64 peakBytes = SamplePeaks::size( entry.frames() ) * sizeof( SamplePeaks::Peak );
+	if( name.isEmpty() || frameBytes + peakBytes > FileBytesMax ||
+		!QDir().mkpath( QFileInfo( name ).path() ) )
+	{
+		return false;
+	}
+
+	FileHeader header;
+	memcpy( header.magic, FileMagic, sizeof( FileMagic ) );
+	header.version = FileVersion;
+	header.byteOrder = ByteOrderMark;
+	header.keySize = utf8.size();
+	header.peakSize = sizeof( SamplePeaks::Peak );
+	header.frames = entry.frames();
+	const qint64 keyEnd = sizeof( header ) + utf8.size();
+	header.framesOffset = ( keyEnd + FramesAlignment - 1 ) / FramesAlignment * FramesAlignment;
+	header.peaksOffset = header.framesOffset + frameBytes;
+
+	// QSaveFile renames the file into place when it's complete, so no
+	// other instance maps it half-written
+	QSaveFile file( name );
+	if( !file.open( QIODevice::WriteOnly ) )
+	{
+		return false;
+	}
+	file.write( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+	file.write( utf8 );
+	file.write( QByteArray( header.framesOffset - keyEnd, 0 ) );
+	file.write( reinterpret_cast<const char *>( entry.data() ), frameBytes );
+	const SamplePeaks & peaks = entry.peaks();
+	for( int l = 0; l < peaks.levels(); ++l )
+	{
+		file.write( reinterpret_cast<const char *>( peaks.level( l ) ),
+				peaks.levelSize( l ) * sizeof( SamplePeaks::Peak ) );
+	}
+	return file.commit();
+}
+
+
+
+
+void SampleCache::prune( const QStringList & keep )
+{
+	qint64 total = 0;
+	const QFileInfoList files = QDir( cacheDir() ).entryInfoList(
+		QStringList( QString( "*" ) + FileSuffix ), QDir::Files, QDir::Time );
+	// newest first
+	for( const QFileInfo & info : files )
+	{
+		total += info.size();
+		if( total > DiskBytesMax && !keep.contains( info.absoluteFilePath() ) )
+		{
+			QFile::remove( info.absoluteFilePath() );
+		}
+	}
+}
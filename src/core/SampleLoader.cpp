@@ -0,0 +1,187 @@
+/*
+ * SampleLoader.cpp - decodes the samples of a project in parallel
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleLoader.h"
+
+#include <algorithm>
+
+#include <QtCore/QDebug>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QThread>
+#include <QtXml/QDomElement>
+#include <QtXml/QDomNodeList>
+
+#include "MemoryManager.h"
+#include "PathUtil.h"
+#include "SampleBuffer.h"
+
+
+namespace
+{
+
+// decoding taking less altogether isn't reported
+const qint64 ReportMsecs = 1000;
+// number of files reported
+const std::size_t ReportFiles = 5;
+
+}
+
+
+
+
+class SampleLoaderThread : public QThread
+{
+public:
+	SampleLoaderThread( SampleLoader * loader ) :
+		m_loader( loader )
+	{
+	}
+
+private:
+	void run() override
+	{
+		MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
+		while( !m_loader->m_stop )
+		{
+			const std::size_t i = m_loader->m_next++;
+			if( i >= m_loader->m_samples.size() )
+			{
+				return;
+			}
+
+			SampleLoader::Sample & sample = m_loader->m_samples[i];
+			QElapsedTimer timer;
+			timer.start();
+			sample.entry = SampleBuffer::preload( sample.file, sample.streamed );
+			sample.msecs = timer.elapsed();
+		}
+	}
+
+	SampleLoader * m_loader;
+
+} ;
+
+
+
+
+SampleLoader::SampleLoader( const QDomElement & project ) :
+	m_next( 0 ),
+	m_stop( false )
+{
+	addFiles( project, "sampletco", true );
+	addFiles( project, "audiofileprocessor", false );
+
+	const std::size_t threads = std::min<std::size_t>( m_samples.size(),
+					std::max( QThread::idealThreadCount(), 1 ) );
+	for( std::size_t i = 0; i < threads; ++i )
+	{
+		m_threads.emplace_back( new SampleLoaderThread( this ) );
+		m_threads.back()->start( QThread::LowPriority );
+	}
+}
+
+
+
+
+SampleLoader::~SampleLoader()
+{
+	m_stop = true;
+	wait();
+}
+
+
+
+
+void SampleLoader::report()
+{
+	wait();
+
+	qint64 total = 0;
+	std::vector<const Sample *> slowest;
+	for( const Sample & sample : m_samples )
+	{
+		total += sample.msecs;
+		slowest.push_back( &sample );
+	}
+	if( total < ReportMsecs )
+	{
+		return;
+	}
+
+	std::sort( slowest.begin(), slowest.end(),
+		[]( const Sample * a, const Sample * b ) { return a->msecs > b->msecs; } );
+	slowest.resize( std::min( slowest.size(), ReportFiles ) );
+
+	qDebug() << "Decoded" << m_samples.size() << "samples in" << total
+		<< "msecs on" << m_threads.size() << "threads, the slowest:";
+	for( const Sample * sample : slowest )
+	{
+		qDebug() << "  " << sample->msecs << "msecs" << sample->file;
+	}
+}
+
+
+
+
+void SampleLoader::addFiles( const QDomElement & project,
+					const QString & tagName, bool streamed )
+{
+	QHash<QString, std::size_t> known;
+	for( std::size_t i = 0; i < m_samples.size(); ++i )
+	{
+		known.insert( m_samples[i].file, i );
+	}
+
+	const QDomNodeList nodes = project.elementsByTagName( tagName );
+	for( int i = 0; i < nodes.count(); ++i )
+	{
+		const QString src = nodes.at( i ).toElement().attribute( "src" );
+		if( src.isEmpty() )
+		{
+			continue;
+		}
+
+		const QString file = PathUtil::toAbsolute( src );
+		if( known.contains( file ) )
+		{
+			// decoded for good if anything else plays it
+			m_samples[known.value( file )].streamed &= streamed;
+			continue;
+		}
+		known.insert( file, m_samples.size() );
+		m_samples.push_back( Sample{ file, streamed, nullptr, 0 } );
+	}
+}
+
+
+
+
+void SampleLoader::wait()
+{
+	for( const auto & thread : m_threads )
+	{
+		thread->wait();
+	}
+}
@@ -0,0 +1,297 @@
+/*
+ * SamplePeaks.cpp - waveform overview of a sample at several zoom levels
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SamplePeaks.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+
+std::size_t peaksOf( std::size_t n, std::size_t perPeak )
+{
+	return ( n + perPeak - 1 ) / perPeak;
+}
+
+
+std::size_t levelSizeOf( f_cnt_t frames, int level )
+{
+	std::size_t n = peaksOf( std::max( frames, 0 ), SamplePeaks::BaseFrames );
+	for( int l = 0; l < level; ++l )
+	{
+		n = peaksOf( n, SamplePeaks::LevelFactor );
+	}
+	return n;
+}
+
+
+//! Merges frames and peaks into one peak, the RMS weighted by the frames
+//! each peak covers
+class PeakSum
+{
+public:
+	void add( const SamplePeaks::Peak & peak, f_cnt_t frames )
+	{
+		for( int ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+		{
+			m_peak.min[ch] = m_frames > 0 ? std::min( m_peak.min[ch], peak.min[ch] ) : peak.min[ch];
+			m_peak.max[ch] = m_frames > 0 ? std::max( m_peak.max[ch], peak.max[ch] ) : peak.max[ch];
+			m_squares[ch] += frames * peak.rms[ch] * peak.rms[ch];
+		}
+		m_frames += frames;
+	}
+
+	void add( const sampleFrame * data, f_cnt_t frames )
+	{
+		for( f_cnt_t f = 0; f < frames; ++f )
+		{
+			for( int ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+			{
+				m_peak.min[ch] = m_frames > 0 ? std::min( m_peak.min[ch], data[f][ch] ) : data[f][ch];
+				m_peak.max[ch] = m_frames > 0 ? std::max( m_peak.max[ch], data[f][ch] ) : data[f][ch];
+				m_squares[ch] += data[f][ch] * data[f][ch];
+			}
+			++m_frames;
+		}
+	}
+
+	SamplePeaks::Peak peak() const
+	{
+		SamplePeaks::Peak peak = m_peak;
+		for( int ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+		{
+			peak.rms[ch] = std::sqrt( m_squares[ch] / m_frames );
+		}
+		return peak;
+	}
+
+private:
+	SamplePeaks::Peak m_peak;
+	float m_squares[DEFAULT_CHANNELS] = { 0 };
+	f_cnt_t m_frames = 0;
+
+} ;
+
+}
+
+
+
+
+const f_cnt_t SamplePeaks::BaseFrames;
+const int SamplePeaks::LevelFactor;
+
+
+
+
+SamplePeaks::SamplePeaks() :
+	m_frames( 0 )
+{
+}
+
+
+
+
+SamplePeaks::SamplePeaks( const sampleFrame * data, f_cnt_t frames ) :
+	SamplePeaks()
+{
+	append( data, frames );
+}
+
+
+
+
+SamplePeaks::SamplePeaks( const Peak * peaks, f_cnt_t frames ) :
+	m_frames( frames )
+{
+	for( std::size_t n = levelSizeOf( frames, 0 ); n > 0;
+					n = n > 1 ? peaksOf( n, LevelFactor ) : 0 )
+	{
+		m_levels.push_back( peaks );
+		peaks += n;
+	}
+}
+
+
+
+
+void SamplePeaks::append( const sampleFrame * data, f_cnt_t frames )
+{
+	if( frames <= 0 )
+	{
+		return;
+	}
+	if( m_ownLevels.empty() )
+	{
+		m_ownLevels.emplace_back();
+	}
+
+	// complete the last peak of level 0 before adding new ones
+	std::vector<Peak> & base = m_ownLevels[0];
+	const f_cnt_t partial = m_frames % BaseFrames;
+	f_cnt_t f = 0;
+	if( partial > 0 )
+	{
+		PeakSum sum;
+		sum.add( base.back(), partial );
+		f = std::min( frames, BaseFrames - partial );
+		sum.add( data, f );
+		base.back() = sum.peak();
+	}
+	for( ; f < frames; f += BaseFrames )
+	{
+		PeakSum sum;
+		sum.add( data + f, std::min( BaseFrames, frames - f ) );
+		base.push_back( sum.peak() );
+	}
+
+	// merge the peaks that changed into the next level, and so on
+	std::size_t changed = m_frames / BaseFrames;
+	m_frames += frames;
+	for( std::size_t l = 1; m_ownLevels[l - 1].size() > 1; ++l )
+	{
+		if( l == m_ownLevels.size() )
+		{
+			m_ownLevels.emplace_back();
+		}
+		const std::vector<Peak> & from = m_ownLevels[l - 1];
+		std::vector<Peak> & to = m_ownLevels[l];
+		changed /= LevelFactor;
+		to.resize( peaksOf( from.size(), LevelFactor ) );
+		for( std::size_t p = changed; p < to.size(); ++p )
+		{
+			PeakSum sum;
+			const std::size_t last = std::min( from.size(), ( p + 1 ) * LevelFactor );
+			for( std::size_t i = p * LevelFactor; i < last; ++i )
+			{
+				sum.add( from[i], peakFrames( l - 1, i ) );
+			}
+			to[p] = sum.peak();
+		}
+	}
+
+	// levels made by reserve() stay empty until there are frames for them
+	m_levels.clear();
+	for( std::size_t l = 0; l < m_ownLevels.size() && !m_ownLevels[l].empty(); ++l )
+	{
+		m_levels.push_back( m_ownLevels[l].data() );
+	}
+}
+
+
+
+
+void SamplePeaks::reserve( f_cnt_t frames )
+{
+	std::size_t l = 0;
+	for( std::size_t n = levelSizeOf( frames, 0 ); n > 0;
+					n = n > 1 ? peaksOf( n, LevelFactor ) : 0 )
+	{
+		if( l == m_ownLevels.size() )
+		{
+			m_ownLevels.emplace_back();
+		}
+		m_ownLevels[l++].reserve( n );
+	}
+	m_levels.reserve( m_ownLevels.size() );
+}
+
+
+
+
+std::size_t SamplePeaks::levelSize( int level ) const
+{
+	return levelSizeOf( m_frames, level );
+}
+
+
+
+
+bool SamplePeaks::peak( f_cnt_t from, f_cnt_t to, Peak & peak ) const
+{
+	from = std::max( from, 0 );
+	to = std::min( to, m_frames );
+	if( from >= to )
+	{
+		return false;
+	}
+
+	// walk up the levels, merging the peaks at either end that don't
+	// make up a whole peak of the next level
+	PeakSum sum;
+	std::size_t first = from / BaseFrames;
+	std::size_t last = ( to - 1 ) / BaseFrames + 1;
+	for( int l = 0; first < last; ++l )
+	{
+		const Peak * peaks = level( l );
+		const bool top = l + 1 == levels();
+		for( ; first < last && ( top || first % LevelFactor != 0 ); ++first )
+		{
+			sum.add( peaks[first], peakFrames( l, first ) );
+		}
+		// the last peak of a level stands for the rest of the frames,
+		// however many peaks of the level before they are
+		for( ; first < last && last % LevelFactor != 0 && last != levelSize( l ); --last )
+		{
+			sum.add( peaks[last - 1], peakFrames( l, last - 1 ) );
+		}
+		if( first >= last )
+		{
+			break;
+		}
+		first /= LevelFactor;
+		last = peaksOf( last, LevelFactor );
+	}
+
+	peak = sum.peak();
+	return true;
+}
+
+
+
+
+std::size_t SamplePeaks::size( f_cnt_t frames )
+{
+	std::size_t total = 0;
+	for( std::size_t n = levelSizeOf( frames, 0 ); n > 0;
+					n = n > 1 ? peaksOf( n, LevelFactor ) : 0 )
+	{
+		total += n;
+	}
+	return total;
+}
+
+
+
+
+f_cnt_t SamplePeaks::peakFrames( int level, std::size_t index ) const
+{
+	std::size_t perPeak = BaseFrames;
+	for( int l = 0; l < level; ++l )
+	{
+		perPeak *= LevelFactor;
+	}
+	return static_cast<f_cnt_t>( std::min<std::size_t>( perPeak, m_frames - index * perPeak ) );
+}
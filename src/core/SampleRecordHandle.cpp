@@ -33,14 +33,21 @@
 #include "debug.h"
 
 
+// minutes of recording the peaks have room for, so the audio thread
+// doesn't allocate them
+static const int ReservedMinutes = 10;
+
+
 SampleRecordHandle::SampleRecordHandle( SampleTCO* tco ) :
 	PlayHandle( TypeSamplePlayHandle ),
+	m_peaks( new SamplePeaks ),
 	m_framesRecorded( 0 ),
 	m_minLength( tco->length() ),
 	m_track( tco->getTrack() ),
 	m_bbTrack( NULL ),
 	m_tco( tco )
 {
+	m_peaks->reserve( ReservedMinutes * 60 * Engine::mixer()->inputSampleRate() );
 }
 
 
@@ -130,6 +137,7 @@ void SampleRecordHandle::createSampleBuffer( SampleBuffer** sampleBuf )
 	// create according sample-buffer out of big buffer
 	*sampleBuf = new SampleBuffer( data, frames );
 	( *sampleBuf)->setSampleRate( Engine::mixer()->inputSampleRate() );
+	( *sampleBuf)->setPeaks( std::move( m_peaks ) );
 	delete[] data;
 }
 
@@ -148,6 +156,7 @@ void SampleRecordHandle::writeBuffer( const sampleFrame * _ab,
 		}
 	}
 	m_buffers.push_back( qMakePair( buf, _frames ) );
+	m_peaks->append( buf, _frames );
 }
 
 
@@ -0,0 +1,610 @@
+/*
+ * SampleStream.cpp - plays long audio files from disk
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "SampleStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
+#include "EventCount.h"
+#include "MemoryManager.h"
+
+
+class SampleStreamThread;
+
+
+namespace
+{
+
+// seconds decoded ahead of the playback position
+const int RingSeconds = 4;
+// seconds kept decoded after a cue point
+const int CueSeconds = 2;
+// frames decoded at once
+const f_cnt_t DecodeFrames = 4096;
+// frames scanned at once for the overview
+const f_cnt_t ScanFrames = 256 * SamplePeaks::BaseFrames;
+// scans between two notifications about new peaks
+const std::size_t ScansPerUpdate = 64;
+
+// guards s_streams, s_closing and s_thread, only held briefly, so
+// closing a stream doesn't wait for the others to decode
+QMutex s_mutex;
+std::vector<SampleStream *> s_streams;
+// closed streams the I/O thread hasn't deleted yet. Its capacity covers
+// all streams, so closing one doesn't allocate.
+std::vector<SampleStream *> s_closing;
+SampleStreamThread * s_thread = nullptr;
+EventCount s_work;
+
+}
+
+
+
+
+class SampleStreamThread : public QThread
+{
+public:
+	// set with s_mutex held when the thread isn't needed anymore
+	bool m_stop = false;
+
+private:
+	void run() override
+	{
+		MemoryManager::ThreadGuard mmThreadGuard; Q_UNUSED(mmThreadGuard);
+		std::vector<SampleStream *> streams;
+		std::vector<SampleStream *> closing;
+		while( true )
+		{
+			const unsigned int key = s_work.prepareWait();
+
+			s_mutex.lock();
+			streams.assign( s_streams.begin(), s_streams.end() );
+			closing.assign( s_closing.begin(), s_closing.end() );
+			s_closing.clear();
+			const bool stop = m_stop;
+			s_mutex.unlock();
+
+			// closed streams left s_streams before, so the last round
+			// was the last one to use them
+			for( SampleStream * stream : closing )
+			{
+				delete stream;
+			}
+
+			if( stop )
+			{
+				s_work.cancelWait();
+				return;
+			}
+
+			bool busy = false;
+			bool updated = false;
+			for( SampleStream * stream : streams )
+			{
+				busy = stream->service() || busy;
+				updated = updated || stream->m_overviewPending;
+			}
+			if( updated )
+			{
+				notifyOverviews();
+			}
+
+			if( busy )
+			{
+				s_work.cancelWait();
+			}
+			else
+			{
+				s_work.commitWait( key );
+			}
+		}
+	}
+
+	static void notifyOverviews()
+	{
+		// the owners of closed streams may be gone, so only streams still
+		// open are asked, and closing one waits for this
+		s_mutex.lock();
+		for( SampleStream * stream : s_streams )
+		{
+			if( stream->m_overviewPending )
+			{
+				stream->m_overviewPending = false;
+				stream->m_overviewUpdated();
+			}
+		}
+		s_mutex.unlock();
+	}
+} ;
+
+
+
+
+SampleStream::Ptr SampleStream::open( const QString & file, bool reversed,
+				int minSeconds, std::function<void()> overviewUpdated )
+{
+	// Use QFile to handle unicode file names on Windows
+	std::unique_ptr<QFile> f( new QFile( file ) );
+	if( !f->open( QIODevice::ReadOnly ) )
+	{
+		return nullptr;
+	}
+
+	SF_INFO info;
+	info.format = 0;
+	SNDFILE * sndFile = sf_open_fd( f->handle(), SFM_READ, &info, false );
+	if( sndFile == nullptr )
+	{
+		return nullptr;
+	}
+	if( !info.seekable || info.channels < 1 || info.samplerate <= 0 ||
+		info.frames < sf_count_t( minSeconds ) * info.samplerate ||
+		info.frames > std::numeric_limits<f_cnt_t>::max() )
+	{
+		sf_close( sndFile );
+		return nullptr;
+	}
+
+	Ptr stream( new SampleStream( std::move( f ), sndFile, info,
+					reversed, std::move( overviewUpdated ) ) );
+
+	s_mutex.lock();
+	s_streams.push_back( stream.get() );
+	s_closing.reserve( s_streams.size() + s_closing.size() );
+	if( s_thread == nullptr )
+	{
+		s_thread = new SampleStreamThread;
+		s_thread->start( QThread::HighPriority );
+	}
+	s_mutex.unlock();
+	s_work.notify();
+
+	return stream;
+}
+
+
+
+
+SampleStream::SampleStream( std::unique_ptr<QFile> file, SNDFILE * sndFile,
+				const SF_INFO & info, bool reversed,
+				std::function<void()> overviewUpdated ) :
+	m_file( std::move( file ) ),
+	m_sndFile( sndFile ),
+	m_frames( static_cast<f_cnt_t>( info.frames ) ),
+	m_sampleRate( info.samplerate ),
+	m_channels( info.channels ),
+	m_reversed( reversed ),
+	m_overviewUpdated( std::move( overviewUpdated ) ),
+	m_ringFrames( RingSeconds * info.samplerate ),
+	m_ring( MM_ALLOC( sampleFrame, m_ringFrames ) ),
+	m_origin( 0 ),
+	m_written( 0 ),
+	m_read( 0 ),
+	m_seekFrame( 0 ),
+	m_seekRequest( 0 ),
+	m_seekDone( 0 ),
+	m_requestedFrame( 0 ),
+	m_maxCueFrames( CueSeconds * info.samplerate ),
+	m_cue( MM_ALLOC( sampleFrame, m_maxCueFrames ) ),
+	m_cueRequest( 0 ),
+	m_cueStart( -1 ),
+	m_cueFrames( 0 ),
+	m_cueValid( false ),
+	m_cueReaders( 0 ),
+	m_filePos( 0 ),
+	m_decodeBuffer( DecodeFrames * info.channels ),
+	m_scanBuffer( MM_ALLOC( sampleFrame, ScanFrames ) ),
+	m_overviewPending( false )
+{
+	m_reading.clear();
+	m_peaks.reserve( m_frames );
+}
+
+
+
+
+void SampleStream::Closer::operator()( SampleStream * stream ) const
+{
+	s_mutex.lock();
+	s_streams.erase( std::find( s_streams.begin(), s_streams.end(), stream ) );
+	const bool queued = s_thread != nullptr;
+	if( queued )
+	{
+		s_closing.push_back( stream );
+	}
+	s_mutex.unlock();
+
+	if( queued )
+	{
+		s_work.notify();
+	}
+	else
+	{
+		// the I/O thread was stopped already
+		delete stream;
+	}
+}
+
+
+
+
+void SampleStream::finishClosing()
+{
+	s_mutex.lock();
+	SampleStreamThread * thread = s_thread;
+	if( thread )
+	{
+		thread->m_stop = true;
+	}
+	s_thread = nullptr;
+	s_mutex.unlock();
+
+	if( thread )
+	{
+		s_work.notify();
+		thread->wait();
+		delete thread;
+	}
+}
+
+
+
+
+SampleStream::~SampleStream()
+{
+	sf_close( m_sndFile );
+	MM_FREE( m_ring );
+	MM_FREE( m_cue );
+	MM_FREE( m_scanBuffer );
+}
+
+
+
+
+bool SampleStream::read( sampleFrame * dst, f_cnt_t index, f_cnt_t frames )
+{
+	if( m_reading.test_and_set( std::memory_order_acquire ) )
+	{
+		// another player reads right now
+		memset( dst, 0, frames * sizeof( sampleFrame ) );
+		return false;
+	}
+
+	bool complete = true;
+	while( frames > 0 )
+	{
+		f_cnt_t n = 0;
+		if( index < 0 || index >= m_frames )
+		{
+			n = index < 0 ? qMin( frames, -index ) : frames;
+			memset( dst, 0, n * sizeof( sampleFrame ) );
+		}
+		else if( ( n = readRing( dst, index, frames ) ) == 0 )
+		{
+			f_cnt_t cueEnd;
+			n = readCue( dst, index, frames, cueEnd );
+			if( n > 0 )
+			{
+				// let the ring continue where the cue ends
+				if( !expects( cueEnd ) )
+				{
+					requestSeek( cueEnd );
+				}
+			}
+			else
+			{
+				if( !expects( index ) )
+				{
+					requestSeek( index );
+				}
+				n = frames;
+				memset( dst, 0, n * sizeof( sampleFrame ) );
+				complete = false;
+			}
+		}
+		dst += n;
+		index += n;
+		frames -= n;
+	}
+
+	m_reading.clear( std::memory_order_release );
+	return complete;
+}
+
+
+
+
+void SampleStream::cue( f_cnt_t index )
+{
+	index = qBound( 0, index, m_frames - 1 );
+	if( m_cueRequest.exchange( index, std::memory_order_relaxed ) != index )
+	{
+		s_work.notify();
+	}
+}
+
+
+
+
+void SampleStream::visitPeaks(
+		const std::function<void( const SamplePeaks & )> & visit ) const
+{
+	QMutexLocker lock( &m_peaksMutex );
+	visit( m_peaks );
+}
+
+
+
+
+f_cnt_t SampleStream::readRing( sampleFrame * dst, f_cnt_t index, f_cnt_t frames )
+{
+	if( isSeekPending() )
+	{
+		return 0;
+	}
+
+	const f_cnt_t origin = m_origin.load( std::memory_order_relaxed );
+	const f_cnt_t written = m_written.load( std::memory_order_acquire );
+	const f_cnt_t read = m_read.load( std::memory_order_relaxed );
+	if( index < origin + read || index >= origin + written )
+	{
+		return 0;
+	}
+
+	const f_cnt_t offset = index - origin;
+	const f_cnt_t n = qMin( frames, written - offset );
+	const f_cnt_t pos = offset % m_ringFrames;
+	const f_cnt_t first = qMin( n, m_ringFrames - pos );
+	memcpy( dst, m_ring + pos, first * sizeof( sampleFrame ) );
+	memcpy( dst + first, m_ring, ( n - first ) * sizeof( sampleFrame ) );
+
+	// only the frames before index are done with, a resampling player
+	// reads some frames twice
+	m_read.store( offset, std::memory_order_release );
+	if( written - offset < m_ringFrames / 2 && origin + written < m_frames )
+	{
+		s_work.notify();
+	}
+
+	return n;
+}
+
+
+
+
+f_cnt_t SampleStream::readCue( sampleFrame * dst, f_cnt_t index, f_cnt_t frames,
+							f_cnt_t & cueEnd )
+{
+	f_cnt_t n = 0;
+
+	m_cueReaders.fetch_add( 1 );
+	if( m_cueValid.load() && index >= m_cueStart && index < m_cueStart + m_cueFrames )
+	{
+		cueEnd = m_cueStart + m_cueFrames;
+		n = qMin( frames, cueEnd - index );
+		memcpy( dst, m_cue + ( index - m_cueStart ), n * sizeof( sampleFrame ) );
+	}
+	m_cueReaders.fetch_sub( 1 );
+
+	return n;
+}
+
+
+
+
+bool SampleStream::isSeekPending() const
+{
+	return m_seekRequest.load( std::memory_order_relaxed ) !=
+				m_seekDone.load( std::memory_order_acquire );
+}
+
+
+
+
+bool SampleStream::expects( f_cnt_t index ) const
+{
+	// whether the ring is going to hold index soon, so waiting for it is
+	// better than starting over
+	if( isSeekPending() )
+	{
+		return index >= m_requestedFrame &&
+			index < m_requestedFrame + m_ringFrames / 2;
+	}
+
+	const f_cnt_t origin = m_origin.load( std::memory_order_relaxed );
+	return index >= origin + m_read.load( std::memory_order_relaxed ) &&
+		index < origin + m_written.load( std::memory_order_acquire ) + m_ringFrames / 2;
+}
+
+
+
+
+void SampleStream::requestSeek( f_cnt_t index )
+{
+	m_requestedFrame = index;
+	m_seekFrame.store( index, std::memory_order_relaxed );
+	m_seekRequest.fetch_add( 1, std::memory_order_release );
+	s_work.notify();
+}
+
+
+
+
+bool SampleStream::service()
+{
+	return seek() || loadCue() || fillRing() || scanOverview();
+}
+
+
+
+
+bool SampleStream::seek()
+{
+	const int request = m_seekRequest.load( std::memory_order_acquire );
+	if( request == m_seekDone.load( std::memory_order_relaxed ) )
+	{
+		return false;
+	}
+
+	m_origin.store( m_seekFrame.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+	m_written.store( 0, std::memory_order_relaxed );
+	m_read.store( 0, std::memory_order_relaxed );
+	m_seekDone.store( request, std::memory_order_release );
+	return true;
+}
+
+
+
+
+bool SampleStream::loadCue()
+{
+	const f_cnt_t cue = m_cueRequest.load( std::memory_order_relaxed );
+	if( cue == m_cueStart )
+	{
+		return false;
+	}
+
+	// wait for readers that saw the old cue
+	m_cueValid.store( false );
+	while( m_cueReaders.load() > 0 )
+	{
+		std::this_thread::yield();
+	}
+
+	m_cueStart = cue;
+	m_cueFrames = qMin( m_maxCueFrames, m_frames - cue );
+	decode( m_cue, m_cueStart, m_cueFrames );
+	m_cueValid.store( true );
+	return true;
+}
+
+
+
+
+bool SampleStream::fillRing()
+{
+	const f_cnt_t origin = m_origin.load( std::memory_order_relaxed );
+	const f_cnt_t written = m_written.load( std::memory_order_relaxed );
+	const f_cnt_t space = m_ringFrames - ( written - m_read.load( std::memory_order_acquire ) );
+	const f_cnt_t left = m_frames - ( origin + written );
+	const f_cnt_t n = qMin( qMin( space, left ), DecodeFrames );
+	// wait for room for a whole block unless it's the last one
+	if( n <= 0 || ( n < DecodeFrames && n < left ) )
+	{
+		return false;
+	}
+
+	const f_cnt_t pos = written % m_ringFrames;
+	const f_cnt_t first = qMin( n, m_ringFrames - pos );
+	decode( m_ring + pos, origin + written, first );
+	decode( m_ring, origin + written + first, n - first );
+	m_written.store( written + n, std::memory_order_release );
+	return true;
+}
+
+
+
+
+bool SampleStream::scanOverview()
+{
+	// only this thread adds peaks, so it can look at them unlocked
+	const f_cnt_t index = m_peaks.frames();
+	if( index >= m_frames )
+	{
+		return false;
+	}
+
+	const f_cnt_t frames = qMin( ScanFrames, m_frames - index );
+	decode( m_scanBuffer, index, frames );
+
+	m_peaksMutex.lock();
+	m_peaks.append( m_scanBuffer, frames );
+	m_peaksMutex.unlock();
+
+	if( m_overviewUpdated &&
+		( index + frames == m_frames || ( index / ScanFrames ) % ScansPerUpdate == 0 ) )
+	{
+		m_overviewPending = true;
+	}
+	return true;
+}
+
+
+
+
+void SampleStream::decode( sampleFrame * dst, f_cnt_t index, f_cnt_t frames )
+{
+	if( frames <= 0 )
+	{
+		return;
+	}
+
+	// the frames of a reversed stream are read forwards and turned around
+	const f_cnt_t pos = m_reversed ? m_frames - index - frames : index;
+	if( pos != m_filePos && sf_seek( m_sndFile, pos, SEEK_SET ) < 0 )
+	{
+		m_filePos = -1;
+		memset( dst, 0, frames * sizeof( sampleFrame ) );
+		return;
+	}
+
+	const int right = m_channels > 1 ? 1 : 0;
+	f_cnt_t done = 0;
+	while( done < frames )
+	{
+		const f_cnt_t todo = qMin( frames - done, DecodeFrames );
+		const f_cnt_t got = static_cast<f_cnt_t>(
+			sf_readf_float( m_sndFile, m_decodeBuffer.data(), todo ) );
+		const float * in = m_decodeBuffer.data();
+		for( f_cnt_t f = 0; f < qMax( got, 0 ); ++f, in += m_channels )
+		{
+			dst[done + f][0] = in[0];
+			dst[done + f][1] = in[right];
+		}
+		if( got < todo )
+		{
+			// the file is shorter than it claimed
+			memset( dst + done + qMax( got, 0 ), 0,
+				( frames - done - qMax( got, 0 ) ) * sizeof( sampleFrame ) );
+			m_filePos = -1;
+			break;
+		}
+		done += todo;
+	}
+	if( done == frames )
+	{
+		m_filePos = pos + frames;
+	}
+
+	if( m_reversed )
+	{
+		std::reverse( dst, dst + frames );
+	}
+}
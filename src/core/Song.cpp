@@ -30,6 +30,7 @@
 #include <QFileInfo>
 #include <QMessageBox>
 
+#include <algorithm>
 #include <functional>
 
 #include "AutomationTrack.h"
@@ -50,6 +51,7 @@
 #include "PianoRoll.h"
 #include "ProjectJournal.h"
 #include "ProjectNotes.h"
+#include "SampleLoader.h"
 #include "SongEditor.h"
 #include "TimeLineWidget.h"
 #include "PeakController.h"
@@ -89,6 +91,7 @@ Song::Song() :
 	m_loopPattern( false ),
 	m_elapsedTicks( 0 ),
 	m_elapsedBars( 0 ),
+	m_automationValid(false),
 	m_loopRenderCount(1),
 	m_loopRenderRemaining(1)
 {
@@ -192,6 +195,7 @@ void Song::savePos()
 void Song::processNextBuffer()
 {
 	m_vstSyncController.setPlaybackJumped( false );
+	m_automationValid = false;
 
 	// if not playing, nothing to do
 	if( m_playing == false )
@@ -391,10 +395,13 @@ void Song::processNextBuffer()
 			framesToPlay = framesLeft;
 		}
 
+		// automation is sample-exact, so it's processed for every part
+		// of a tick, not just where a tick starts
+		processAutomations(trackList, m_playPos[m_playMode], currentFrame,
+							framesPlayed, framesToPlay);
+
 		if( ( f_cnt_t ) currentFrame == 0 )
 		{
-			processAutomations(trackList, m_playPos[m_playMode], framesToPlay);
-
 			// loop through all tracks and play them
 			for( int i = 0; i < trackList.size(); ++i )
 			{
@@ -415,12 +422,9 @@ void Song::processNextBuffer()
 }
 
 
-void Song::processAutomations(const TrackList &tracklist, MidiTime timeStart, fpp_t)
+void Song::processAutomations(const TrackList &tracklist, MidiTime timeStart,
+				float currentFrame, f_cnt_t offset, fpp_t frames)
 {
-	AutomatedValueMap values;
-
-	QSet<const AutomatableModel*> recordedModels;
-
 	TrackContainer* container = this;
 	int tcoNum = -1;
 
@@ -442,39 +446,77 @@ void Song::processAutomations(const TrackList &tracklist, MidiTime timeStart, fp
 		return;
 	}
 
-	values = container->automatedValuesAt(timeStart, tcoNum);
-	TrackList tracks = container->tracks();
+	// the patterns only change with the tick, the parts of it just
+	// evaluate them at other offsets
+	if (!m_automationValid || timeStart != m_automationTime)
+	{
+		m_automationTime = timeStart;
+		m_automationValid = true;
+
+		recordAutomation(container, timeStart, currentFrame);
+		container->collectAutomation(timeStart, tcoNum, m_automation);
+		auto& automation = m_automation.automation;
+		automation.erase(std::remove_if(automation.begin(), automation.end(),
+			[this](const ActiveAutomation& a)
+			{
+				return std::find(m_recordedModels.begin(), m_recordedModels.end(),
+							a.model) != m_recordedModels.end();
+			}), automation.end());
+	}
 
-	Track::tcoVector tcos;
-	for (Track* track : tracks)
+	// the values at the first and the last frame, the frames between are
+	// ramped linearly which is exact for linear progressions and close
+	// enough for the few frames of a tick otherwise
+	const float framesPerTick = Engine::framesPerTick();
+	const float startOffset = currentFrame / framesPerTick;
+	const float endOffset = frames > 1 ? (currentFrame + frames - 1) / framesPerTick : startOffset;
+	for (const ActiveAutomation& automation : m_automation.automation)
+	{
+		float start;
+		float end;
+		automation.pattern->valuesAt(automation.time,
+				automation.held ? 0 : startOffset, automation.held ? 0 : endOffset,
+				start, end);
+		automation.model->setAutomatedValues(start, end, offset, frames);
+	}
+}
+
+
+void Song::recordAutomation(const TrackContainer* container, MidiTime time,
+				float currentFrame)
+{
+	m_automationTCOs.clear();
+	for (Track* track : container->tracks())
 	{
 		if (track->type() == Track::AutomationTrack) {
-			track->getTCOsInRange(tcos, 0, timeStart);
+			track->getTCOsInRange(m_automationTCOs, 0, time);
 		}
 	}
 
-	// Process recording
-	for (TrackContentObject* tco : tcos)
+	// Process recording, values are recorded once per tick
+	m_recordedModels.clear();
+	for (TrackContentObject* tco : m_automationTCOs)
 	{
 		auto p = dynamic_cast<AutomationPattern *>(tco);
-		MidiTime relTime = timeStart - p->startPosition();
+		MidiTime relTime = time - p->startPosition();
 		if (p->isRecording() && relTime >= 0 && relTime < p->length())
 		{
 			const AutomatableModel* recordedModel = p->firstObject();
-			p->recordValue(relTime, recordedModel->value<float>());
+			if ((f_cnt_t) currentFrame == 0) {
+				p->recordValue(relTime, recordedModel->value<float>());
+			}
 
-			recordedModels << recordedModel;
+			m_recordedModels.push_back(recordedModel);
 		}
 	}
+}
 
-	// Apply values
-	for (auto it = values.begin(); it != values.end(); it++)
-	{
-		if (! recordedModels.contains(it.key()))
-		{
-			it.key()->setAutomatedValue(it.value());
-		}
-	}
+
+void Song::addAutomation(MidiTime time, int tcoNum, bool held,
+				AutomationCollection& collection) const
+{
+	addAutomationFromTracks(m_globalAutomationTrack, tracks(), time, tcoNum, held,
+				collection, collection.tcos);
 }
 
 void Song::setModified(bool value)
@@ -871,12 +913,6 @@ AutomationPattern * Song::tempoAutomationPattern()
 }
 
 
-AutomatedValueMap Song::automatedValuesAt(MidiTime time, int tcoNum) const
-{
-	return TrackContainer::automatedValuesFromTracks(TrackList{m_globalAutomationTrack} << tracks(), time, tcoNum);
-}
-
-
 
 
 void Song::clearProject()
@@ -1066,6 +1102,9 @@ void Song::loadProject( const QString & fileName )
 
 	clearErrors();
 
+	// decode the samples on other threads meanwhile
+	SampleLoader sampleLoader( dataFile.content() );
+
 	Engine::mixer()->requestChangeInModel();
 
 	// get the header information from the DOM
@@ -1194,6 +1233,8 @@ void Song::loadProject( const QString & fileName )
 		return;
 	}
 
+	sampleLoader.report();
+
 	if ( hasErrors())
 	{
 		if ( gui )
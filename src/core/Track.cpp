@@ -37,8 +37,10 @@
 
 #include "Track.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <cstdlib>
+#include <limits>
 
 #include <QLayout>
 #include <QLinearGradient>
@@ -156,6 +158,10 @@ void TrackContentObject::movePosition( const MidiTime & pos )
 	{
 		Engine::mixer()->requestChangeInModel();
 		m_startPosition = newPos;
+		if( getTrack() )
+		{
+			getTrack()->invalidateTCOIndex();
+		}
 		Engine::mixer()->doneChangeInModel();
 		Engine::getSong()->updateLength();
 		emit positionChanged();
@@ -175,6 +181,10 @@ void TrackContentObject::movePosition( const MidiTime & pos )
 void TrackContentObject::changeLength( const MidiTime & length )
 {
 	m_length = length;
+	if( getTrack() )
+	{
+		getTrack()->invalidateTCOIndex();
+	}
 	Engine::getSong()->updateLength();
 	emit lengthChanged();
 }
@@ -2458,6 +2468,11 @@ Track::Track( TrackTypes type, TrackContainer * tc ) :
 					/*!< For controlling track soloing */
 	m_simpleSerializingMode( false ),
 	m_trackContentObjects(),        /*!< The track content objects (segments) */
+	m_tcoIndexValid( false ),
+	m_tcoIndexFirst( 0 ),
+	m_tcoIndexLast( 0 ),
+	m_tcoIndexStart( 0 ),
+	m_tcoIndexEnd( 0 ),
 	m_color( 0, 0, 0 ),
 	m_hasColor( false )
 {
@@ -2731,6 +2746,7 @@ void Track::loadSettings( const QDomElement & element )
 TrackContentObject * Track::addTCO( TrackContentObject * tco )
 {
 	m_trackContentObjects.push_back( tco );
+	invalidateTCOIndex();
 
 	emit trackContentObjectAdded( tco );
 
@@ -2752,6 +2768,7 @@ void Track::removeTCO( TrackContentObject * tco )
 	if( it != m_trackContentObjects.end() )
 	{
 		m_trackContentObjects.erase( it );
+		invalidateTCOIndex();
 		if( Engine::getSong() )
 		{
 			Engine::getSong()->updateLength();
@@ -2867,6 +2884,87 @@ void Track::getTCOsInRange( tcoVector & tcoV, const MidiTime & start,
 
 
 
+void Track::getTCOsToPlay( tcoVector & tcoV, const MidiTime & start,
+							const MidiTime & end )
+{
+	if( !m_tcoIndexValid.exchange( true ) )
+	{
+		rebuildTCOIndex();
+	}
+
+	// the TCOs to play lie between the first one ending at or after start
+	// and the last one starting at or before end - as the index is sorted
+	// by start and maxEnd never decreases, both bounds only move forward
+	// while the song plays
+	const tick_t s = start.getTicks();
+	const tick_t e = end.getTicks();
+	if( s < m_tcoIndexStart )
+	{
+		m_tcoIndexFirst = std::lower_bound( m_tcoIndex.begin(), m_tcoIndex.end(), s,
+			[]( const TCOIndexEntry & entry, tick_t t ) { return entry.maxEnd < t; } )
+			- m_tcoIndex.begin();
+	}
+	else
+	{
+		while( m_tcoIndexFirst < m_tcoIndex.size() && m_tcoIndex[m_tcoIndexFirst].maxEnd < s )
+		{
+			++m_tcoIndexFirst;
+		}
+	}
+	if( e < m_tcoIndexEnd )
+	{
+		m_tcoIndexLast = std::upper_bound( m_tcoIndex.begin(), m_tcoIndex.end(), e,
+			[]( tick_t t, const TCOIndexEntry & entry ) { return t < entry.start; } )
+			- m_tcoIndex.begin();
+	}
+	else
+	{
+		while( m_tcoIndexLast < m_tcoIndex.size() && m_tcoIndex[m_tcoIndexLast].start <= e )
+		{
+			++m_tcoIndexLast;
+		}
+	}
+	m_tcoIndexStart = s;
+	m_tcoIndexEnd = e;
+
+	for( std::size_t i = m_tcoIndexFirst; i < m_tcoIndexLast; ++i )
+	{
+		if( m_tcoIndex[i].end >= s )
+		{
+			tcoV.push_back( m_tcoIndex[i].tco );
+		}
+	}
+}
+
+
+
+
+void Track::rebuildTCOIndex()
+{
+	m_tcoIndex.clear();
+	for( TrackContentObject * tco : m_trackContentObjects )
+	{
+		m_tcoIndex.push_back( { tco, tco->startPosition().getTicks(),
+			tco->endPosition().getTicks(), 0 } );
+	}
+	std::stable_sort( m_tcoIndex.begin(), m_tcoIndex.end(),
+		[]( const TCOIndexEntry & a, const TCOIndexEntry & b ) { return a.start < b.start; } );
+
+	tick_t maxEnd = std::numeric_limits<tick_t>::min();
+	for( TCOIndexEntry & entry : m_tcoIndex )
+	{
+		maxEnd = qMax( maxEnd, entry.end );
+		entry.maxEnd = maxEnd;
+	}
+
+	// look the next range up from scratch
+	m_tcoIndexFirst = m_tcoIndexLast = 0;
+	m_tcoIndexStart = m_tcoIndexEnd = 0;
+}
+
+
+
+
 /*! \brief Swap the position of two trackContentObjects.
  *
  *  First, we arrange to swap the positions of the two TCOs in the
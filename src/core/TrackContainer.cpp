@@ -24,6 +24,8 @@
  */
 
 
+#include <algorithm>
+
 #include <QApplication>
 #include <QProgressDialog>
 #include <QDomElement>
@@ -248,18 +250,56 @@ bool TrackContainer::isEmpty() const
 
 
 
+void TrackContainer::collectAutomation(MidiTime time, int tcoNum,
+					AutomationCollection& collection) const
+{
+	collection.automation.clear();
+	addAutomation(time, tcoNum, false, collection);
+
+	// keep the pattern taking precedence for every model
+	auto& automation = collection.automation;
+	std::sort(automation.begin(), automation.end(),
+		[](const ActiveAutomation& a, const ActiveAutomation& b)
+		{
+			return a.model != b.model ? a.model < b.model : a.order > b.order;
+		});
+	automation.erase(std::unique(automation.begin(), automation.end(),
+		[](const ActiveAutomation& a, const ActiveAutomation& b)
+		{
+			return a.model == b.model;
+		}), automation.end());
+}
+
+
 AutomatedValueMap TrackContainer::automatedValuesAt(MidiTime time, int tcoNum) const
 {
-	return automatedValuesFromTracks(tracks(), time, tcoNum);
+	AutomationCollection collection;
+	collectAutomation(time, tcoNum, collection);
+
+	AutomatedValueMap valueMap;
+	for (const ActiveAutomation& automation : collection.automation)
+	{
+		valueMap[automation.model] = automation.pattern->valueAt(automation.time);
+	}
+	return valueMap;
 }
 
 
-AutomatedValueMap TrackContainer::automatedValuesFromTracks(const TrackList &tracks, MidiTime time, int tcoNum)
+void TrackContainer::addAutomation(MidiTime time, int tcoNum, bool held,
+					AutomationCollection& collection) const
 {
-	Track::tcoVector tcos;
+	addAutomationFromTracks(nullptr, tracks(), time, tcoNum, held, collection, collection.tcos);
+}
 
-	for (Track* track: tracks)
+
+void TrackContainer::addAutomationFromTracks(Track* globalTrack, const TrackList& tracks,
+				MidiTime time, int tcoNum, bool held,
+				AutomationCollection& collection, Track::tcoVector& tcos)
+{
+	tcos.clear();
+	for (int i = globalTrack ? -1 : 0; i < tracks.size(); ++i)
 	{
+		Track* track = i < 0 ? globalTrack : tracks[i];
 		if (track->isMuted()) {
 			continue;
 		}
@@ -273,18 +313,16 @@ AutomatedValueMap TrackContainer::automatedValuesFromTracks(const TrackList &tra
 				track->getTCOsInRange(tcos, 0, time);
 			} else {
 				Q_ASSERT(track->numOfTCOs() > tcoNum);
-				tcos << track->getTCO(tcoNum);
+				tcos.push_back(track->getTCO(tcoNum));
 			}
 		default:
 			break;
 		}
 	}
 
-	AutomatedValueMap valueMap;
-
 	Q_ASSERT(std::is_sorted(tcos.begin(), tcos.end(), TrackContentObject::comparePosition));
 
-	for(TrackContentObject* tco : tcos)
+	for (TrackContentObject* tco : tcos)
 	{
 		if (tco->isMuted() || tco->startPosition() > time) {
 			continue;
@@ -296,14 +334,16 @@ AutomatedValueMap TrackContainer::automatedValuesFromTracks(const TrackList &tra
 				continue;
 			}
 			MidiTime relTime = time - p->startPosition();
-			if (! p->getAutoResize()) {
-				relTime = qMin(relTime, p->length());
+			bool relHeld = held;
+			if (! p->getAutoResize() && relTime >= p->length()) {
+				relTime = p->length();
+				relHeld = true;
 			}
-			float value = p->valueAt(relTime);
 
 			for (AutomatableModel* model : p->objects())
 			{
-				valueMap[model] = value;
+				const int order = static_cast<int>(collection.automation.size());
+				collection.automation.push_back({model, p, relTime, relHeld, order});
 			}
 		}
 		else if (auto* bb = dynamic_cast<BBTCO *>(tco))
@@ -312,22 +352,18 @@ AutomatedValueMap TrackContainer::automatedValuesFromTracks(const TrackList &tra
 			auto bbContainer = Engine::getBBTrackContainer();
 
 			MidiTime bbTime = time - tco->startPosition();
-			bbTime = std::min(bbTime, tco->length());
+			bool bbHeld = held;
+			if (bbTime >= tco->length()) {
+				bbTime = tco->length();
+				bbHeld = true;
+			}
 			bbTime = bbTime % (bbContainer->lengthOfBB(bbIndex) * MidiTime::ticksPerBar());
 
-			auto bbValues = bbContainer->automatedValuesAt(bbTime, bbIndex);
-			for (auto it=bbValues.begin(); it != bbValues.end(); it++)
-			{
-				// override old values, bb track with the highest index takes precedence
-				valueMap[it.key()] = it.value();
-			}
-		}
-		else
-		{
-			continue;
+			// added after the patterns before it, bb track with the
+			// highest index takes precedence
+			static_cast<const TrackContainer*>(bbContainer)->addAutomation(
+						bbTime, bbIndex, bbHeld, collection);
 		}
 	}
-
-	return valueMap;
-};
+}
 
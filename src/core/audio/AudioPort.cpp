@@ -28,6 +28,7 @@
 #include "FxMixer.h"
 #include "Engine.h"
 #include "Mixer.h"
+#include "MixerWorkerThread.h"
 #include "MixHelpers.h"
 #include "BufferManager.h"
 
@@ -36,9 +37,15 @@ AudioPort::AudioPort( const QString & _name, bool _has_effect_chain,
 		FloatModel * volumeModel, FloatModel * panningModel,
 		BoolModel * mutedModel ) :
 	m_bufferUsage( false ),
+	m_hasOutput( false ),
 	m_portBuffer( BufferManager::acquire() ),
+	m_gains( BufferManager::acquire() ),
+	m_gainLeft( 1.0f ),
+	m_gainRight( 1.0f ),
 	m_extOutputEnabled( false ),
 	m_nextFxChannel( 0 ),
+	m_jobFxChannel( 0 ),
+	m_dependencies( 1 ),
 	m_name( "unnamed port" ),
 	m_effects( _has_effect_chain ? new EffectChain( NULL ) : NULL ),
 	m_volumeModel( volumeModel ),
@@ -57,6 +64,7 @@ AudioPort::~AudioPort()
 	setExtOutputEnabled( false );
 	Engine::mixer()->removeAudioPort( this );
 	BufferManager::release( m_portBuffer );
+	BufferManager::release( m_gains );
 }
 
 
@@ -101,10 +109,68 @@ bool AudioPort::processEffects()
 }
 
 
+
+
+void AudioPort::finishPeriod()
+{
+	m_cpuUsage.finishPeriod();
+	m_instrumentCpuUsage.finishPeriod();
+	if( m_effects )
+	{
+		m_effects->finishPeriod();
+	}
+}
+
+
+static inline void panningGains( float volume, float panning, float & left, float & right )
+{
+	const float v = volume * 0.01f;
+	const float p = panning * 0.01f;
+	left = ( p <= 0 ? 1.0f : 1.0f - p ) * v;
+	right = ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+}
+
+
+
+
+bool AudioPort::updateGains()
+{
+	// as of now there's no situation where we only have panning model but no volume model
+	if( !m_volumeModel )
+	{
+		return false;
+	}
+
+	const fpp_t fpp = Engine::mixer()->framesPerPeriod();
+	const ValueBuffer * volBuf = m_volumeModel->valueBuffer();
+	const ValueBuffer * panBuf = m_panningModel ? m_panningModel->valueBuffer() : nullptr;
+	const float volume = m_volumeModel->value();
+	const float panning = m_panningModel ? m_panningModel->value() : 0.0f;
+
+	if( !volBuf && !panBuf )
+	{
+		panningGains( volume, panning, m_gainLeft, m_gainRight );
+		return false;
+	}
+
+	for( f_cnt_t f = 0; f < fpp; ++f )
+	{
+		panningGains( volBuf ? volBuf->values()[f] : volume,
+				panBuf ? panBuf->values()[f] : panning,
+				m_gains[f][0], m_gains[f][1] );
+	}
+	return true;
+}
+
+
+
+
 void AudioPort::doProcessing()
 {
 	if( m_mutedModel && m_mutedModel->value() )
 	{
+		m_hasOutput = false;
+		Engine::fxMixer()->portProcessed( m_jobFxChannel );
 		return;
 	}
 
@@ -112,6 +178,12 @@ void AudioPort::doProcessing()
 
 	// clear the buffer
 	BufferManager::clear( m_portBuffer, fpp );
+	BufferManager::markSilent( m_portBuffer );
+
+	// volume and panning are applied while mixing in the play handles, so
+	// the port buffer needs no extra pass for them
+	bool gainsKnown = false;
+	bool sampleExactGains = false;
 
 	//qDebug( "Playhandles: %d", m_playHandles.size() );
 	for( PlayHandle * ph : m_playHandles ) // now we mix all playhandle buffers into the audioport buffer
@@ -120,111 +192,56 @@ void AudioPort::doProcessing()
 		{
 			if( ph->usesBuffer()
 				&& ( ph->type() == PlayHandle::TypeNotePlayHandle
-					|| !MixHelpers::isSilent( ph->buffer(), fpp ) ) )
+					|| !BufferManager::isSilent( ph->buffer() ) ) )
 			{
 				m_bufferUsage = true;
-				MixHelpers::add( m_portBuffer, ph->buffer(), fpp );
-			}
-			ph->releaseBuffer(); 	// gets rid of playhandle's buffer and sets
-									// pointer to null, so if it doesn't get re-acquired we know to skip it next time
-		}
-	}
-
-	if( m_bufferUsage )
-	{
-		// handle volume and panning
-		// has both vol and pan models
-		if( m_volumeModel && m_panningModel )
-		{
-			ValueBuffer * volBuf = m_volumeModel->valueBuffer();
-			ValueBuffer * panBuf = m_panningModel->valueBuffer();
-
-			// both vol and pan have s.ex.data:
-			if( volBuf && panBuf )
-			{
-				for( f_cnt_t f = 0; f < fpp; ++f )
+				if( !gainsKnown )
 				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					float p = panBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+					sampleExactGains = updateGains();
+					gainsKnown = true;
 				}
-			}
 
-			// only vol has s.ex.data:
-			else if( volBuf )
-			{
-				float p = m_panningModel->value() * 0.01f;
-				float l = ( p <= 0 ? 1.0f : 1.0f - p );
-				float r = ( p >= 0 ? 1.0f : 1.0f + p );
-				for( f_cnt_t f = 0; f < fpp; ++f )
+				if( sampleExactGains )
 				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= v * l;
-					m_portBuffer[f][1] *= v * r;
+					MixHelpers::addMultipliedByGains( m_portBuffer, ph->buffer(), m_gains, fpp );
 				}
-			}
-
-			// only pan has s.ex.data:
-			else if( panBuf )
-			{
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
+				else if( m_volumeModel )
 				{
-					float p = panBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
+					MixHelpers::addMultipliedStereo( m_portBuffer, ph->buffer(),
+									m_gainLeft, m_gainRight, fpp );
 				}
-			}
-
-			// neither has s.ex.data:
-			else
-			{
-				float p = m_panningModel->value() * 0.01f;
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
+				// if we have no volume model, we just pass the audio as is
+				else
 				{
-					m_portBuffer[f][0] *= ( p <= 0 ? 1.0f : 1.0f - p ) * v;
-					m_portBuffer[f][1] *= ( p >= 0 ? 1.0f : 1.0f + p ) * v;
-				}
-			}
-		}
-
-		// has vol model only
-		else if( m_volumeModel )
-		{
-			ValueBuffer * volBuf = m_volumeModel->valueBuffer();
-
-			if( volBuf )
-			{
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					float v = volBuf->values()[ f ] * 0.01f;
-					m_portBuffer[f][0] *= v;
-					m_portBuffer[f][1] *= v;
-				}
-			}
-			else
-			{
-				float v = m_volumeModel->value() * 0.01f;
-				for( f_cnt_t f = 0; f < fpp; ++f )
-				{
-					m_portBuffer[f][0] *= v;
-					m_portBuffer[f][1] *= v;
+					MixHelpers::add( m_portBuffer, ph->buffer(), fpp );
 				}
 			}
+			ph->releaseBuffer(); 	// gets rid of playhandle's buffer and sets
+									// pointer to null, so if it doesn't get re-acquired we know to skip it next time
 		}
 	}
-	// as of now there's no situation where we only have panning model but no volume model
-	// if we have neither, we don't have to do anything here - just pass the audio as is
 
 	// handle effects
 	const bool me = processEffects();
-	if( me || m_bufferUsage )
+	if( m_bufferUsage || m_effects )
+	{
+		BufferManager::invalidate( m_portBuffer );
+	}
+	// the fx mixer channel pulls our buffer once it's processed
+	m_hasOutput = me || m_bufferUsage;
+	m_bufferUsage = false;
+
+	Engine::fxMixer()->portProcessed( m_jobFxChannel );
+}
+
+
+
+
+void AudioPort::dependencyMet()
+{
+	if( --m_dependencies == 0 )
 	{
-		Engine::fxMixer()->mixToChannel( m_portBuffer, m_nextFxChannel ); 	// send output to fx mixer
-																			// TODO: improve the flow here - convert to pull model
-		m_bufferUsage = false;
+		MixerWorkerThread::addJob( this );
 	}
 }
 
@@ -69,6 +69,8 @@
 #include "OutputSettings.h"
 #include "ProjectRenderer.h"
 #include "RenderManager.h"
+#include "SampleCache.h"
+#include "SampleStream.h"
 #include "Song.h"
 #include "SetupDialog.h"
 
@@ -205,6 +207,8 @@ void printHelp()
 		"          If not specified, render will overwrite the input file\n"
 		"          For \"rendertracks\", this might be required\n"
 		"  -p, --profile <out>            Dump profiling information to file <out>\n"
+		"          Contains render times per period and a summary of missed deadlines\n"
+		"          and the CPU usage of every track, effect and FX channel\n"
 		"  -s, --samplerate <samplerate>  Specify output samplerate in Hz\n"
 		"          Range: 44100 (default) to 192000\n"
 		"  -x, --oversampling <value>     Specify oversampling\n"
@@ -1011,6 +1015,8 @@ int main( int argc, char * * argv )
 
 
 	NotePlayHandleManager::free();
+	SampleCache::finishWriting();
+	SampleStream::finishClosing();
 
 	return ret;
 }
@@ -300,6 +300,7 @@ void AutomationPatternView::paintEvent( QPaintEvent * )
 	lin2grad.setColorAt( 0, col.darker( 150 ) );
 
 	p.setRenderHints( QPainter::Antialiasing, true );
+	std::vector<float> values;
 	for( AutomationPattern::timeMap::const_iterator it =
 						m_pat->getTimeMap().begin();
 					it != m_pat->getTimeMap().end(); ++it )
@@ -320,7 +321,7 @@ void AutomationPatternView::paintEvent( QPaintEvent * )
 			break;
 		}
 
-		float *values = m_pat->valuesAfter( it.key() );
+		m_pat->valuesAfter( it.key(), values );
 
 		float nextValue;
 		if( m_pat->progressionType() == AutomationPattern::DiscreteProgression )
@@ -357,7 +358,6 @@ void AutomationPatternView::paintEvent( QPaintEvent * )
 		{
 			p.fillPath( path, col );
 		}
-		delete [] values;
 	}
 
 	p.setRenderHints( QPainter::Antialiasing, false );
@@ -71,6 +71,7 @@
 
 
 constexpr int BUFFERSIZE_RESOLUTION = 32;
+constexpr int VOICEBUDGET_RESOLUTION = 16;
 
 inline void labelWidget(QWidget * w, const QString & txt)
 {
@@ -129,6 +130,8 @@ SetupDialog::SetupDialog(ConfigTabs tab_to_open) :
 			"ui", "smoothscroll").toInt()),
 	m_animateAFP(ConfigManager::inst()->value(
 			"ui", "animateafp", "1").toInt()),
+	m_voiceBudget(ConfigManager::inst()->value(
+			"mixer", "voicebudget").toInt()),
 	m_vstEmbedMethod(ConfigManager::inst()->vstEmbedMethod()),
 	m_vstAlwaysOnTop(ConfigManager::inst()->value(
 			"ui", "vstalwaysontop").toInt()),
@@ -386,6 +389,30 @@ SetupDialog::SetupDialog(ConfigTabs tab_to_open) :
 	ui_fx_tw->setFixedHeight(YDelta + YDelta * counter);
 
 
+	// Voice budget tab.
+	TabWidget * voice_budget_tw = new TabWidget(
+			tr("Voice budget"), performance_w);
+	voice_budget_tw->setFixedHeight(76);
+
+	m_voiceBudgetSlider = new QSlider(Qt::Horizontal, voice_budget_tw);
+	m_voiceBudgetSlider->setRange(0, PlayHandle::MaxNumber / VOICEBUDGET_RESOLUTION);
+	m_voiceBudgetSlider->setTickInterval(4);
+	m_voiceBudgetSlider->setPageStep(4);
+	m_voiceBudgetSlider->setValue(m_voiceBudget / VOICEBUDGET_RESOLUTION);
+	m_voiceBudgetSlider->setGeometry(10, 18, 340, 18);
+	m_voiceBudgetSlider->setTickPosition(QSlider::TicksBelow);
+	ToolTip::add(m_voiceBudgetSlider,
+			tr("When playback is about to stutter, the least audible "
+				"voices beyond this number are faded out"));
+
+	connect(m_voiceBudgetSlider, SIGNAL(valueChanged(int)),
+			this, SLOT(setVoiceBudget(int)));
+
+	m_voiceBudgetLbl = new QLabel(voice_budget_tw);
+	m_voiceBudgetLbl->setGeometry(10, 40, 200, 24);
+	setVoiceBudget(m_voiceBudgetSlider->value());
+
+
 	counter = 0;
 
 	// Plugins tab.
@@ -439,6 +466,7 @@ SetupDialog::SetupDialog(ConfigTabs tab_to_open) :
 	// Performance layout ordering.
 	performance_layout->addWidget(auto_save_tw);
 	performance_layout->addWidget(ui_fx_tw);
+	performance_layout->addWidget(voice_budget_tw);
 	performance_layout->addWidget(plugins_tw);
 	performance_layout->addStretch();
 
@@ -936,6 +964,9 @@ void SetupDialog::accept()
 					QString::number(m_smoothScroll));
 	ConfigManager::inst()->setValue("ui", "animateafp",
 					QString::number(m_animateAFP));
+	ConfigManager::inst()->setValue("mixer", "voicebudget",
+					QString::number(m_voiceBudget));
+	Engine::mixer()->setVoiceBudget(m_voiceBudget);
 	ConfigManager::inst()->setValue("ui", "vstembedmethod",
 					m_vstEmbedComboBox->currentData().toString());
 	ConfigManager::inst()->setValue("ui", "vstalwaysontop",
@@ -1116,6 +1147,15 @@ void SetupDialog::toggleAnimateAFP(bool enabled)
 }
 
 
+void SetupDialog::setVoiceBudget(int value)
+{
+	m_voiceBudget = value * VOICEBUDGET_RESOLUTION;
+	m_voiceBudgetLbl->setText(m_voiceBudget > 0
+		? tr("Voice budget: %1 voices").arg(m_voiceBudget)
+		: tr("Voice budget: Unlimited"));
+}
+
+
 void SetupDialog::toggleSyncVSTPlugins(bool enabled)
 {
 	m_syncVSTPlugins = enabled;
@@ -1359,6 +1359,7 @@ void AutomationEditor::paintEvent(QPaintEvent * pe )
 		//Don't bother doing/rendering anything if there is no automation points
 		if( time_map.size() > 0 )
 		{
+			std::vector<float> values;
 			timeMap::iterator it = time_map.begin();
 			while( it+1 != time_map.end() )
 			{
@@ -1398,7 +1399,7 @@ void AutomationEditor::paintEvent(QPaintEvent * pe )
 					is_selected = true;
 				}*/
 
-				float *values = m_pattern->valuesAfter( it.key() );
+				m_pattern->valuesAfter( it.key(), values );
 
 				float nextValue;
 				if( m_pattern->progressionType() == AutomationPattern::DiscreteProgression )
@@ -1424,7 +1425,6 @@ void AutomationEditor::paintEvent(QPaintEvent * pe )
 				path.lineTo( QPointF( xCoordOfTick( it.key() ), yCoordOfLevel( 0 ) ) );
 				p.fillPath( path, graphColor() );
 				p.setRenderHints( QPainter::Antialiasing, false );
-				delete [] values;
 
 				// Draw circle
 				drawAutomationPoint(p, it);
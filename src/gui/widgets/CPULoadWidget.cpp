@@ -24,6 +24,7 @@
  */
 
 
+#include <QCoreApplication>
 #include <QPainter>
 
 #include "CPULoadWidget.h"
@@ -89,6 +90,19 @@ void CPULoadWidget::paintEvent( QPaintEvent *  )
 
 
 
+bool CPULoadWidget::event( QEvent * _ev )
+{
+	// the statistics only matter when they're looked at
+	if( _ev->type() == QEvent::ToolTip )
+	{
+		updateToolTip();
+	}
+	return QWidget::event( _ev );
+}
+
+
+
+
 void CPULoadWidget::updateCpuLoad()
 {
 	// smooth load-values a bit
@@ -104,5 +118,32 @@ void CPULoadWidget::updateCpuLoad()
 
 
 
+void CPULoadWidget::updateToolTip()
+{
+	// what we need to find out which part of the processing causes dropouts
+	const MixerProfiler & profiler = Engine::mixer()->profiler();
+	QString text = tr( "CPU load: %1%" ).arg( profiler.cpuLoad() ) + "\n" +
+		tr( "Missed deadlines: %1 of %2 periods" )
+			.arg( profiler.deadlineMisses() ).arg( profiler.periods() ) + "\n" +
+		tr( "Last period: %1 of %2 us, longest: %3 us" )
+			.arg( profiler.lastPeriodTime() ).arg( profiler.periodDeadline() )
+			.arg( profiler.maxPeriodTime() );
+
+	for( int i = 0; i < static_cast<int>( MixerProfiler::DetailType::Count ); ++i )
+	{
+		const auto type = static_cast<MixerProfiler::DetailType>( i );
+		text += "\n" + tr( "%1: %2 us" )
+			.arg( QCoreApplication::translate( "MixerProfiler", MixerProfiler::detailName( type ) ) )
+			.arg( profiler.detailTime( type ) );
+	}
 
+	for( int worker = 0; worker < profiler.workerCount(); ++worker )
+	{
+		const int64_t busy = profiler.workerBusyTime( worker );
+		const int64_t total = busy + profiler.workerIdleTime( worker );
+		text += "\n" + tr( "Thread %1 busy: %2%" ).arg( worker )
+					.arg( total > 0 ? busy * 100 / total : 0 );
+	}
 
+	setToolTip( text );
+}
@@ -30,9 +30,11 @@
 #include <QGraphicsProxyWidget>
 
 #include "CaptionMenu.h"
+#include "Effect.h"
 #include "FxMixer.h"
 #include "gui_templates.h"
 #include "GuiApplication.h"
+#include "Mixer.h"
 #include "Song.h"
 
 bool FxLine::eventFilter( QObject *dist, QEvent *event )
@@ -139,6 +141,28 @@ FxLine::~FxLine()
 
 
 
+bool FxLine::event( QEvent * _e )
+{
+	// build the tooltip when it's shown, so the CPU usage is up to date
+	if( _e->type() == QEvent::ToolTip )
+	{
+		const FxChannel * ch = Engine::fxMixer()->effectChannel( m_channelIndex );
+		const float periodTime = Engine::mixer()->periodTime();
+		QString tip = ch->m_name + "\n" +
+				tr( "CPU: %1" ).arg( ch->m_cpuUsage.toString( periodTime ) );
+		for( const Effect * effect : ch->m_fxChain.effects() )
+		{
+			tip += "\n" + QString( "%1: %2" ).arg( effect->displayName(),
+					effect->cpuUsage().toString( periodTime ) );
+		}
+		setToolTip( tip );
+	}
+	return QWidget::event( _e );
+}
+
+
+
+
 void FxLine::setChannelIndex( int index )
 {
 	m_channelIndex = index;
@@ -28,6 +28,7 @@
 #include <QLayout>
 
 #include "InstrumentMidiIOView.h"
+#include "ComboBox.h"
 #include "MidiPortMenu.h"
 #include "Engine.h"
 #include "embed.h"
@@ -226,6 +227,28 @@ InstrumentMiscView::InstrumentMiscView(InstrumentTrack *it, QWidget *parent) :
 	tlabel->setFont( pointSize<8>( tlabel->font() ) );
 	m_pitchGroupBox->setModel( &it->m_useMasterPitchModel );
 	masterPitchLayout->addWidget( tlabel );
+
+	m_polyphonyGroupBox = new GroupBox( tr( "LIMIT POLYPHONY" ) );
+	layout->addWidget( m_polyphonyGroupBox );
+	QHBoxLayout* polyphonyLayout = new QHBoxLayout( m_polyphonyGroupBox );
+	polyphonyLayout->setContentsMargins( 8, 18, 8, 8 );
+	polyphonyLayout->setSpacing( 4 );
+	m_polyphonyGroupBox->setModel( &it->m_limitVoicesModel );
+
+	m_maxVoicesSpinBox = new LcdSpinBox( 3, m_polyphonyGroupBox );
+	/*: This string must be be short, its width must be less than
+	 *  width of LCD spin-box of three digits */
+	m_maxVoicesSpinBox->setLabel( tr( "VOICES" ) );
+	m_maxVoicesSpinBox->setModel( &it->m_maxVoicesModel );
+	polyphonyLayout->addWidget( m_maxVoicesSpinBox );
+
+	m_voiceStealingComboBox = new ComboBox( m_polyphonyGroupBox );
+	m_voiceStealingComboBox->setFixedSize( 100, ComboBox::DEFAULT_HEIGHT );
+	m_voiceStealingComboBox->setToolTip( tr( "Voices to fade out when there are too many" ) );
+	m_voiceStealingComboBox->setModel( &it->m_voiceStealingModel );
+	polyphonyLayout->addWidget( m_voiceStealingComboBox );
+	polyphonyLayout->addStretch();
+
 	layout->addStretch();
 }
 
@@ -29,11 +29,15 @@
 #include <QApplication>
 #include <QMouseEvent>
 
+#include "AudioPort.h"
 #include "ConfigManager.h"
+#include "Effect.h"
+#include "EffectChain.h"
 #include "embed.h"
 #include "Engine.h"
 #include "Instrument.h"
 #include "InstrumentTrack.h"
+#include "Mixer.h"
 #include "RenameDialog.h"
 #include "Song.h"
 #include "TrackRenameLineEdit.h"
@@ -133,6 +137,40 @@ void TrackLabelButton::nameChanged()
 
 
 
+bool TrackLabelButton::event( QEvent * _e )
+{
+	// build the tooltip when it's shown, so the CPU usage is up to date
+	if( _e->type() == QEvent::ToolTip )
+	{
+		Track * track = m_trackView->getTrack();
+		QString tip = track->name();
+		AudioPort * port = track->audioPort();
+		if( port )
+		{
+			const float periodTime = Engine::mixer()->periodTime();
+			tip += "\n" + tr( "CPU: %1" ).arg( port->cpuUsage().toString( periodTime ) );
+			if( track->type() == Track::InstrumentTrack )
+			{
+				tip += "\n" + tr( "Instrument: %1" ).arg(
+						port->instrumentCpuUsage().toString( periodTime ) );
+			}
+			if( port->effects() )
+			{
+				for( const Effect * effect : port->effects()->effects() )
+				{
+					tip += "\n" + QString( "%1: %2" ).arg( effect->displayName(),
+							effect->cpuUsage().toString( periodTime ) );
+				}
+			}
+		}
+		setToolTip( tip );
+	}
+	return QToolButton::event( _e );
+}
+
+
+
+
 void TrackLabelButton::dragEnterEvent( QDragEnterEvent * _dee )
 {
 	m_trackView->dragEnterEvent( _dee );
@@ -344,8 +344,9 @@ bool BBTrack::play( const MidiTime & _start, const fpp_t _frames,
 		return Engine::getBBTrackContainer()->play( _start, _frames, _offset, s_infoMap[this] );
 	}
 
-	tcoVector tcos;
-	getTCOsInRange( tcos, _start, _start + static_cast<int>( _frames / Engine::framesPerTick() ) );
+	tcoVector & tcos = m_tcosToPlay;
+	tcos.clear();
+	getTCOsToPlay( tcos, _start, _start + static_cast<int>( _frames / Engine::framesPerTick() ) );
 
 	if( tcos.size() == 0 )
 	{
@@ -37,6 +37,8 @@
 #include <QMdiSubWindow>
 #include <QPainter>
 
+#include <algorithm>
+
 #include "FileDialog.h"
 #include "AutomationPattern.h"
 #include "BBTrack.h"
@@ -58,6 +60,7 @@
 #include "InstrumentFunctionViews.h"
 #include "InstrumentMidiIOView.h"
 #include "Knob.h"
+#include "ComboBox.h"
 #include "LcdSpinBox.h"
 #include "LedCheckbox.h"
 #include "LeftRightNav.h"
@@ -98,10 +101,14 @@ InstrumentTrack::InstrumentTrack( TrackContainer* tc ) :
 	m_volumeModel( DefaultVolume, MinVolume, MaxVolume, 0.1f, this, tr( "Volume" ) ),
 	m_panningModel( DefaultPanning, PanningLeft, PanningRight, 0.1f, this, tr( "Panning" ) ),
 	m_audioPort( tr( "unnamed_track" ), true, &m_volumeModel, &m_panningModel, &m_mutedModel ),
+	m_noteBatch( this ),
 	m_pitchModel( 0, MinPitchDefault, MaxPitchDefault, 1, this, tr( "Pitch" ) ),
 	m_pitchRangeModel( 1, 1, 60, this, tr( "Pitch range" ) ),
 	m_effectChannelModel( 0, 0, 0, this, tr( "FX channel" ) ),
 	m_useMasterPitchModel( true, this, tr( "Master pitch") ),
+	m_limitVoicesModel( false, this, tr( "Limit polyphony" ) ),
+	m_maxVoicesModel( 32, 1, 256, this, tr( "Maximum voices" ) ),
+	m_voiceStealingModel( this, tr( "Voice stealing" ) ),
 	m_instrument( NULL ),
 	m_soundShaping( this ),
 	m_arpeggio( this ),
@@ -114,6 +121,10 @@ InstrumentTrack::InstrumentTrack( TrackContainer* tc ) :
 
 	m_effectChannelModel.setRange( 0, Engine::fxMixer()->numChannels()-1, 1);
 
+	m_voiceStealingModel.addItem( tr( "Oldest" ) );
+	m_voiceStealingModel.addItem( tr( "Quietest" ) );
+	m_voiceStealingModel.addItem( tr( "Same key" ) );
+
 	for( int i = 0; i < NumKeys; ++i )
 	{
 		m_notes[i] = NULL;
@@ -324,6 +335,8 @@ void InstrumentTrack::processInEvent( const MidiEvent& event, const MidiTime& ti
 				}
 				else if (isSustainPedalPressed())
 				{
+					// sustained notes may be deleted by the mixer when stolen
+					Engine::mixer()->requestChangeInModel();
 					for (NotePlayHandle* nph : m_sustainedNotes)
 					{
 						if (nph && nph->isReleased())
@@ -341,6 +354,7 @@ void InstrumentTrack::processInEvent( const MidiEvent& event, const MidiTime& ti
 					}
 					m_sustainedNotes.clear();
 					m_sustainPedalPressed = false;
+					Engine::mixer()->doneChangeInModel();
 				}
 			}
 			if( event.controllerNumber() == MidiControllerAllSoundOff ||
@@ -489,16 +503,99 @@ f_cnt_t InstrumentTrack::beatLen( NotePlayHandle * _n ) const
 
 
 void InstrumentTrack::playNote( NotePlayHandle* n, sampleFrame* workingBuffer )
+{
+	if( processNoteFunctions( n ) )
+	{
+		// all is done, so now lets play the note!
+		m_instrument->playNote( n, workingBuffer );
+	}
+}
+
+
+
+
+bool InstrumentTrack::processNoteFunctions( NotePlayHandle* n )
 {
 	// arpeggio- and chord-widget has to do its work -> adding sub-notes
 	// for chords/arpeggios
 	m_noteStacking.processNote( n );
 	m_arpeggio.processNote( n );
 
-	if( n->isMasterNote() == false && m_instrument != NULL )
+	return n->isMasterNote() == false && m_instrument != NULL;
+}
+
+
+
+
+NoteBatch* InstrumentTrack::noteBatch()
+{
+	// single streamed instruments mix their notes on their own
+	if( m_instrument != NULL &&
+		( m_instrument->flags() & ( Instrument::IsBatchRendered | Instrument::IsSingleStreamed ) ) ==
+			Instrument::IsBatchRendered )
 	{
-		// all is done, so now lets play the note!
-		m_instrument->playNote( n, workingBuffer );
+		return &m_noteBatch;
+	}
+	return NULL;
+}
+
+
+
+
+void InstrumentTrack::stealVoices( NotePlayHandle * * voices, int count )
+{
+	if( !m_limitVoicesModel.value() )
+	{
+		return;
+	}
+	int excess = count - m_maxVoicesModel.value();
+	if( excess <= 0 )
+	{
+		return;
+	}
+
+	NotePlayHandle * * const end = voices + count;
+	const int mode = m_voiceStealingModel.value();
+
+	if( mode == StealSameKey )
+	{
+		// new notes replace the voices already playing their key
+		for( NotePlayHandle * * n = voices; n != end && excess > 0; ++n )
+		{
+			if( ( *n )->totalFramesPlayed() > 0 )
+			{
+				continue;
+			}
+			for( NotePlayHandle * * v = voices; v != end; ++v )
+			{
+				if( ( *v )->key() == ( *n )->key() && ( *v )->totalFramesPlayed() > 0 &&
+					!( *v )->isFadingOut() )
+				{
+					( *v )->fadeOut();
+					--excess;
+					break;
+				}
+			}
+		}
+	}
+
+	// steal released voices first, then the oldest or quietest ones
+	NotePlayHandle * * const candidates = std::partition( voices, end,
+		[]( const NotePlayHandle * n ) { return n->isFadingOut(); } );
+	std::sort( candidates, end,
+		[mode]( const NotePlayHandle * a, const NotePlayHandle * b )
+		{
+			if( a->isReleased() != b->isReleased() )
+			{
+				return a->isReleased();
+			}
+			return mode == StealQuietest
+				? a->lastPeak() < b->lastPeak()
+				: a->totalFramesPlayed() > b->totalFramesPlayed();
+		} );
+	for( NotePlayHandle * * v = candidates; v != end && excess > 0; ++v, --excess )
+	{
+		( *v )->fadeOut();
 	}
 }
 
@@ -617,7 +714,8 @@ bool InstrumentTrack::play( const MidiTime & _start, const fpp_t _frames,
 	}
 	const float frames_per_tick = Engine::framesPerTick();
 
-	tcoVector tcos;
+	tcoVector & tcos = m_tcosToPlay;
+	tcos.clear();
 	::BBTrack * bb_track = NULL;
 	if( _tco_num >= 0 )
 	{
@@ -630,7 +728,7 @@ bool InstrumentTrack::play( const MidiTime & _start, const fpp_t _frames,
 	}
 	else
 	{
-		getTCOsInRange( tcos, _start, _start + static_cast<int>(
+		getTCOsToPlay( tcos, _start, _start + static_cast<int>(
 					_frames / frames_per_tick ) );
 	}
 
@@ -666,23 +764,11 @@ bool InstrumentTrack::play( const MidiTime & _start, const fpp_t _frames,
 			cur_start -= p->startPosition();
 		}
 
-		// get all notes from the given pattern...
+		// notes are sorted by position, so look up the first one
+		// starting at the current tick
 		const NoteVector & notes = p->notes();
-		// ...and set our index to zero
-		NoteVector::ConstIterator nit = notes.begin();
-
-		// very effective algorithm for playing notes that are
-		// posated within the current sample-frame
-
-
-		if( cur_start > 0 )
-		{
-			// skip notes which are posated before start-bar
-			while( nit != notes.end() && ( *nit )->pos() < cur_start )
-			{
-				++nit;
-			}
-		}
+		NoteVector::ConstIterator nit = std::lower_bound( notes.begin(), notes.end(), cur_start,
+			[]( const Note * note, const MidiTime & pos ) { return note->pos() < pos; } );
 
 		Note * cur_note;
 		while( nit != notes.end() &&
@@ -741,6 +827,9 @@ void InstrumentTrack::saveTrackSpecificSettings( QDomDocument& doc, QDomElement
 	m_effectChannelModel.saveSettings( doc, thisElement, "fxch" );
 	m_baseNoteModel.saveSettings( doc, thisElement, "basenote" );
 	m_useMasterPitchModel.saveSettings( doc, thisElement, "usemasterpitch");
+	m_limitVoicesModel.saveSettings( doc, thisElement, "limitvoices" );
+	m_maxVoicesModel.saveSettings( doc, thisElement, "maxvoices" );
+	m_voiceStealingModel.saveSettings( doc, thisElement, "voicestealing" );
 
 	if( m_instrument != NULL )
 	{
@@ -796,6 +885,9 @@ void InstrumentTrack::loadTrackSpecificSettings( const QDomElement & thisElement
 	}
 	m_baseNoteModel.loadSettings( thisElement, "basenote" );
 	m_useMasterPitchModel.loadSettings( thisElement, "usemasterpitch");
+	m_limitVoicesModel.loadSettings( thisElement, "limitvoices" );
+	m_maxVoicesModel.loadSettings( thisElement, "maxvoices" );
+	m_voiceStealingModel.loadSettings( thisElement, "voicestealing" );
 
 	// clear effect-chain just in case we load an old preset without FX-data
 	m_audioPort.effects()->clear();
@@ -1618,6 +1710,9 @@ void InstrumentTrackWindow::modelChanged()
 	m_midiView->setModel( &m_track->m_midiPort );
 	m_effectView->setModel( m_track->m_audioPort.effects() );
 	m_miscView->pitchGroupBox()->setModel(&m_track->m_useMasterPitchModel);
+	m_miscView->polyphonyGroupBox()->setModel( &m_track->m_limitVoicesModel );
+	m_miscView->maxVoicesSpinBox()->setModel( &m_track->m_maxVoicesModel );
+	m_miscView->voiceStealingComboBox()->setModel( &m_track->m_voiceStealingModel );
 	updateName();
 }
 
@@ -78,7 +78,7 @@ Pattern::Pattern( const Pattern& other ) :
 {
 	for( NoteVector::ConstIterator it = other.m_notes.begin(); it != other.m_notes.end(); ++it )
 	{
-		m_notes.push_back( new Note( **it ) );
+		m_notes.push_back( m_noteArena.create( **it ) );
 	}
 
 	init();
@@ -104,7 +104,7 @@ Pattern::~Pattern()
 	for( NoteVector::Iterator it = m_notes.begin();
 						it != m_notes.end(); ++it )
 	{
-		delete *it;
+		m_noteArena.destroy( *it );
 	}
 
 	m_notes.clear();
@@ -207,7 +207,7 @@ MidiTime Pattern::beatPatternLength() const
 
 Note * Pattern::addNote( const Note & _new_note, const bool _quant_pos )
 {
-	Note * new_note = new Note( _new_note );
+	Note * new_note = m_noteArena.create( _new_note );
 	if( _quant_pos && gui->pianoRoll() )
 	{
 		new_note->quantizePos( gui->pianoRoll()->quantization() );
@@ -217,8 +217,22 @@ Note * Pattern::addNote( const Note & _new_note, const bool _quant_pos )
 	m_notes.insert(std::upper_bound(m_notes.begin(), m_notes.end(), new_note, Note::lessThan), new_note);
 	instrumentTrack()->unlock();
 
-	checkType();
-	updateLength();
+	if( m_patternType == MelodyPattern )
+	{
+		// a new note can only make a melody pattern longer, so don't look
+		// at all other notes - adding many notes, e.g. when importing a
+		// MIDI file, would take quadratic time otherwise
+		if( new_note->length() > 0 && new_note->endPos() > length() )
+		{
+			changeLength( new_note->endPos().nextFullBar() * MidiTime::ticksPerBar() );
+			updateBBTrack();
+		}
+	}
+	else
+	{
+		checkType();
+		updateLength();
+	}
 
 	emit dataChanged();
 
@@ -236,7 +250,7 @@ void Pattern::removeNote( Note * _note_to_del )
 	{
 		if( *it == _note_to_del )
 		{
-			delete *it;
+			m_noteArena.destroy( *it );
 			m_notes.erase( it );
 			break;
 		}
@@ -283,7 +297,7 @@ void Pattern::clearNotes()
 	for( NoteVector::Iterator it = m_notes.begin(); it != m_notes.end();
 									++it )
 	{
-		delete *it;
+		m_noteArena.destroy( *it );
 	}
 	m_notes.clear();
 	instrumentTrack()->unlock();
@@ -418,7 +432,7 @@ void Pattern::loadSettings( const QDomElement & _this )
 		if( node.isElement() &&
 			!node.toElement().attribute( "metadata" ).toInt() )
 		{
-			Note * n = new Note;
+			Note * n = m_noteArena.create();
 			n->restoreState( node.toElement() );
 			m_notes.push_back( n );
 		}
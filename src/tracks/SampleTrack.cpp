@@ -59,6 +59,9 @@ SampleTCO::SampleTCO( Track * _track ) :
 	m_sampleBuffer( new SampleBuffer ),
 	m_isPlaying( false )
 {
+	m_sampleBuffer->setStreamingEnabled( true );
+	connect( m_sampleBuffer, SIGNAL( sampleUpdated() ), this, SIGNAL( sampleChanged() ) );
+
 	saveJournallingState( false );
 	setSampleFile( "" );
 	restoreJournallingState();
@@ -144,6 +147,7 @@ void SampleTCO::setSampleBuffer( SampleBuffer* sb )
 	sharedObject::unref( m_sampleBuffer );
 	Engine::mixer()->doneChangeInModel();
 	m_sampleBuffer = sb;
+	connect( m_sampleBuffer, SIGNAL( sampleUpdated() ), this, SIGNAL( sampleChanged() ) );
 	updateLength();
 
 	emit sampleChanged();
@@ -190,6 +194,7 @@ void SampleTCO::playbackPositionChanged()
 	Engine::mixer()->removePlayHandlesOfTypes( getTrack(), PlayHandle::TypeSamplePlayHandle );
 	SampleTrack * st = dynamic_cast<SampleTrack*>( getTrack() );
 	st->setPlayingTcos( false );
+	prefetch( Engine::getSong()->getPlayPos( Song::Mode_PlaySong ) );
 }
 
 
@@ -233,7 +238,21 @@ void SampleTCO::updateLength()
 
 MidiTime SampleTCO::sampleLength() const
 {
-	return (int)( m_sampleBuffer->frames() / Engine::framesPerTick() );
+	return (int)( m_sampleBuffer->frames() /
+			Engine::framesPerTick( m_sampleBuffer->sampleRate() ) );
+}
+
+
+
+
+void SampleTCO::prefetch( const MidiTime & time )
+{
+	if( time >= startPosition() && time < endPosition() )
+	{
+		const float framesPerTick = Engine::framesPerTick( m_sampleBuffer->sampleRate() );
+		m_sampleBuffer->prefetch( qMax( 0, static_cast<f_cnt_t>( framesPerTick *
+				( time - startPosition() - startTimeOffset() ) ) ) );
+	}
 }
 
 
@@ -305,7 +324,8 @@ void SampleTCO::loadSettings( const QDomElement & _this )
 	setMuted( _this.attribute( "muted" ).toInt() );
 	setStartTimeOffset( _this.attribute( "off" ).toInt() );
 
-	if ( _this.hasAttribute( "sample_rate" ) ) {
+	// a streamed file plays at its own sample rate
+	if ( _this.hasAttribute( "sample_rate" ) && !m_sampleBuffer->isStreaming() ) {
 		m_sampleBuffer->setSampleRate( _this.attribute( "sample_rate" ).toInt() );
 	}
 	
@@ -528,8 +548,7 @@ void SampleTCOView::mouseDoubleClickEvent( QMouseEvent * )
 	if ( af.isEmpty() ) {} //Don't do anything if no file is loaded
 	else if ( af == m_tco->m_sampleBuffer->audioFile() )
 	{	//Instead of reloading the existing file, just reset the size
-		int length = (int) ( m_tco->m_sampleBuffer->frames() / Engine::framesPerTick() );
-		m_tco->changeLength(length);
+		m_tco->changeLength( m_tco->sampleLength() );
 	}
 	else
 	{	//Otherwise load the new file as ususal
@@ -708,12 +727,28 @@ bool SampleTrack::play( const MidiTime & _start, const fpp_t _frames,
 	}
 	else
 	{
+		const TimeLineWidget * timeLine =
+			Engine::getSong()->getPlayPos( Song::Mode_PlaySong ).m_timeLine;
+		const bool loop = timeLine && timeLine->loopPointsEnabled();
+
 		bool nowPlaying = false;
 		for( int i = 0; i < numOfTCOs(); ++i )
 		{
 			TrackContentObject * tco = getTCO( i );
 			SampleTCO * sTco = dynamic_cast<SampleTCO*>( tco );
 
+			// get streamed samples ready for the next jump into them,
+			// their start or else the start of the loop
+			if( sTco->startPosition() > _start &&
+				sTco->startPosition() - _start <= MidiTime::ticksPerBar() )
+			{
+				sTco->prefetch( sTco->startPosition() );
+			}
+			else if( loop )
+			{
+				sTco->prefetch( timeLine->loopBegin() );
+			}
+
 			if( _start >= sTco->startPosition() && _start < sTco->endPosition() )
 			{
 				if( sTco->isPlaying() == false && _start >= (sTco->startPosition() + sTco->startTimeOffset()) )
@@ -0,0 +1,157 @@
+/*
+ * AutomatableModelBenchmark.cpp - cost of AutomatableModel::valueBuffer()
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QMutex>
+
+#include "AutomatableModel.h"
+#include "Engine.h"
+
+
+// Usage: automatablemodel_benchmark [threads]
+//
+// Every period, each thread asks every model for its value buffer a few
+// times, like the audio ports and FX channels sharing volume, panning and
+// send models do. Half of the models change their value each period, so
+// their buffer has to be computed by the first caller.
+//
+// The "mutex" rows take a mutex per model around each call, which is
+// what valueBuffer() itself did before it became lock-free.
+
+static const int Models = 256;
+static const int CallsPerPeriod = 4;
+static const int Periods = 2000;
+
+
+//! Runs @p periods periods on @p threads threads and returns the average
+//! time per valueBuffer() call in nanoseconds
+static double measure( std::vector<std::unique_ptr<FloatModel>> & models, int threads,
+			const std::function<void( int )> & call )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	std::atomic<int> period( -1 );
+	std::atomic<int> done( 0 );
+
+	auto worker = [&]()
+	{
+		for( int p = 0; p < Periods; ++p )
+		{
+			while( period.load( std::memory_order_acquire ) < p )
+			{
+				std::this_thread::yield();
+			}
+			for( int c = 0; c < CallsPerPeriod; ++c )
+			{
+				for( int m = 0; m < Models; ++m )
+				{
+					call( m );
+				}
+			}
+			done.fetch_add( 1, std::memory_order_acq_rel );
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for( int t = 0; t < threads; ++t )
+	{
+		pool.emplace_back( worker );
+	}
+
+	const Clock::time_point start = Clock::now();
+	for( int p = 0; p < Periods; ++p )
+	{
+		AutomatableModel::incrementPeriodCounter();
+		for( int m = 0; m < Models; m += 2 )
+		{
+			models[m]->setValue( p % 2 ? 0.25f : 0.75f );
+		}
+		done.store( 0, std::memory_order_relaxed );
+		period.store( p, std::memory_order_release );
+		while( done.load( std::memory_order_acquire ) < threads )
+		{
+			std::this_thread::yield();
+		}
+	}
+	const double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+	for( std::thread & t : pool )
+	{
+		t.join();
+	}
+
+	return seconds * 1e9 / ( double( Periods ) * CallsPerPeriod * Models * threads );
+}
+
+
+int main( int argc, char * argv[] )
+{
+	const int maxThreads = argc > 1 ? atoi( argv[1] ) :
+		std::max( 1, std::min( 4, int( std::thread::hardware_concurrency() ) ) );
+	if( maxThreads <= 0 )
+	{
+		fprintf( stderr, "usage: %s [threads]\n", argv[0] );
+		return 1;
+	}
+
+	new QCoreApplication( argc, argv );
+	Engine::init( true );
+
+	std::vector<std::unique_ptr<FloatModel>> models;
+	std::vector<std::unique_ptr<QMutex>> mutexes;
+	for( int m = 0; m < Models; ++m )
+	{
+		models.emplace_back( new FloatModel( 0.5f, 0.0f, 1.0f, 0.001f ) );
+		mutexes.emplace_back( new QMutex );
+	}
+
+	printf( "%d models, %d calls per model and thread per period\n\n", Models, CallsPerPeriod );
+	printf( "%-8s %-10s %12s %9s\n", "threads", "scheme", "ns/call", "speedup" );
+
+	for( int threads = 1; threads <= maxThreads; threads *= 2 )
+	{
+		const double locked = measure( models, threads, [&]( int m ) {
+			QMutexLocker lock( mutexes[m].get() );
+			models[m]->valueBuffer();
+		} );
+		const double lockFree = measure( models, threads, [&]( int m ) {
+			models[m]->valueBuffer();
+		} );
+
+		printf( "%-8d %-10s %12.1f\n", threads, "mutex", locked );
+		printf( "%-8d %-10s %12.1f %8.2fx\n", threads, "lock-free", lockFree, locked / lockFree );
+	}
+
+	return 0;
+}
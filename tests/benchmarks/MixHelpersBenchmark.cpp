@@ -0,0 +1,150 @@
+/*
+ * MixHelpersBenchmark.cpp - throughput of the mixing kernels per instruction set
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "MixHelpers.h"
+#include "ValueBuffer.h"
+
+using namespace MixHelpers;
+
+
+// Usage: mixhelpers_benchmark [frames per period]
+//
+// Prints the throughput of each kernel on a period of the given size, for
+// every instruction set this CPU supports. Buffers are small enough to stay
+// in cache, like the mixer's working set does.
+
+static const double MinSeconds = 0.2;
+
+
+//! Returns the throughput of @p kernel in million frames per second
+static double measure( int frames, const std::function<void()> & kernel )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	long iterations = 0;
+	const Clock::time_point start = Clock::now();
+	double seconds = 0;
+	do
+	{
+		for( int i = 0; i < 1000; ++i )
+		{
+			kernel();
+		}
+		iterations += 1000;
+		seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+	}
+	while( seconds < MinSeconds );
+
+	return iterations * frames / seconds / 1e6;
+}
+
+
+int main( int argc, char * argv[] )
+{
+	const int frames = argc > 1 ? atoi( argv[1] ) : 256;
+	if( frames <= 0 )
+	{
+		fprintf( stderr, "usage: %s [frames per period]\n", argv[0] );
+		return 1;
+	}
+
+	std::vector<sampleFrame> dst( frames );
+	std::vector<sampleFrame> src( frames );
+	ValueBuffer coeffs1( frames );
+	ValueBuffer coeffs2( frames );
+	std::vector<sampleFrame> gains( frames );
+	for( int f = 0; f < frames; ++f )
+	{
+		src[f][0] = ( f % 100 ) / 100.0f;
+		src[f][1] = -src[f][0];
+		coeffs1.values()[f] = coeffs2.values()[f] = 0.5f;
+		gains[f][0] = 0.25f;
+		gains[f][1] = 0.75f;
+	}
+	// silent buffers have to be scanned completely
+	std::vector<sampleFrame> silence( frames );
+
+	setNaNHandler( true );
+
+	struct Kernel
+	{
+		const char * name;
+		std::function<void()> run;
+	} ;
+
+	const Kernel kernels[] =
+	{
+		{ "add", [&]() { add( dst.data(), src.data(), frames ); } },
+		{ "addMultiplied", [&]() { addMultiplied( dst.data(), src.data(), 0.5f, frames ); } },
+		{ "addSanitizedMultiplied", [&]() { addSanitizedMultiplied( dst.data(), src.data(), 0.5f, frames ); } },
+		{ "addMultipliedByBuffers", [&]() {
+			addMultipliedByBuffers( dst.data(), src.data(), &coeffs1, &coeffs2, frames ); } },
+		{ "addSanitizedMultipliedByBuffers", [&]() {
+			addSanitizedMultipliedByBuffers( dst.data(), src.data(), &coeffs1, &coeffs2, frames ); } },
+		{ "addMultipliedByGains", [&]() { addMultipliedByGains( dst.data(), src.data(), gains.data(), frames ); } },
+		{ "addSanitizedMultipliedByGains", [&]() {
+			addSanitizedMultipliedByGains( dst.data(), src.data(), gains.data(), frames ); } },
+		{ "addMultipliedStereo", [&]() { addMultipliedStereo( dst.data(), src.data(), 0.25f, 0.75f, frames ); } },
+		{ "isSilent", [&]() { isSilent( silence.data(), frames ); } },
+		{ "peakValues", [&]() { float l, r; peakValues( src.data(), frames, l, r ); } },
+		{ "sanitize", [&]() { sanitize( src.data(), frames ); } },
+	} ;
+
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE2,
+		SimdLevel::AVX2, SimdLevel::AVX512, SimdLevel::NEON };
+
+	printf( "%d frames per period, default instruction set: %s\n\n",
+		frames, simdLevelName( simdLevel() ) );
+	printf( "%-32s %-8s %14s %9s\n", "kernel", "isa", "Mframes/s", "speedup" );
+
+	for( const Kernel & kernel : kernels )
+	{
+		double scalar = 0;
+		for( SimdLevel level : levels )
+		{
+			if( !setSimdLevel( level ) )
+			{
+				continue;
+			}
+			const double throughput = measure( frames, kernel.run );
+			if( level == SimdLevel::Scalar )
+			{
+				scalar = throughput;
+			}
+			printf( "%-32s %-8s %14.1f %8.2fx\n", kernel.name,
+				simdLevelName( level ), throughput, throughput / scalar );
+			// keep dst from growing into denormals or infinity
+			std::fill( dst.begin(), dst.end(), sampleFrame{ { 0, 0 } } );
+		}
+	}
+
+	return 0;
+}
@@ -26,6 +26,8 @@
 
 #include "AutomatableModel.h"
 #include "ComboBoxModel.h"
+#include "Engine.h"
+#include "Mixer.h"
 
 class AutomatableModelTest : QTestSuite
 {
@@ -96,6 +98,61 @@ private slots: // tests
 		QVERIFY(m2.value());
 		QVERIFY(!m3.value());
 	}
+
+	void AutomatedValuesRampTests()
+	{
+		FloatModel model(0, 0, 1, 0.01f);
+		const fpp_t frames = Engine::mixer()->framesPerPeriod();
+
+		AutomatableModel::incrementPeriodCounter();
+		model.setAutomatedValues(0.f, 1.f, 0, frames);
+		QCOMPARE(model.value(), 0.f);
+
+		ValueBuffer* vb = model.valueBuffer();
+		QVERIFY(vb);
+		QCOMPARE(vb->length(), static_cast<int>(frames));
+		for (fpp_t f = 0; f < frames; ++f)
+		{
+			QVERIFY(qAbs(vb->values()[f] - f / float(frames - 1)) < 1e-5f);
+		}
+		QCOMPARE(vb->values()[frames - 1], 1.f);
+	}
+
+	void AutomatedValuesSkippedFramesTests()
+	{
+		FloatModel model(0, 0, 1, 0.01f);
+		const fpp_t frames = Engine::mixer()->framesPerPeriod();
+
+		// two ticks starting at a quarter and at half of the period, the
+		// frames before, between and after them keep the previous value
+		AutomatableModel::incrementPeriodCounter();
+		model.setAutomatedValues(0.25f, 0.25f, frames / 4, frames / 8);
+		model.setAutomatedValues(0.75f, 0.75f, frames / 2, frames / 4);
+
+		ValueBuffer* vb = model.valueBuffer();
+		QVERIFY(vb);
+		for (fpp_t f = 0; f < frames; ++f)
+		{
+			QCOMPARE(vb->values()[f], f < frames / 2 ? 0.25f : 0.75f);
+		}
+	}
+
+	void AutomatedValuesConstantTests()
+	{
+		FloatModel model(0, 0, 1, 0.01f);
+		const fpp_t frames = Engine::mixer()->framesPerPeriod();
+
+		AutomatableModel::incrementPeriodCounter();
+		model.setAutomatedValues(0.f, 0.5f, 0, frames);
+		QVERIFY(model.valueBuffer());
+
+		// the value doesn't change within the period, value() will do
+		AutomatableModel::incrementPeriodCounter();
+		model.setAutomatedValues(0.5f, 0.5f, 0, frames / 2);
+		model.setAutomatedValues(0.5f, 0.5f, frames / 2, frames - frames / 2);
+		QVERIFY(model.valueBuffer() == nullptr);
+		QCOMPARE(model.value(), 0.5f);
+	}
 } AutomatableModelTests;
 
 #include "AutomatableModelTest.moc"
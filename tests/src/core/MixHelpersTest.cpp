@@ -0,0 +1,230 @@
+/*
+ * MixHelpersTest.cpp
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "MixHelpers.h"
+#include "ValueBuffer.h"
+
+using namespace MixHelpers;
+
+class MixHelpersTest : QTestSuite
+{
+	Q_OBJECT
+
+	// frame counts that leave every possible tail after the last full vector
+	static const int MaxFrames = 67;
+
+	typedef std::vector<sampleFrame> Buffer;
+
+	static float noise( unsigned int & seed )
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<int>( seed >> 8 ) / float( 1 << 24 ) * 4.0f - 2.0f;
+	}
+
+	static Buffer makeBuffer( int frames, unsigned int seed, float scale = 1.0f )
+	{
+		Buffer buf( frames );
+		for( sampleFrame & f : buf )
+		{
+			f[0] = noise( seed ) * scale;
+			f[1] = noise( seed ) * scale;
+		}
+		return buf;
+	}
+
+	static bool sameBits( const Buffer & a, const Buffer & b )
+	{
+		return a.size() == b.size() &&
+			memcmp( a.data(), b.data(), a.size() * sizeof( sampleFrame ) ) == 0;
+	}
+
+	//! Runs @p kernel on a copy of @p dst with the scalar kernels and with
+	//! every other supported instruction set and compares the output bit
+	//! by bit
+	static void compareToScalar( const Buffer & dst, std::function<void( sampleFrame * )> kernel )
+	{
+		const SimdLevel defaultLevel = simdLevel();
+
+		Buffer expected = dst;
+		QVERIFY( setSimdLevel( SimdLevel::Scalar ) );
+		kernel( expected.data() );
+
+		for( SimdLevel level : { SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512, SimdLevel::NEON } )
+		{
+			if( setSimdLevel( level ) )
+			{
+				Buffer actual = dst;
+				kernel( actual.data() );
+				if( !sameBits( actual, expected ) )
+				{
+					setSimdLevel( defaultLevel );
+					QFAIL( qPrintable( QString( "%1 differs from scalar for %2 frames" )
+						.arg( simdLevelName( level ) ).arg( dst.size() ) ) );
+				}
+			}
+		}
+
+		setSimdLevel( defaultLevel );
+	}
+
+private slots:
+	void init()
+	{
+		setNaNHandler( true );
+	}
+
+	void ScalarIsAlwaysSupportedTest()
+	{
+		QVERIFY( isSimdLevelSupported( SimdLevel::Scalar ) );
+		QVERIFY( isSimdLevelSupported( simdLevel() ) );
+	}
+
+	void MixKernelsTest()
+	{
+		for( int frames = 0; frames <= MaxFrames; ++frames )
+		{
+			const Buffer dst = makeBuffer( frames, 1 );
+			Buffer src = makeBuffer( frames, 2, 100.0f );
+			ValueBuffer coeffs1( frames ), coeffs2( frames );
+			unsigned int seed = 3;
+			for( int f = 0; f < frames; ++f )
+			{
+				coeffs1.values()[f] = noise( seed );
+				coeffs2.values()[f] = noise( seed );
+			}
+			const Buffer gains = makeBuffer( frames, 7 );
+
+			for( bool withBadSamples : { false, true } )
+			{
+				if( withBadSamples && frames > 2 )
+				{
+					src[frames / 3][1] = std::numeric_limits<float>::quiet_NaN();
+					src[frames - 1][0] = -std::numeric_limits<float>::infinity();
+				}
+
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					add( d, src.data(), frames ); } );
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					addMultiplied( d, src.data(), 0.3f, frames ); } );
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					addSanitizedMultiplied( d, src.data(), 0.3f, frames ); } );
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					addMultipliedByBuffers( d, src.data(), &coeffs1, &coeffs2, frames ); } );
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					addSanitizedMultipliedByBuffers( d, src.data(), &coeffs1, &coeffs2, frames ); } );
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					addMultipliedByGains( d, src.data(), gains.data(), frames ); } );
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					addSanitizedMultipliedByGains( d, src.data(), gains.data(), frames ); } );
+				compareToScalar( dst, [&]( sampleFrame * d ) {
+					addMultipliedStereo( d, src.data(), 0.3f, -0.7f, frames ); } );
+			}
+		}
+	}
+
+	void IsSilentTest()
+	{
+		for( int frames = 1; frames <= MaxFrames; ++frames )
+		{
+			Buffer buf = makeBuffer( frames, 4, 0.00000001f );
+			for( int f = 0; f < frames; ++f )
+			{
+				const float saved = buf[f][f % 2];
+				buf[f][f % 2] = -0.0001f;
+				compareToScalar( buf, [&]( sampleFrame * b ) {
+					QVERIFY( !isSilent( b, frames ) ); } );
+				buf[f][f % 2] = saved;
+			}
+			compareToScalar( buf, [&]( sampleFrame * b ) {
+				QVERIFY( isSilent( b, frames ) ); } );
+		}
+	}
+
+	void PeakValuesTest()
+	{
+		for( int frames = 0; frames <= MaxFrames; ++frames )
+		{
+			Buffer buf = makeBuffer( frames, 6, 10.0f );
+			if( frames > 2 )
+			{
+				// the peak must not depend on where in the vector it is
+				buf[frames / 2][0] = -20.0f;
+				buf[frames - 1][1] = 30.0f;
+			}
+			for( bool withBadSamples : { false, true } )
+			{
+				if( withBadSamples && frames > 0 )
+				{
+					buf[0][0] = std::numeric_limits<float>::quiet_NaN();
+				}
+				compareToScalar( buf, [&]( sampleFrame * b ) {
+					float left, right;
+					QCOMPARE( peakValues( b, frames, left, right ), withBadSamples && frames > 0 );
+					// store the results in the buffer, so they get compared
+					if( frames > 2 )
+					{
+						QCOMPARE( left, 20.0f );
+						QCOMPARE( right, 30.0f );
+						b[0][0] = left;
+						b[0][1] = right;
+					}
+				} );
+			}
+		}
+	}
+
+	void SanitizeTest()
+	{
+		for( int frames = 0; frames <= MaxFrames; ++frames )
+		{
+			Buffer buf = makeBuffer( frames, 5, 1500.0f );
+			compareToScalar( buf, [&]( sampleFrame * b ) {
+				QVERIFY( !sanitize( b, frames ) );
+				for( int f = 0; f < frames; ++f )
+				{
+					QVERIFY( fabsf( b[f][0] ) <= 1000.0f && fabsf( b[f][1] ) <= 1000.0f );
+				}
+			} );
+
+			if( frames > 0 )
+			{
+				buf[frames - 1][1] = std::numeric_limits<float>::infinity();
+				compareToScalar( buf, [&]( sampleFrame * b ) {
+					QVERIFY( sanitize( b, frames ) );
+					QVERIFY( isSilent( b, frames ) );
+				} );
+			}
+		}
+	}
+} MixHelpersTests;
+
+#include "MixHelpersTest.moc"
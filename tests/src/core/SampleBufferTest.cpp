@@ -0,0 +1,247 @@
+/*
+ * SampleBufferTest.cpp
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "SampleBuffer.h"
+
+class SampleBufferTest : QTestSuite
+{
+	Q_OBJECT
+
+	static const f_cnt_t Frames = 50;
+	// frames played in every test, several times the sample
+	static const int Played = 400;
+
+	typedef std::vector<sampleFrame> Buffer;
+
+	//! The frames the old fragment path copied from @p start on, one by
+	//! one, or -1 where it filled in silence. Ping-pong loops turn on the
+	//! last frame if the loop ends with the sample, where the old path
+	//! read the frame after it, and loops too short to play are played
+	//! like the next simpler mode instead of hanging.
+	static std::vector<f_cnt_t> fragment( SampleBuffer::LoopMode mode, f_cnt_t start,
+					f_cnt_t loopStart, f_cnt_t loopEnd, f_cnt_t end, int count )
+	{
+		const f_cnt_t wrap = loopEnd < Frames ? loopEnd : Frames;
+		const f_cnt_t turn = loopEnd < Frames ? loopEnd : Frames - 1;
+		if( mode == SampleBuffer::LoopPingPong && turn <= loopStart )
+		{
+			mode = SampleBuffer::LoopOn;
+		}
+		if( mode == SampleBuffer::LoopOn && wrap <= loopStart )
+		{
+			mode = SampleBuffer::LoopOff;
+		}
+
+		std::vector<f_cnt_t> frames;
+		f_cnt_t pos = start;
+		bool backwards = false;
+		for( int i = 0; i < count; ++i )
+		{
+			switch( mode )
+			{
+			case SampleBuffer::LoopOff:
+				frames.push_back( pos < end ? pos++ : -1 );
+				break;
+			case SampleBuffer::LoopOn:
+				frames.push_back( pos++ );
+				if( pos >= wrap )
+				{
+					pos = loopStart;
+				}
+				break;
+			case SampleBuffer::LoopPingPong:
+				frames.push_back( pos );
+				pos += backwards ? -1 : 1;
+				if( backwards && pos <= loopStart )
+				{
+					backwards = false;
+				}
+				else if( !backwards && pos >= turn )
+				{
+					backwards = true;
+				}
+				break;
+			}
+		}
+		return frames;
+	}
+
+	//! Resamples the frames of @p fragment by @p ratio, interpolating
+	//! linearly if @p interpolate is set
+	static Buffer resample( const Buffer & data, const std::vector<f_cnt_t> & fragment,
+						double ratio, bool interpolate, int count )
+	{
+		Buffer out( count );
+		std::size_t k = 0;
+		double fraction = 0;
+		for( sampleFrame & f : out )
+		{
+			if( fragment[k] < 0 )
+			{
+				f[0] = f[1] = 0.0f;
+				continue;
+			}
+			float left = data[fragment[k]][0];
+			float right = data[fragment[k]][1];
+			if( interpolate && fraction > 0 )
+			{
+				const f_cnt_t next = fragment[k + 1];
+				const float b0 = next < 0 ? 0.0f : data[next][0];
+				const float b1 = next < 0 ? 0.0f : data[next][1];
+				left += ( b0 - left ) * fraction;
+				right += ( b1 - right ) * fraction;
+			}
+			f[0] = left;
+			f[1] = right;
+
+			fraction += ratio;
+			for( ; fraction >= 1.0 && fragment[k] >= 0; fraction -= 1.0 )
+			{
+				++k;
+			}
+		}
+		return out;
+	}
+
+	//! Plays @p buffer in periods of varying length, so the position
+	//! between two frames has to carry over from one period to the next
+	static Buffer play( SampleBuffer & buffer, SampleBuffer::handleState & state,
+					double ratio, SampleBuffer::LoopMode mode )
+	{
+		static const fpp_t Periods[] = { 64, 7, 13, 1, 32 };
+		Buffer out( Played );
+		int done = 0;
+		for( int i = 0; done < Played; ++i )
+		{
+			const fpp_t n = std::min<fpp_t>( Periods[i % 5], Played - done );
+			// a finished sample leaves the buffer alone
+			std::fill( out.begin() + done, out.begin() + done + n, sampleFrame{ 0.0f, 0.0f } );
+			buffer.play( out.data() + done, &state, n, buffer.frequency() * ratio, mode );
+			done += n;
+		}
+		return out;
+	}
+
+	static void compare( SampleBuffer::LoopMode mode, f_cnt_t loopStart, f_cnt_t loopEnd,
+					f_cnt_t end, double ratio, int interpolation )
+	{
+		Buffer data( Frames );
+		for( f_cnt_t f = 0; f < Frames; ++f )
+		{
+			data[f][0] = f + 1.0f;
+			data[f][1] = -( f + 1.0f ) * 0.5f;
+		}
+		SampleBuffer buffer( data.data(), Frames );
+		buffer.setAllPointFrames( 0, end, loopStart, loopEnd );
+
+		SampleBuffer::handleState state( false, interpolation );
+		const Buffer played = play( buffer, state, ratio, mode );
+
+		const std::vector<f_cnt_t> frames = fragment( mode, 0, loopStart, loopEnd, end,
+							static_cast<int>( Played * ratio ) + 2 );
+		const Buffer expected = resample( data, frames, ratio,
+						interpolation == SRC_LINEAR, Played );
+
+		for( int i = 0; i < Played; ++i )
+		{
+			QVERIFY2( qFuzzyCompare( 1.0f + played[i][0], 1.0f + expected[i][0] ) &&
+					qFuzzyCompare( 1.0f + played[i][1], 1.0f + expected[i][1] ),
+				qPrintable( QString( "mode %1, loop %2-%3, end %4, ratio %5: frame %6 is "
+									"%7 instead of %8" )
+					.arg( mode ).arg( loopStart ).arg( loopEnd ).arg( end ).arg( ratio )
+					.arg( i ).arg( played[i][0] ).arg( expected[i][0] ) ) );
+		}
+	}
+
+private slots:
+	void testLoopOff()
+	{
+		compare( SampleBuffer::LoopOff, 0, Frames, Frames, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopOff, 0, Frames, 40, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopOff, 0, Frames, 40, 0.75, SRC_LINEAR );
+		compare( SampleBuffer::LoopOff, 0, Frames, Frames, 1.5, SRC_ZERO_ORDER_HOLD );
+	}
+
+	void testLoopOn()
+	{
+		compare( SampleBuffer::LoopOn, 10, 30, Frames, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopOn, 10, 30, Frames, 0.75, SRC_LINEAR );
+		compare( SampleBuffer::LoopOn, 10, 30, Frames, 1.5, SRC_LINEAR );
+		compare( SampleBuffer::LoopOn, 10, 30, Frames, 0.75, SRC_ZERO_ORDER_HOLD );
+	}
+
+	void testLoopPingPong()
+	{
+		compare( SampleBuffer::LoopPingPong, 10, 30, Frames, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopPingPong, 10, 30, Frames, 0.75, SRC_LINEAR );
+		compare( SampleBuffer::LoopPingPong, 10, 30, Frames, 1.5, SRC_LINEAR );
+		compare( SampleBuffer::LoopPingPong, 0, 2, Frames, 0.75, SRC_LINEAR );
+	}
+
+	void testLoopEndsWithSample()
+	{
+		compare( SampleBuffer::LoopOn, 20, Frames, Frames, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopOn, 20, Frames, Frames, 0.75, SRC_LINEAR );
+		compare( SampleBuffer::LoopPingPong, 20, Frames, Frames, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopPingPong, 20, Frames, Frames, 0.75, SRC_LINEAR );
+	}
+
+	void testLoopTooShort()
+	{
+		compare( SampleBuffer::LoopOn, 20, 20, Frames, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopOn, 20, 20, Frames, 0.75, SRC_LINEAR );
+		compare( SampleBuffer::LoopPingPong, 20, 20, Frames, 1.0, SRC_LINEAR );
+		compare( SampleBuffer::LoopPingPong, Frames - 1, Frames, Frames, 0.75, SRC_LINEAR );
+	}
+
+	void testPositionCarriesOver()
+	{
+		// the frame index alone loses the position between two frames
+		Buffer data( Frames, sampleFrame{ 0.0f, 0.0f } );
+		for( f_cnt_t f = 0; f < Frames; ++f )
+		{
+			data[f][0] = data[f][1] = f;
+		}
+		SampleBuffer buffer( data.data(), Frames );
+		SampleBuffer::handleState state( false, SRC_LINEAR );
+
+		Buffer out( 3 );
+		for( int i = 0; i < 3; ++i )
+		{
+			buffer.play( out.data() + i, &state, 1, buffer.frequency() * 0.5f );
+		}
+		QCOMPARE( out[0][0], 0.0f );
+		QCOMPARE( out[1][0], 0.5f );
+		QCOMPARE( out[2][0], 1.0f );
+		QCOMPARE( state.frameIndex(), f_cnt_t( 1 ) );
+	}
+
+} SampleBufferTest;
+
+#include "SampleBufferTest.moc"
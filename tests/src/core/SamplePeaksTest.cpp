@@ -0,0 +1,193 @@
+/*
+ * SamplePeaksTest.cpp
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include <cmath>
+#include <vector>
+
+#include "SamplePeaks.h"
+
+class SamplePeaksTest : QTestSuite
+{
+	Q_OBJECT
+
+	// four levels, with the last peak of each only partly filled
+	static const f_cnt_t Frames = 3 * 16 * SamplePeaks::BaseFrames + 100;
+
+	typedef std::vector<sampleFrame> Buffer;
+
+	static Buffer sample()
+	{
+		Buffer data( Frames );
+		for( f_cnt_t f = 0; f < Frames; ++f )
+		{
+			// a slow sine with a spike now and then
+			data[f][0] = std::sin( f * 0.01f ) * 0.5f + ( f % 997 == 0 ? 0.4f : 0.0f );
+			data[f][1] = std::cos( f * 0.003f ) * 0.25f - ( f % 661 == 0 ? 0.7f : 0.0f );
+		}
+		return data;
+	}
+
+	//! The peak of the frames from @p from to @p to, rounded out to whole
+	//! peaks of level 0 and computed frame by frame
+	static SamplePeaks::Peak expected( const Buffer & data, f_cnt_t from, f_cnt_t to )
+	{
+		const f_cnt_t base = SamplePeaks::BaseFrames;
+		from = from / base * base;
+		to = ( to + base - 1 ) / base * base;
+		to = to < Frames ? to : Frames;
+
+		SamplePeaks::Peak peak;
+		for( int ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+		{
+			double squares = 0;
+			peak.min[ch] = peak.max[ch] = data[from][ch];
+			for( f_cnt_t f = from; f < to; ++f )
+			{
+				peak.min[ch] = qMin( peak.min[ch], data[f][ch] );
+				peak.max[ch] = qMax( peak.max[ch], data[f][ch] );
+				squares += data[f][ch] * data[f][ch];
+			}
+			peak.rms[ch] = static_cast<float>( std::sqrt( squares / ( to - from ) ) );
+		}
+		return peak;
+	}
+
+	static bool equal( const SamplePeaks::Peak & a, const SamplePeaks::Peak & b )
+	{
+		for( int ch = 0; ch < DEFAULT_CHANNELS; ++ch )
+		{
+			// the RMS is merged from peaks in single precision
+			if( a.min[ch] != b.min[ch] || a.max[ch] != b.max[ch] ||
+				std::abs( a.rms[ch] - b.rms[ch] ) > 1e-4f )
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static void compare( const SamplePeaks & peaks, const Buffer & data,
+							f_cnt_t from, f_cnt_t to )
+	{
+		SamplePeaks::Peak peak;
+		QVERIFY2( peaks.peak( from, to, peak ) && equal( peak, expected( data, from, to ) ),
+			qPrintable( QString( "frames %1 to %2" ).arg( from ).arg( to ) ) );
+	}
+
+	static void compareLevels( const SamplePeaks & a, const SamplePeaks & b )
+	{
+		QCOMPARE( a.frames(), b.frames() );
+		QCOMPARE( a.levels(), b.levels() );
+		for( int l = 0; l < a.levels(); ++l )
+		{
+			QCOMPARE( a.levelSize( l ), b.levelSize( l ) );
+			for( std::size_t p = 0; p < a.levelSize( l ); ++p )
+			{
+				QVERIFY2( equal( a.level( l )[p], b.level( l )[p] ),
+					qPrintable( QString( "level %1, peak %2" ).arg( l ).arg( p ) ) );
+			}
+		}
+	}
+
+private slots:
+	void testLevels()
+	{
+		const Buffer data = sample();
+		const SamplePeaks peaks( data.data(), Frames );
+		QCOMPARE( peaks.levels(), 4 );
+		QCOMPARE( peaks.levelSize( 0 ), std::size_t( 49 ) );
+		QCOMPARE( peaks.levelSize( 1 ), std::size_t( 13 ) );
+		QCOMPARE( peaks.levelSize( 2 ), std::size_t( 4 ) );
+		QCOMPARE( peaks.levelSize( 3 ), std::size_t( 1 ) );
+		QCOMPARE( SamplePeaks::size( Frames ), std::size_t( 49 + 13 + 4 + 1 ) );
+		QVERIFY( equal( peaks.level( 3 )[0], expected( data, 0, Frames ) ) );
+	}
+
+	void testPeak()
+	{
+		const Buffer data = sample();
+		const SamplePeaks peaks( data.data(), Frames );
+
+		compare( peaks, data, 0, Frames );
+		compare( peaks, data, 0, 1 );
+		compare( peaks, data, 255, 257 );
+		compare( peaks, data, 1024, 3 * 1024 );
+		compare( peaks, data, Frames - 1, Frames );
+		compare( peaks, data, Frames - 100, Frames );
+		// every pair of a few ranges, so the walk up the levels starts
+		// and ends at all kinds of peaks
+		for( f_cnt_t from = 0; from < Frames; from += 389 )
+		{
+			for( f_cnt_t to = from + 1; to <= Frames; to += 421 )
+			{
+				compare( peaks, data, from, to );
+			}
+		}
+	}
+
+	void testPeakOutOfRange()
+	{
+		const Buffer data = sample();
+		const SamplePeaks peaks( data.data(), Frames );
+		SamplePeaks::Peak peak;
+
+		QVERIFY( peaks.peak( -100, 10, peak ) );
+		QVERIFY( equal( peak, expected( data, 0, 10 ) ) );
+		QVERIFY( peaks.peak( Frames - 10, Frames + 100, peak ) );
+		QVERIFY( equal( peak, expected( data, Frames - 10, Frames ) ) );
+		QVERIFY( !peaks.peak( 10, 10, peak ) );
+		QVERIFY( !peaks.peak( Frames, Frames + 10, peak ) );
+		QVERIFY( !SamplePeaks().peak( 0, 10, peak ) );
+	}
+
+	void testAppend()
+	{
+		// as a recording does, in chunks not aligned to the peaks
+		const Buffer data = sample();
+		const SamplePeaks whole( data.data(), Frames );
+		const f_cnt_t chunks[] = { 1, 100, 300, 255, 1000, 64 };
+
+		// with room for fewer and for more peaks than it gets
+		for( f_cnt_t reserved : { 0, Frames / 2, 2 * Frames } )
+		{
+			SamplePeaks appended;
+			appended.reserve( reserved );
+			for( f_cnt_t f = 0, i = 0; f < Frames; ++i )
+			{
+				const f_cnt_t n = qMin( chunks[i % 6], Frames - f );
+				appended.append( data.data() + f, n );
+				f += n;
+				QCOMPARE( appended.frames(), f );
+				QCOMPARE( appended.levels(), SamplePeaks( data.data(), f ).levels() );
+			}
+			compareLevels( appended, whole );
+			compare( appended, data, 777, 7777 );
+		}
+	}
+
+} SamplePeaksTest;
+
+#include "SamplePeaksTest.moc"
@@ -74,6 +74,45 @@ private slots:
 		QCOMPARE(p.valueAt(150), 1.0f);
 	}
 
+	void testPatternSeek()
+	{
+		AutomationPattern p(nullptr);
+		p.setProgressionType(AutomationPattern::LinearProgression);
+		p.putValue(0, 0.0, false);
+		p.putValue(100, 1.0, false);
+		p.putValue(200, 0.0, false);
+
+		// jumping around must not depend on the previous lookup
+		QCOMPARE(p.valueAt(150), 0.5f);
+		QCOMPARE(p.valueAt(50), 0.5f);
+		QCOMPARE(p.valueAt(250), 0.0f);
+		QCOMPARE(p.valueAt(-10), 0.0f);
+		QCOMPARE(p.valueAt(100), 1.0f);
+
+		p.putValue(150, 1.0, false);
+		QCOMPARE(p.valueAt(175), 0.5f);
+
+		std::vector<float> values;
+		QVERIFY(p.valuesAfter(0, values));
+		QCOMPARE(values.size(), size_t(100));
+		QCOMPARE(values[25], 0.25f);
+		QVERIFY(!p.valuesAfter(200, values));
+	}
+
+	void testPatternBetweenTicks()
+	{
+		AutomationPattern p(nullptr);
+		p.setProgressionType(AutomationPattern::LinearProgression);
+		p.putValue(0, 0.0, false);
+		p.putValue(100, 1.0, false);
+
+		QCOMPARE(p.valueAt(50, 0.5f), 0.505f);
+		QCOMPARE(p.valueAt(100, 0.5f), 1.0f);
+
+		p.setProgressionType(AutomationPattern::DiscreteProgression);
+		QCOMPARE(p.valueAt(99, 0.9f), 0.0f);
+	}
+
 	void testPatterns()
 	{
 		FloatModel model;
@@ -0,0 +1,88 @@
+/*
+ * InstrumentTrackTest.cpp
+ *
+ * Copyright (c) 2020 LMMS Developers
+ *
+ * This file is part of LMMS - https://lmms.io
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "QTestSuite.h"
+
+#include "InstrumentTrack.h"
+#include "Mixer.h"
+#include "Note.h"
+#include "NotePlayHandle.h"
+
+#include "Engine.h"
+#include "Song.h"
+
+class InstrumentTrackTest : QTestSuite
+{
+	Q_OBJECT
+
+	//! Renders a period of @p n the way PlayHandle::doProcessing() does,
+	//! with a constant level instead of the instrument's output, and lets
+	//! the audio port release the buffer afterwards
+	static void render(NotePlayHandle* n, float level)
+	{
+		n->startBuffer();
+		n->play(n->buffer());
+		sampleFrame* buf = n->buffer();
+		for (fpp_t f = 0; f < Engine::mixer()->framesPerPeriod(); ++f)
+		{
+			buf[f][0] = buf[f][1] = level;
+		}
+		n->finishBuffer();
+		n->releaseBuffer();
+	}
+
+private slots:
+	void testStealQuietest()
+	{
+		InstrumentTrack track(Engine::getSong());
+		// no such plugin, so we get a silent dummy instrument
+		track.loadInstrument("dummy");
+		track.limitVoicesModel()->setValue(true);
+		track.maxVoicesModel()->setValue(1);
+		track.voiceStealingModel()->setValue(InstrumentTrack::StealQuietest);
+
+		const f_cnt_t frames = 100 * Engine::mixer()->framesPerPeriod();
+		NotePlayHandle* loud = NotePlayHandleManager::acquire(&track, 0, frames,
+			Note(MidiTime(0), MidiTime(0), DefaultKey));
+		NotePlayHandle* quiet = NotePlayHandleManager::acquire(&track, 0, frames,
+			Note(MidiTime(0), MidiTime(0), DefaultKey + 1));
+		render(loud, 0.8f);
+		render(quiet, 0.1f);
+
+		// the peaks must survive the release of the buffers
+		QCOMPARE(loud->lastPeak(), 0.8f);
+		QCOMPARE(quiet->lastPeak(), 0.1f);
+
+		NotePlayHandle* voices[] = { loud, quiet };
+		track.stealVoices(voices, 2);
+		QVERIFY(quiet->isFadingOut());
+		QVERIFY(!loud->isFadingOut());
+
+		NotePlayHandleManager::release(loud);
+		NotePlayHandleManager::release(quiet);
+	}
+
+} InstrumentTrackTest;
+
+#include "InstrumentTrackTest.moc"